@@ -0,0 +1,1194 @@
+/***
+ *
+ * @file: bench.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the microbenchmark suite of the StackVM execution engines
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, sysconf
+
+#include <time.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "batch.h"
+#include "metrics.h"
+#include "pool.h"
+#include "slab.h"
+#include "snapshot.h"
+#include "channel.h"
+#include "native.h"
+#include "asm.h"
+
+#define BENCH_TUPLES            4096            // Input tuples evaluated per measurement
+#define BENCH_PERIOD            256             // Input tuples repeat after this many tuples
+#define BENCH_REPEAT            5               // Measurements per program and engine, the fastest one is reported
+#define BENCH_MAX_WORDS         1024            // Largest synthetic program in words
+#define BENCH_MAX_ARITY         256             // Largest input tuple
+#define BENCH_POOL_JOBS         4096            // Jobs submitted per scheduler measurement
+#define BENCH_POOL_TUPLES       64              // Input tuples of every scheduler job
+#define BENCH_SLAB_JOBS         4096            // Single-run jobs per context setup measurement
+#define BENCH_WARM_INSTRUCTIONS 100000          // Instructions of the setup prefix of the warm start measurement
+#define BENCH_WARM_STARTS       256             // Warm starts per measurement
+#define BENCH_STREAM_VALUES     262144          // Values streamed per handoff measurement
+#define BENCH_STREAM_CAPACITY   4096            // Cells of the input and output channels
+#define BENCH_NATIVE_CALLS      1048576         // Loop iterations per native call measurement, an even count
+#define BENCH_ASM_BYTES         (8 * 1024 * 1024) // Size of the generated assembler source
+
+#define PUSH(value)             ((uint32_t)(value))
+#define OP(opcode)              GET_OPCODE(opcode)
+
+/**
+ * @brief Synthetic benchmark program
+ */
+typedef struct bench_program
+{
+        const char *name;                       // Name of the workload
+        uint32_t code[BENCH_MAX_WORDS];         // Instruction words
+        uint32_t size;                          // Number of instruction words
+        uint32_t arity;                         // Values pushed before every run
+} bench_program_t;
+
+/**
+ * @brief Result of one program on one engine
+ */
+typedef struct bench_result
+{
+        uint64_t instructions;                  // Instructions executed by the whole batch
+        double seconds;                         // Wall time of the fastest batch
+        uint32_t peak;                          // Peak stack depth of a single run
+} bench_result_t;
+
+/**
+ * @brief Builds the arithmetic-heavy workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note Straight-line code mixing every arithmetic and logical instruction on two inputs.
+ */
+static void bench_arith(bench_program_t *bp)
+{
+        static const uint32_t ops[] = { ADD, MUL, XOR, SUB, AND, OR, ADD, MUL };
+        uint32_t n = 0;
+
+        bp->name  = "arith";
+        bp->arity = 2;
+        for (uint32_t i = 0; i < 96; i++)
+        {
+                bp->code[n++] = PUSH(3 + i % 13);
+                bp->code[n++] = OP(ops[i % 8]);
+                if (i % 6 == 5)
+                {
+                        bp->code[n++] = OP(NOT);
+                }
+        }
+        bp->code[n++] = OP(ADD);                // Fold in the second input
+        bp->code[n++] = OP(HALT);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Builds the branch-heavy workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note Every block compares the top of stack with a constant and takes one of two BRT/BR paths,
+ *       then folds in the next input. The batch re-runs the program and the inputs make the branches
+ *       data-dependent.
+ */
+static void bench_branch(bench_program_t *bp)
+{
+        uint32_t n = 0;
+
+        bp->name  = "branch";
+        bp->arity = 8;
+        for (uint32_t i = 0; i < 42; i++)
+        {
+                bp->code[n++] = PUSH(1 + (i * 7) % 31);
+                bp->code[n++] = OP((i % 2) ? LT : GE);
+                bp->code[n++] = OP((i % 3) ? BRT : BRF);
+                uint32_t taken = n++;           // Target word of the conditional branch
+                bp->code[n++] = PUSH(i * 5 + 1);
+                bp->code[n++] = OP(BR);
+                uint32_t join = n++;            // Target word of the unconditional branch
+                bp->code[taken] = n;
+                bp->code[n++] = PUSH(i * 3 + 2);
+                bp->code[join] = n;
+                if (i % 6 == 5)
+                {
+                        bp->code[n++] = OP(ADD); // Next input, the seventh block of the last input leaves the result
+                }
+                else
+                {
+                        bp->code[n++] = PUSH(i);
+                        bp->code[n++] = OP(XOR);
+                }
+        }
+        bp->code[n++] = OP(HALT);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Builds the flag-branch workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note A countdown loop from the input plus 64 to zero. SUB sets the flags and BRNZ branches on them,
+ *       so the counter stays on the stack without a compare result being pushed and popped.
+ */
+static void bench_loop(bench_program_t *bp)
+{
+        uint32_t n = 0;
+
+        bp->name  = "loop";
+        bp->arity = 1;
+        bp->code[n++] = PUSH(64);
+        bp->code[n++] = OP(ADD);
+        uint32_t loop = n;
+        bp->code[n++] = PUSH(1);
+        bp->code[n++] = OP(SUB);
+        bp->code[n++] = OP(BRNZ);
+        bp->code[n++] = loop;
+        bp->code[n++] = OP(HALT);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Builds the empty-stack workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note The countdown of the loop workload from a constant, the program starts on an empty stack
+ *       and takes no inputs.
+ */
+static void bench_empty(bench_program_t *bp)
+{
+        uint32_t n = 0;
+
+        bp->name  = "empty";
+        bp->arity = 0;
+        bp->code[n++] = PUSH(96);
+        uint32_t loop = n;
+        bp->code[n++] = PUSH(1);
+        bp->code[n++] = OP(SUB);
+        bp->code[n++] = OP(BRNZ);
+        bp->code[n++] = loop;
+        bp->code[n++] = OP(HALT);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Builds the call workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note The countdown of the loop workload with the decrement moved into a function. The function
+ *       reads its argument as local slot -1, so every iteration pays for a CALL, a RET and two locals.
+ */
+static void bench_call(bench_program_t *bp)
+{
+        uint32_t n = 0;
+
+        bp->name  = "call";
+        bp->arity = 1;
+        bp->code[n++] = PUSH(64);
+        bp->code[n++] = OP(ADD);
+        uint32_t loop = n;
+        bp->code[n++] = OP(CALL);
+        uint32_t call = n++;                    // Target word of the call
+        bp->code[n++] = OP(BRNZ);
+        bp->code[n++] = loop;
+        bp->code[n++] = OP(HALT);
+        bp->code[call] = n;
+        bp->code[n++] = OP(LOAD_LOCAL);
+        bp->code[n++] = (uint32_t)-1;
+        bp->code[n++] = PUSH(1);
+        bp->code[n++] = OP(SUB);
+        bp->code[n++] = OP(STORE_LOCAL);
+        bp->code[n++] = (uint32_t)-1;
+        bp->code[n++] = OP(RET);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Builds the deep-stack workload
+ * @param bp Pointer to the program to be filled
+ * @return void
+ * @note The whole input tuple sits on the stack and is reduced one level at a time.
+ *       Constants pushed on top of the stack would be folded by the optimizer, so the depth comes from the inputs.
+ */
+static void bench_deep(bench_program_t *bp)
+{
+        static const uint32_t ops[] = { ADD, XOR, SUB, OR, ADD, AND, XOR, ADD };
+        uint32_t n = 0;
+
+        bp->name  = "deep";
+        bp->arity = BENCH_MAX_ARITY;
+        for (uint32_t i = 0; i + 1 < BENCH_MAX_ARITY; i++)
+        {
+                bp->code[n++] = OP(ops[i % 8]);
+                if (i % 16 == 15)
+                {
+                        bp->code[n++] = PUSH(3);
+                        bp->code[n++] = OP(MUL);
+                }
+        }
+        bp->code[n++] = OP(HALT);
+        bp->size = n;
+        return;
+}
+
+/**
+ * @brief Counts the instructions and the peak stack depth of one period of the batch
+ * @param program Pointer to the program
+ * @param inputs Input tuples of one period
+ * @param arity Number of values per input tuple
+ * @param result Receives the instruction count of one period and the peak depth
+ * @return 0 on success, -1 on failure
+ * @note The counts come from the runtime counters of a staged context, every tuple is a counted run.
+ *       Without the counters compiled in both counts stay 0 and the rates are not reported.
+ */
+static int bench_count(program_t *program, const cell_t *inputs, uint32_t arity, bench_result_t *result)
+{
+        result->instructions = 0;
+        result->peak         = 0;
+#if STACKVM_METRICS
+        stackvm_t *vm = stackvm_create(NULL);
+        cell_t results[BENCH_PERIOD];
+        if (!vm || stackvm_metrics(vm, true) != 0)
+        {
+                stackvm_free(vm);
+                return -1;
+        }
+        attach_program(vm, program);
+        size_t done = stackvm_run_batch(vm, inputs, arity, BENCH_PERIOD, results);
+        result->instructions = vm->metrics->instructions;
+        result->peak         = (uint32_t)vm->metrics->peak_depth;
+        stackvm_free(vm);
+        return (done == BENCH_PERIOD) ? 0 : -1;
+#else
+        (void)program;
+        (void)inputs;
+        (void)arity;
+        return 0;
+#endif
+}
+
+/**
+ * @brief Returns the monotonic time in seconds
+ * @return Seconds since an arbitrary point
+ */
+static double bench_now(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Measures the scheduler with 1, 2, 4 ... workers up to the number of CPUs
+ * @param bp Program run by every job
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note The same jobs are submitted in one call and awaited with `pool_wait`, the speedup is
+ *       relative to the single worker.
+ */
+static int bench_pool(const bench_program_t *bp, bool json)
+{
+        long cpus          = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t per_job     = BENCH_POOL_TUPLES;
+        program_t *program = program_create(bp->code, bp->size);
+        cell_t *inputs     = malloc(per_job * bp->arity * sizeof(cell_t));
+        cell_t *results    = malloc(BENCH_POOL_JOBS * per_job * sizeof(cell_t));
+        pool_job_t *jobs   = malloc(BENCH_POOL_JOBS * sizeof(pool_job_t));
+        if (!program || !inputs || !results || !jobs)
+        {
+                fprintf(stderr, "Error: Failed to set up the scheduler benchmark\n");
+                return -1;
+        }
+        for (size_t i = 0; i < per_job * bp->arity; i++)
+        {
+                inputs[i] = (cell_t)(i * 2654435761u >> 7) % 64;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "program,workers,jobs,tuples,seconds,jobs_per_second,speedup\n");
+        }
+        double single = 0.0;
+        for (uint32_t workers = 1; workers <= (uint32_t)((cpus > 0) ? cpus : 1); workers *= 2)
+        {
+                pool_t *pool = pool_create(&(pool_config_t){ .workers = workers, .engine = ENGINE_THREADED });
+                if (!pool)
+                {
+                        fprintf(stderr, "Error: Failed to create the scheduler\n");
+                        return -1;
+                }
+                double best = 0.0;
+                for (int r = 0; r <= BENCH_REPEAT; r++)
+                {
+                        for (size_t j = 0; j < BENCH_POOL_JOBS; j++)
+                        {
+                                jobs[j] = (pool_job_t){ .program = program, .inputs = inputs, .arity = bp->arity,
+                                                        .count = per_job, .results = results + j * per_job };
+                        }
+                        double start = bench_now();
+                        pool_submit(pool, jobs, BENCH_POOL_JOBS);
+                        pool_wait(pool);
+                        double seconds = bench_now() - start;
+                        if (r == 1 || (r > 1 && seconds < best))
+                        {
+                                best = seconds;                 // The first round warms the contexts up
+                        }
+                }
+                pool_free(pool);
+
+                single = (workers == 1) ? best : single;
+                if (json)
+                {
+                        fprintf(stdout, "%s  {\"program\": \"%s\", \"workers\": %u, \"jobs\": %d, \"tuples\": %zu, "
+                                "\"seconds\": %.6f, \"jobs_per_second\": %.0f, \"speedup\": %.2f}",
+                                (workers == 1) ? "" : ",\n", bp->name, workers, BENCH_POOL_JOBS, per_job,
+                                best, BENCH_POOL_JOBS / best, single / best);
+                }
+                else
+                {
+                        fprintf(stdout, "%s,%u,%d,%zu,%.6f,%.0f,%.2f\n", bp->name, workers, BENCH_POOL_JOBS, per_job,
+                                best, BENCH_POOL_JOBS / best, single / best);
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        program_free(program);
+        free(inputs);
+        free(results);
+        free(jobs);
+        return 0;
+}
+
+/**
+ * @brief Runs one single-tuple job on a context
+ * @param vm Pointer to the context
+ * @param program Program of the job
+ * @param inputs Input tuple
+ * @param arity Number of values of the tuple
+ * @return Top of stack after HALT
+ */
+static cell_t bench_job(stackvm_t *vm, program_t *program, const cell_t *inputs, uint32_t arity)
+{
+        attach_program(vm, program);
+        stackvm_set_engine(vm, ENGINE_THREADED);
+        memcpy(vm->stack, inputs, arity * sizeof(cell_t));
+        vm->sp = arity - 1;
+        stackvm_run(vm);
+        return (vm->sp != (uint32_t)-1) ? vm->stack[vm->sp] : 0;
+}
+
+/**
+ * @brief Measures the setup cost of short jobs for growing stack sizes
+ * @param bp Program run by every job
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note Every job runs the program once on a context that is either created and freed,
+ *       reset between jobs, or acquired from and released to a slab.
+ */
+static int bench_slab(const bench_program_t *bp, bool json)
+{
+        static const uint32_t sizes[]   = { 1024, 16384, 262144 };
+        static const char *const kinds[] = { "create", "reset", "slab" };
+        program_t *program = program_create(bp->code, bp->size);
+        cell_t inputs[BENCH_MAX_ARITY];
+        if (!program)
+        {
+                fprintf(stderr, "Error: Failed to set up the context benchmark\n");
+                return -1;
+        }
+        for (uint32_t i = 0; i < bp->arity; i++)
+        {
+                inputs[i] = (cell_t)(i * 2654435761u >> 7) % 64;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "program,setup,stack_size,jobs,seconds,ns_per_job\n");
+        }
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+                stackvm_config_t config = { .stack_size = sizes[s] };
+                for (int kind = 0; kind < 3; kind++)
+                {
+                        slab_t *slab  = (kind == 2) ? slab_create(&config, 0) : NULL;
+                        stackvm_t *vm = (kind == 1) ? stackvm_create(&config) : NULL;
+                        if ((kind == 2 && !slab) || (kind == 1 && !vm))
+                        {
+                                fprintf(stderr, "Error: Failed to create the contexts\n");
+                                return -1;
+                        }
+                        double best = 0.0;
+                        cell_t sum  = 0;
+                        for (int r = 0; r < BENCH_REPEAT; r++)
+                        {
+                                double start = bench_now();
+                                for (int j = 0; j < BENCH_SLAB_JOBS; j++)
+                                {
+                                        if (kind == 1)
+                                        {
+                                                stackvm_reset(vm);
+                                                sum += bench_job(vm, program, inputs, bp->arity);
+                                                continue;
+                                        }
+                                        stackvm_t *job = (kind == 2) ? slab_acquire(slab) : stackvm_create(&config);
+                                        if (!job)
+                                        {
+                                                fprintf(stderr, "Error: Failed to create the context\n");
+                                                return -1;
+                                        }
+                                        sum += bench_job(job, program, inputs, bp->arity);
+                                        stackvm_free(job);
+                                }
+                                double seconds = bench_now() - start;
+                                best = (r == 0 || seconds < best) ? seconds : best;
+                        }
+                        if (vm)
+                        {
+                                stackvm_free(vm);
+                        }
+                        slab_free(slab);
+
+                        if (json)
+                        {
+                                fprintf(stdout, "%s  {\"program\": \"%s\", \"setup\": \"%s\", \"stack_size\": %u, \"jobs\": %d, "
+                                        "\"seconds\": %.6f, \"ns_per_job\": %.1f}", (s == 0 && kind == 0) ? "" : ",\n",
+                                        bp->name, kinds[kind], sizes[s], BENCH_SLAB_JOBS, best, best * 1e9 / BENCH_SLAB_JOBS);
+                        }
+                        else
+                        {
+                                fprintf(stdout, "%s,%s,%u,%d,%.6f,%.1f\n", bp->name, kinds[kind], sizes[s], BENCH_SLAB_JOBS,
+                                        best, best * 1e9 / BENCH_SLAB_JOBS);
+                        }
+                        if (sum == INT64_MIN)
+                        {
+                                fprintf(stderr, "\n");                 // Keeps the results alive
+                        }
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        program_free(program);
+        return 0;
+}
+
+/**
+ * @brief Measures a warm start by replaying the setup prefix against restoring a snapshot
+ * @param bp Program of the warm start, a loop long enough to pause inside
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note The replay creates a context and runs BENCH_WARM_INSTRUCTIONS instructions with `stackvm_run_for`,
+ *       the restore maps the snapshot taken at that point. Both continue to HALT with the same result.
+ */
+static int bench_snapshot(const bench_program_t *bp, bool json)
+{
+        static const char *const kinds[] = { "replay", "restore" };
+        program_t *program = program_create(bp->code, bp->size);
+        stackvm_t *warm    = program ? stackvm_create(NULL) : NULL;
+        if (!warm)
+        {
+                fprintf(stderr, "Error: Failed to set up the warm start benchmark\n");
+                return -1;
+        }
+        attach_program(warm, program);
+        warm->stack[++warm->sp] = BENCH_WARM_INSTRUCTIONS;      // Enough iterations to pause inside the loop
+        snapshot_t *snapshot = (stackvm_run_for(warm, BENCH_WARM_INSTRUCTIONS) == RUN_PAUSED) ? snapshot_take(warm) : NULL;
+        stackvm_run(warm);
+        cell_t expected = warm->stack[warm->sp];
+        stackvm_free(warm);
+        if (!snapshot)
+        {
+                fprintf(stderr, "Error: Failed to take the snapshot\n");
+                return -1;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "program,start,instructions,starts,seconds,us_per_start\n");
+        }
+        for (int kind = 0; kind < 2; kind++)
+        {
+                double best = 0.0;
+                for (int r = 0; r < BENCH_REPEAT; r++)
+                {
+                        double start = bench_now();
+                        for (int j = 0; j < BENCH_WARM_STARTS; j++)
+                        {
+                                stackvm_t *vm = (kind == 1) ? snapshot_restore(snapshot) : stackvm_create(NULL);
+                                if (!vm)
+                                {
+                                        fprintf(stderr, "Error: Failed to start the context\n");
+                                        return -1;
+                                }
+                                if (kind == 0)
+                                {
+                                        attach_program(vm, program);
+                                        vm->stack[++vm->sp] = BENCH_WARM_INSTRUCTIONS;
+                                        stackvm_run_for(vm, BENCH_WARM_INSTRUCTIONS);
+                                }
+                                if (j == 0 && r == 0)
+                                {
+                                        stackvm_run(vm);
+                                        if (vm->stack[vm->sp] != expected)
+                                        {
+                                                fprintf(stderr, "Error: The %s start computed a different result\n", kinds[kind]);
+                                                return -1;
+                                        }
+                                }
+                                stackvm_free(vm);
+                        }
+                        double seconds = bench_now() - start;
+                        best = (r == 0 || seconds < best) ? seconds : best;
+                }
+                if (json)
+                {
+                        fprintf(stdout, "%s  {\"program\": \"%s\", \"start\": \"%s\", \"instructions\": %d, \"starts\": %d, "
+                                "\"seconds\": %.6f, \"us_per_start\": %.2f}", kind ? ",\n" : "", bp->name, kinds[kind],
+                                BENCH_WARM_INSTRUCTIONS, BENCH_WARM_STARTS, best, best * 1e6 / BENCH_WARM_STARTS);
+                }
+                else
+                {
+                        fprintf(stdout, "%s,%s,%d,%d,%.6f,%.2f\n", bp->name, kinds[kind], BENCH_WARM_INSTRUCTIONS,
+                                BENCH_WARM_STARTS, best, best * 1e6 / BENCH_WARM_STARTS);
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        snapshot_close(snapshot);
+        program_free(program);
+        return 0;
+}
+
+/**
+ * @brief Measures the per-value cost of feeding values to a program
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note The `run` handoff resets the context, pushes one value and runs `3 * x + 1` to HALT for every value,
+ *       the `channel` handoff runs one looping program that reads every value with IN and writes the result
+ *       with OUT. The host fills the input channel and drains the output channel in place, one ring at a time.
+ */
+static int bench_stream(bool json)
+{
+        static const char *const kinds[] = { "run", "channel" };
+        const uint32_t kernel[] = { PUSH(3), OP(MUL), PUSH(1), OP(ADD), OP(HALT) };
+        const uint32_t stream[] = { OP(IN), PUSH(3), OP(MUL), PUSH(1), OP(ADD), OP(OUT), OP(BR), 0 };
+        program_t *programs[2]  = { program_create(kernel, 5), program_create(stream, 8) };
+        if (!programs[0] || !programs[1])
+        {
+                fprintf(stderr, "Error: Failed to set up the stream benchmark\n");
+                return -1;
+        }
+        cell_t expected = 0;
+        for (uint32_t i = 0; i < BENCH_STREAM_VALUES; i++)
+        {
+                expected += 3 * (cell_t)(i % 1000) + 1;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "engine,handoff,values,seconds,ns_per_value\n");
+        }
+        for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+                for (int kind = 0; kind < 2; kind++)
+                {
+                        stackvm_t *vm = stackvm_create(NULL);
+                        if (!vm)
+                        {
+                                fprintf(stderr, "Error: Failed to create the StackVM context\n");
+                                return -1;
+                        }
+                        stackvm_set_engine(vm, engine);
+                        attach_program(vm, programs[kind]);
+                        double best = 0.0;
+                        for (int r = 0; r < BENCH_REPEAT; r++)
+                        {
+                                channel_t *in  = channel_create(BENCH_STREAM_CAPACITY);
+                                channel_t *out = channel_create(BENCH_STREAM_CAPACITY);
+                                if (!in || !out)
+                                {
+                                        fprintf(stderr, "Error: Failed to create the channels\n");
+                                        return -1;
+                                }
+                                stackvm_reset(vm);
+                                stackvm_channels(vm, in, out);
+                                cell_t sum   = 0;
+                                double start = bench_now();
+                                for (uint32_t sent = 0; kind == 0 && sent < BENCH_STREAM_VALUES; sent++)
+                                {
+                                        stackvm_reset(vm);
+                                        vm->stack[++vm->sp] = (cell_t)(sent % 1000);
+                                        stackvm_run(vm);
+                                        sum += vm->stack[vm->sp];
+                                }
+                                for (uint32_t sent = 0; kind == 1 && vm->state != STATE_HALT; )
+                                {
+                                        uint32_t room;
+                                        cell_t *cells = channel_reserve(in, &room);
+                                        room = (BENCH_STREAM_VALUES - sent < room) ? BENCH_STREAM_VALUES - sent : room;
+                                        for (uint32_t i = 0; i < room; i++)
+                                        {
+                                                cells[i] = (cell_t)((sent + i) % 1000);
+                                        }
+                                        channel_commit(in, room);
+                                        sent += room;
+                                        if (sent == BENCH_STREAM_VALUES)
+                                        {
+                                                channel_close(in);      // The program halts once it drained the input
+                                        }
+                                        stackvm_run(vm);                // Runs until the input is empty or the output full
+                                        uint32_t ready;
+                                        const cell_t *results = channel_peek(out, &ready);
+                                        while (ready)
+                                        {
+                                                for (uint32_t i = 0; i < ready; i++)
+                                                {
+                                                        sum += results[i];
+                                                }
+                                                channel_consume(out, ready);
+                                                results = channel_peek(out, &ready); // The ring may wrap
+                                        }
+                                }
+                                double seconds = bench_now() - start;
+                                best = (r == 0 || seconds < best) ? seconds : best;
+                                stackvm_channels(vm, NULL, NULL);
+                                channel_free(in);
+                                channel_free(out);
+                                if (sum != expected || vm->error != ERROR_NONE)
+                                {
+                                        fprintf(stderr, "Error: The %s handoff on the %s engine computed a different result\n",
+                                                kinds[kind], stackvm_engine_name(engine));
+                                        return -1;
+                                }
+                        }
+                        stackvm_free(vm);
+
+                        if (json)
+                        {
+                                fprintf(stdout, "%s  {\"engine\": \"%s\", \"handoff\": \"%s\", \"values\": %d, "
+                                        "\"seconds\": %.6f, \"ns_per_value\": %.1f}", (engine == 0 && kind == 0) ? "" : ",\n",
+                                        stackvm_engine_name(engine), kinds[kind], BENCH_STREAM_VALUES, best, best * 1e9 / BENCH_STREAM_VALUES);
+                        }
+                        else
+                        {
+                                fprintf(stdout, "%s,%s,%d,%.6f,%.1f\n", stackvm_engine_name(engine), kinds[kind],
+                                        BENCH_STREAM_VALUES, best, best * 1e9 / BENCH_STREAM_VALUES);
+                        }
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        program_free(programs[0]);
+        program_free(programs[1]);
+        return 0;
+}
+
+/**
+ * @brief Native function of the native call benchmark
+ * @param args Two arguments, replaced by their exclusive or
+ * @param data Unused
+ * @return true
+ */
+static bool bench_xor(cell_t *args, void *data)
+{
+        (void)data;
+        args[0] ^= args[1];
+        return true;
+}
+
+/**
+ * @brief Measures the cost of a native call against the built-in opcode doing the same work
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note Both programs loop `BENCH_NATIVE_CALLS` times over the value on top of the stack, the `opcode`
+ *       loop applies XOR and the `native` loop calls a registered native function doing the same.
+ *       The loop counter lives in local slot 0, below the value.
+ */
+static int bench_native(bool json)
+{
+        static const char *const kinds[] = { "opcode", "native" };
+        int index = native_register("bench_xor", 2, 1, bench_xor, NULL);
+        const uint32_t opcode[] = { PUSH(7), OP(XOR), OP(LOAD_LOCAL), 0, PUSH(1), OP(SUB), OP(STORE_LOCAL), 0, OP(BRNZ), 0, OP(HALT) };
+        const uint32_t native[] = { PUSH(7), OP(CALL_NATIVE), (uint32_t)index, OP(LOAD_LOCAL), 0, PUSH(1), OP(SUB), OP(STORE_LOCAL), 0, OP(BRNZ), 0, OP(HALT) };
+        program_t *programs[2]  = { NULL, NULL };
+        if (index < 0 || !(programs[0] = program_create(opcode, 11)) || !(programs[1] = program_create(native, 12)))
+        {
+                fprintf(stderr, "Error: Failed to set up the native call benchmark\n");
+                program_free(programs[0]);
+                return -1;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "engine,call,calls,seconds,ns_per_call\n");
+        }
+        for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+                for (int kind = 0; kind < 2; kind++)
+                {
+                        stackvm_t *vm = stackvm_create(NULL);
+                        if (!vm)
+                        {
+                                fprintf(stderr, "Error: Failed to create the StackVM context\n");
+                                return -1;
+                        }
+                        stackvm_set_engine(vm, engine);
+                        attach_program(vm, programs[kind]);
+                        double best = 0.0;
+                        for (int r = 0; r < BENCH_REPEAT; r++)
+                        {
+                                stackvm_reset(vm);
+                                vm->stack[++vm->sp] = BENCH_NATIVE_CALLS;      // Local slot 0, the loop counter
+                                vm->stack[++vm->sp] = 5;
+                                double start = bench_now();
+                                stackvm_run(vm);
+                                double seconds = bench_now() - start;
+                                best = (r == 0 || seconds < best) ? seconds : best;
+                                if (vm->error != ERROR_NONE || vm->sp != 1 || vm->stack[1] != 5)
+                                {
+                                        fprintf(stderr, "Error: The %s loop on the %s engine computed a different result\n",
+                                                kinds[kind], stackvm_engine_name(engine));
+                                        return -1;
+                                }
+                        }
+                        stackvm_free(vm);
+
+                        if (json)
+                        {
+                                fprintf(stdout, "%s  {\"engine\": \"%s\", \"call\": \"%s\", \"calls\": %d, "
+                                        "\"seconds\": %.6f, \"ns_per_call\": %.2f}", (engine == 0 && kind == 0) ? "" : ",\n",
+                                        stackvm_engine_name(engine), kinds[kind], BENCH_NATIVE_CALLS, best, best * 1e9 / BENCH_NATIVE_CALLS);
+                        }
+                        else
+                        {
+                                fprintf(stdout, "%s,%s,%d,%.6f,%.2f\n", stackvm_engine_name(engine), kinds[kind],
+                                        BENCH_NATIVE_CALLS, best, best * 1e9 / BENCH_NATIVE_CALLS);
+                        }
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        program_free(programs[0]);
+        program_free(programs[1]);
+        return 0;
+}
+
+/**
+ * @brief Measures the throughput of the assembler on a generated multi-megabyte source
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note The source repeats a block with a label, pushes, a LIT, comments and branches to the next
+ *       and to the previous label, so every block patches a forward reference. `buffer` assembles
+ *       the source in place, `stream` reads it through a FILE in ASM_CHUNK_SIZE chunks like svmasm.
+ */
+static int bench_asm(bool json)
+{
+        static const char *const kinds[] = { "buffer", "stream" };
+        char *source = malloc(BENCH_ASM_BYTES + 256);
+        if (!source)
+        {
+                fprintf(stderr, "Error: Failed to allocate the assembler source\n");
+                return -1;
+        }
+        size_t length = 0;
+        size_t lines  = 0;
+        for (uint32_t i = 0; length < BENCH_ASM_BYTES; i++)
+        {
+                length += (size_t)sprintf(source + length,
+                        "L%u:\n        push %u             ; block %u\n        lit %llu\n        add\n"
+                        "        push -%u\n        lt\n        brf L%u     # forward\n        brt L%u\n",
+                        i, i % 1000, i, 5000000000ull + i, i % 77, i + 1, i);
+                lines += 8;
+                if (length >= BENCH_ASM_BYTES)
+                {
+                        length += (size_t)sprintf(source + length, "L%u:\n        halt\n", i + 1);
+                        lines  += 2;
+                }
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "input,bytes,lines,words,seconds,mb_per_second\n");
+        }
+        size_t words[2] = { 0, 0 };
+        for (int kind = 0; kind < 2; kind++)
+        {
+                double best = 0.0;
+                for (int r = 0; r < BENCH_REPEAT; r++)
+                {
+                        asm_error_t error;
+                        FILE *in       = (kind == 1) ? fmemopen(source, length, "r") : NULL;
+                        double start   = bench_now();
+                        uint32_t *code = (kind == 1) ? (in ? asm_assemble(in, &words[kind], &error) : NULL)
+                                                     : asm_assemble_buffer(source, length, &words[kind], &error);
+                        double seconds = bench_now() - start;
+                        if (in)
+                        {
+                                fclose(in);
+                        }
+                        if (!code)
+                        {
+                                fprintf(stderr, "Error: Failed to assemble the generated source\n");
+                                free(source);
+                                return -1;
+                        }
+                        free(code);
+                        best = (r == 0 || seconds < best) ? seconds : best;
+                }
+                if (words[kind] != words[0])
+                {
+                        fprintf(stderr, "Error: The %s assembler emitted a different program\n", kinds[kind]);
+                        free(source);
+                        return -1;
+                }
+
+                double mbps = (double)length / best / 1e6;
+                if (json)
+                {
+                        fprintf(stdout, "%s  {\"input\": \"%s\", \"bytes\": %zu, \"lines\": %zu, \"words\": %zu, "
+                                "\"seconds\": %.6f, \"mb_per_second\": %.1f}", (kind == 0) ? "" : ",\n",
+                                kinds[kind], length, lines, words[kind], best, mbps);
+                }
+                else
+                {
+                        fprintf(stdout, "%s,%zu,%zu,%zu,%.6f,%.1f\n", kinds[kind], length, lines, words[kind], best, mbps);
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        free(source);
+        return 0;
+}
+
+/**
+ * @brief Measures the cost of the runtime metrics on every engine
+ * @param bp Program run by every job
+ * @param json Print JSON instead of CSV
+ * @return 0 on success, -1 on failure
+ * @note Every job resets the context and runs the program once, with the metrics of the context off
+ *       and on. Short jobs show the fixed cost of a counted run, the overhead is relative to `off`.
+ */
+static int bench_metrics(const bench_program_t *bp, bool json)
+{
+        static const char *const kinds[] = { "off", "on" };
+        program_t *program = program_create(bp->code, bp->size);
+        cell_t inputs[BENCH_MAX_ARITY];
+        if (!program)
+        {
+                fprintf(stderr, "Error: Failed to set up the metrics benchmark\n");
+                return -1;
+        }
+        for (uint32_t i = 0; i < bp->arity; i++)
+        {
+                inputs[i] = (cell_t)(i * 2654435761u >> 7) % 64;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "program,engine,metrics,jobs,seconds,ns_per_job,overhead_percent\n");
+        }
+        for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+                double baseline = 0.0;
+                for (int kind = 0; kind < 2; kind++)
+                {
+                        stackvm_t *vm = stackvm_create(NULL);
+                        if (!vm)
+                        {
+                                fprintf(stderr, "Error: Failed to create the StackVM context\n");
+                                return -1;
+                        }
+                        if (kind == 1 && stackvm_metrics(vm, true) != 0)
+                        {
+                                stackvm_free(vm);
+                                return -1;
+                        }
+                        stackvm_set_engine(vm, engine);
+                        attach_program(vm, program);
+                        double best = 0.0;
+                        for (int r = 0; r < BENCH_REPEAT; r++)
+                        {
+                                double start = bench_now();
+                                for (int j = 0; j < BENCH_SLAB_JOBS; j++)
+                                {
+                                        stackvm_reset(vm);
+                                        memcpy(vm->stack, inputs, bp->arity * sizeof(cell_t));
+                                        vm->sp = bp->arity - 1;
+                                        stackvm_run(vm);
+                                }
+                                double seconds = bench_now() - start;
+                                best = (r == 0 || seconds < best) ? seconds : best;
+                                if (vm->error != ERROR_NONE)
+                                {
+                                        fprintf(stderr, "Error: The '%s' program failed on the %s engine\n",
+                                                bp->name, stackvm_engine_name(engine));
+                                        return -1;
+                                }
+                        }
+                        stackvm_free(vm);
+                        baseline = (kind == 0) ? best : baseline;
+                        double overhead = (best - baseline) * 100.0 / baseline;
+
+                        if (json)
+                        {
+                                fprintf(stdout, "%s  {\"program\": \"%s\", \"engine\": \"%s\", \"metrics\": \"%s\", \"jobs\": %d, "
+                                        "\"seconds\": %.6f, \"ns_per_job\": %.1f, \"overhead_percent\": %.1f}",
+                                        (engine == 0 && kind == 0) ? "" : ",\n", bp->name, stackvm_engine_name(engine), kinds[kind],
+                                        BENCH_SLAB_JOBS, best, best * 1e9 / BENCH_SLAB_JOBS, overhead);
+                        }
+                        else
+                        {
+                                fprintf(stdout, "%s,%s,%s,%d,%.6f,%.1f,%.1f\n", bp->name, stackvm_engine_name(engine), kinds[kind],
+                                        BENCH_SLAB_JOBS, best, best * 1e9 / BENCH_SLAB_JOBS, overhead);
+                        }
+                }
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        program_free(program);
+        return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+        bool json     = false;
+        bool pool     = false;
+        bool slab     = false;
+        bool warm     = false;
+        bool stream   = false;
+        bool native   = false;
+        bool metrics  = false;
+        bool assemble = false;
+        size_t tuples = BENCH_TUPLES;
+        for (int i = 1; i < argc; i++)
+        {
+                if (strcmp(argv[i], "--json") == 0)
+                {
+                        json = true;
+                }
+                else if (strcmp(argv[i], "--csv") == 0)
+                {
+                        json = false;
+                }
+                else if (strcmp(argv[i], "--pool") == 0)
+                {
+                        pool = true;
+                }
+                else if (strcmp(argv[i], "--slab") == 0)
+                {
+                        slab = true;
+                }
+                else if (strcmp(argv[i], "--snapshot") == 0)
+                {
+                        warm = true;
+                }
+                else if (strcmp(argv[i], "--stream") == 0)
+                {
+                        stream = true;
+                }
+                else if (strcmp(argv[i], "--native") == 0)
+                {
+                        native = true;
+                }
+                else if (strcmp(argv[i], "--metrics") == 0)
+                {
+                        metrics = true;
+                }
+                else if (strcmp(argv[i], "--asm") == 0)
+                {
+                        assemble = true;
+                }
+                else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0)
+                {
+                        tuples = (size_t)atol(argv[++i]);
+                }
+                else
+                {
+                        fprintf(stderr, "Usage: %s [--csv | --json] [--pool | --slab | --snapshot | --stream | --native | --metrics | --asm] [-n <tuples>]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+        tuples = (tuples + BENCH_PERIOD - 1) / BENCH_PERIOD * BENCH_PERIOD; // Whole periods only
+
+        static bench_program_t programs[6];
+        bench_arith(&programs[0]);
+        bench_branch(&programs[1]);
+        bench_loop(&programs[2]);
+        bench_call(&programs[3]);
+        bench_deep(&programs[4]);
+        bench_empty(&programs[5]);
+        if (pool)
+        {
+                return (bench_pool(&programs[3], json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE; // The call workload
+        }
+        if (slab)
+        {
+                return (bench_slab(&programs[0], json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (warm)
+        {
+                return (bench_snapshot(&programs[2], json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE; // The loop workload
+        }
+        if (stream)
+        {
+                return (bench_stream(json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (native)
+        {
+                return (bench_native(json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (metrics)
+        {
+                return (bench_metrics(&programs[1], json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE; // The branch workload
+        }
+        if (assemble)
+        {
+                return (bench_asm(json) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        cell_t *inputs    = malloc(tuples * BENCH_MAX_ARITY * sizeof(cell_t));
+        cell_t *results   = malloc(tuples * sizeof(cell_t));
+        if (!inputs || !results)
+        {
+                fprintf(stderr, "Error: Failed to allocate the inputs\n");
+                return EXIT_FAILURE;
+        }
+
+        if (json)
+        {
+                fprintf(stdout, "[\n");
+        }
+        else
+        {
+                fprintf(stdout, "program,engine,tuples,instructions,seconds,instructions_per_second,ns_per_instruction,peak_stack_depth\n");
+        }
+
+        bool first = true;
+        for (size_t p = 0; p < sizeof(programs) / sizeof(programs[0]); p++)
+        {
+                bench_program_t *bp = &programs[p];
+                for (size_t i = 0; i < tuples * bp->arity; i++)
+                {
+                        size_t tuple  = (i / bp->arity) % BENCH_PERIOD;
+                        inputs[i]     = (cell_t)((tuple * 2654435761u + i % bp->arity * 40503u) >> 7) % 64;
+                }
+
+                program_t *program = program_create(bp->code, bp->size);
+                bench_result_t count;
+                if (!program || bench_count(program, inputs, bp->arity, &count) != 0)
+                {
+                        fprintf(stderr, "Error: Failed to run the '%s' program\n", bp->name);
+                        return EXIT_FAILURE;
+                }
+
+                for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+                {
+                        stackvm_config_t config = { .stack_size = BENCH_MAX_ARITY + 16 };
+                        stackvm_t *vm = stackvm_create(&config);
+                        if (!vm)
+                        {
+                                fprintf(stderr, "Error: Failed to create the StackVM context\n");
+                                return EXIT_FAILURE;
+                        }
+                        stackvm_set_engine(vm, engine);
+                        attach_program(vm, program);
+
+                        bench_result_t result = count;
+                        result.instructions   = count.instructions * (tuples / BENCH_PERIOD);
+                        result.seconds        = 0.0;
+                        stackvm_run_batch(vm, inputs, bp->arity, tuples, results); // Warm up
+                        for (int r = 0; r < BENCH_REPEAT; r++)
+                        {
+                                double start = bench_now();
+                                stackvm_run_batch(vm, inputs, bp->arity, tuples, results);
+                                double seconds = bench_now() - start;
+                                if (r == 0 || seconds < result.seconds)
+                                {
+                                        result.seconds = seconds;
+                                }
+                        }
+                        stackvm_free(vm);
+
+                        double ips = result.instructions ? (double)result.instructions / result.seconds : 0.0;
+                        double ns  = result.instructions ? result.seconds * 1e9 / (double)result.instructions : 0.0;
+                        if (json)
+                        {
+                                fprintf(stdout, "%s  {\"program\": \"%s\", \"engine\": \"%s\", \"tuples\": %zu, \"instructions\": %llu, "
+                                        "\"seconds\": %.6f, \"instructions_per_second\": %.0f, \"ns_per_instruction\": %.3f, "
+                                        "\"peak_stack_depth\": %u}",
+                                        first ? "" : ",\n", bp->name, stackvm_engine_name(engine), tuples,
+                                        (unsigned long long)result.instructions, result.seconds, ips, ns, result.peak);
+                        }
+                        else
+                        {
+                                fprintf(stdout, "%s,%s,%zu,%llu,%.6f,%.0f,%.3f,%u\n",
+                                        bp->name, stackvm_engine_name(engine), tuples,
+                                        (unsigned long long)result.instructions, result.seconds, ips, ns, result.peak);
+                        }
+                        first = false;
+                }
+                program_free(program);
+        }
+        if (json)
+        {
+                fprintf(stdout, "\n]\n");
+        }
+        free(inputs);
+        free(results);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/***
+ *
+ * @file: asm.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the text assembler and disassembler of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef ASM_H
+#define ASM_H
+
+#include "stackvm.h"
+
+#define ASM_CHUNK_SIZE          (64 * 1024)     // Bytes read from the source at a time, also the longest line
+
+/**
+ * @brief Assembler error
+ * @note `line` is 0 when the error is not tied to a source line.
+ */
+typedef struct asm_error
+{
+        size_t line;                    // Source line of the error, starting at 1
+        char message[128];              // Description of the error
+} asm_error_t;
+
+/**
+ * @brief Assembles a source file
+ * @param in Source stream, read in chunks of ASM_CHUNK_SIZE bytes
+ * @param size Pointer receiving the number of instruction words
+ * @param error Pointer receiving the error on failure, may be NULL
+ * @return Instruction words allocated with malloc on success, NULL on failure
+ * @note Every line holds an optional `label:` followed by an optional instruction and an optional
+ *       `;` or `#` comment. Instructions are the mnemonics of PRIMITIVE_INSTRUCTION_TYPE, `push <value>`
+ *       and `.word <value>` emitting a raw word. BR, BRT and BRF take a label or an absolute address.
+ *       `push` encodes values outside [IMMEDIATE_MIN, IMMEDIATE_MAX] as LIT, `lit <value>` always does.
+ *       The source is parsed in a single pass, branches to labels defined further down are patched
+ *       once the whole source was read.
+ */
+uint32_t *asm_assemble(FILE *in, size_t *size, asm_error_t *error);
+
+/**
+ * @brief Assembles a source held in memory
+ * @param source Source text, does not have to be NUL-terminated
+ * @param length Length of the source in bytes
+ * @param size Pointer receiving the number of instruction words
+ * @param error Pointer receiving the error on failure, may be NULL
+ * @return Instruction words allocated with malloc on success, NULL on failure
+ * @note The source is parsed in place without being copied.
+ */
+uint32_t *asm_assemble_buffer(const char *source, size_t length, size_t *size, asm_error_t *error);
+
+/**
+ * @brief Disassembles a program
+ * @param out Output stream
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @return 0 on success, -1 on failure
+ * @note Branch targets that start an instruction are given `L<address>` labels, words that do not
+ *       decode to an instruction are written as `.word`, so the output assembles back to the same words.
+ */
+int asm_disassemble(FILE *out, const uint32_t *code, size_t size);
+
+/**
+ * @brief Prints one instruction
+ * @param out Output stream
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @param pc Address of the instruction, below `size`
+ * @return Number of words the instruction occupies, at least 1
+ * @note Prints the same text as `asm_disassemble` without indentation, labels or newline,
+ *       branch targets are plain addresses.
+ */
+size_t asm_print(FILE *out, const uint32_t *code, size_t size, size_t pc);
+
+#endif // ASM_H
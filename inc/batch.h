@@ -0,0 +1,37 @@
+/***
+ *
+ * @file: batch.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the batch execution API of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "stackvm.h"
+
+/**
+ * @brief Runs the attached program once for every input tuple
+ * @param vm Pointer to the StackVM context with the program attached
+ * @param inputs Input tuples, tuple `i` occupies `inputs[i * arity]` to `inputs[i * arity + arity - 1]`
+ * @param arity Number of values per input tuple
+ * @param count Number of input tuples
+ * @param results Caller-provided buffer of `count` results
+ * @return Number of tuples evaluated, the batch stops at the first tuple whose run faulted
+ * @note Before every run the tuple is pushed onto the operand stack, first value at the bottom,
+ *       and the program starts at its first instruction. The result of a run is the top of stack
+ *       after HALT, or 0 when the stack is empty.
+ *       The context is set up once for the whole batch: between tuples only the registers are
+ *       rewound, memory is neither cleared nor allocated.
+ *       On ENGINE_VECTOR straight-line programs are evaluated several tuples at a time in SIMD lanes,
+ *       except for the last tuple: it runs on the scalar engines, so the stack, flags and error of the
+ *       context are the ones of its run whichever engine evaluated the others.
+ */
+size_t stackvm_run_batch(stackvm_t *vm, const cell_t *inputs, uint32_t arity, size_t count, cell_t *results);
+
+#endif // BATCH_H
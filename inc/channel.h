@@ -0,0 +1,183 @@
+/***
+ *
+ * @file: channel.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the ring buffer channels that stream values into and out of a StackVM context
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdalign.h>
+
+#include "stackvm.h"
+
+#define CHANNEL_CACHE_LINE      64              // The producer and consumer indices never share a cache line
+
+/**
+ * @brief Outcome of a channel transfer
+ */
+typedef enum channel_status
+{
+        CHANNEL_OK              = 0,            // The value was transferred
+        CHANNEL_BLOCKED,                        // The channel is empty or full, retry once the other side moved
+        CHANNEL_CLOSED,                         // The channel is empty and its producer closed it
+} channel_status_t;
+
+/**
+ * @brief Single-producer single-consumer ring buffer of cells
+ * @note The indices only ever grow, a cell lives at `index & mask`. Each side owns one index and keeps
+ *       a cached copy of the other one, so a transfer only reads the shared index of the other side
+ *       when its cached copy says the ring is empty or full.
+ *       The VM reads its input channel with IN and writes its output channel with OUT, the host is
+ *       the other side of both.
+ */
+typedef struct channel
+{
+        cell_t *cells;                                          // Ring of `mask + 1` cells
+        uint32_t mask;                                          // Capacity minus one, the capacity is a power of two
+        alignas(CHANNEL_CACHE_LINE) uint64_t head;              // Next cell read, written by the consumer
+        uint64_t tail_cache;                                    // Last tail seen by the consumer
+        alignas(CHANNEL_CACHE_LINE) uint64_t tail;              // Next cell written, written by the producer
+        uint64_t head_cache;                                    // Last head seen by the producer
+        bool closed;                                            // The producer writes no more values
+} channel_t;
+
+/**
+ * @brief Creates a channel
+ * @param capacity Cells of the ring, rounded up to a power of two
+ * @return Pointer to the channel on success, NULL on failure
+ */
+channel_t *channel_create(uint32_t capacity);
+
+/**
+ * @brief Frees a channel
+ * @param channel Pointer to the channel, may be NULL
+ * @return void
+ * @note Contexts the channel is attached to must not run anymore.
+ */
+void channel_free(channel_t *channel);
+
+/**
+ * @brief Reserves free cells for the producer to fill in place
+ * @param channel Pointer to the channel
+ * @param count Receives the number of contiguous free cells, 0 when the channel is full
+ * @return Pointer to the first free cell
+ * @note Zero-copy side of `channel_write`, the cells are handed to the consumer with `channel_commit`.
+ *       The free cells may wrap around the end of the ring, reserve again after committing.
+ */
+cell_t *channel_reserve(channel_t *channel, uint32_t *count);
+
+/**
+ * @brief Hands filled cells to the consumer
+ * @param channel Pointer to the channel
+ * @param count Number of cells filled, at most the count of the last `channel_reserve`
+ * @return void
+ */
+void channel_commit(channel_t *channel, uint32_t count);
+
+/**
+ * @brief Looks at the values waiting for the consumer in place
+ * @param channel Pointer to the channel
+ * @param count Receives the number of contiguous values, 0 when the channel is empty
+ * @return Pointer to the first value
+ * @note Zero-copy side of `channel_read`, the values are released with `channel_consume`.
+ */
+const cell_t *channel_peek(channel_t *channel, uint32_t *count);
+
+/**
+ * @brief Releases values read in place
+ * @param channel Pointer to the channel
+ * @param count Number of values read, at most the count of the last `channel_peek`
+ * @return void
+ */
+void channel_consume(channel_t *channel, uint32_t count);
+
+/**
+ * @brief Copies values into a channel
+ * @param channel Pointer to the channel
+ * @param values Values to be written
+ * @param count Number of values
+ * @return Number of values written, less than `count` when the channel filled up
+ */
+uint32_t channel_write(channel_t *channel, const cell_t *values, uint32_t count);
+
+/**
+ * @brief Copies values out of a channel
+ * @param channel Pointer to the channel
+ * @param values Receives the values
+ * @param count Largest number of values to be read
+ * @return Number of values read, less than `count` when the channel ran empty
+ */
+uint32_t channel_read(channel_t *channel, cell_t *values, uint32_t count);
+
+/**
+ * @brief Marks the end of the stream
+ * @param channel Pointer to the channel
+ * @return void
+ * @note Called by the producer after its last value. A context reading the closed channel
+ *       halts once it drained the values written before.
+ */
+void channel_close(channel_t *channel);
+
+/**
+ * @brief Takes one value out of a channel
+ * @param channel Pointer to the channel
+ * @param value Receives the value
+ * @return CHANNEL_OK, CHANNEL_BLOCKED when the channel is empty or CHANNEL_CLOSED when it is also closed
+ * @note Consumer side, used by IN. The closed flag is only read when the channel looks empty
+ *       and the tail is read again after it, so no value written before `channel_close` is lost.
+ */
+static inline channel_status_t channel_get(channel_t *channel, cell_t *value)
+{
+        uint64_t head = channel->head;
+        if (head == channel->tail_cache)
+        {
+                channel->tail_cache = __atomic_load_n(&channel->tail, __ATOMIC_ACQUIRE);
+                if (head == channel->tail_cache)
+                {
+                        if (!__atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE))
+                        {
+                                return CHANNEL_BLOCKED;
+                        }
+                        channel->tail_cache = __atomic_load_n(&channel->tail, __ATOMIC_ACQUIRE);
+                        if (head == channel->tail_cache)
+                        {
+                                return CHANNEL_CLOSED;
+                        }
+                }
+        }
+        *value = channel->cells[head & channel->mask];
+        __atomic_store_n(&channel->head, head + 1, __ATOMIC_RELEASE);
+        return CHANNEL_OK;
+}
+
+/**
+ * @brief Puts one value into a channel
+ * @param channel Pointer to the channel
+ * @param value Value to be written
+ * @return CHANNEL_OK, or CHANNEL_BLOCKED when the channel is full
+ * @note Producer side, used by OUT.
+ */
+static inline channel_status_t channel_put(channel_t *channel, cell_t value)
+{
+        uint64_t tail = channel->tail;
+        if (tail - channel->head_cache > channel->mask)
+        {
+                channel->head_cache = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+                if (tail - channel->head_cache > channel->mask)
+                {
+                        return CHANNEL_BLOCKED;
+                }
+        }
+        channel->cells[tail & channel->mask] = value;
+        __atomic_store_n(&channel->tail, tail + 1, __ATOMIC_RELEASE);
+        return CHANNEL_OK;
+}
+
+#endif // CHANNEL_H
@@ -40,7 +40,33 @@ typedef enum PRIMITIVE_INSTRUCTION_TYPE
         BR,
         BRT,
         BRF,
-        RET,
+        RET,            // Return to the address saved by CALL and drop its frame
+
+        // Wide immediate instructions
+        LIT,            // Push the 64-bit value held in the next two words, low word first
+
+        // Flag instructions, the branches take their target from the next word and pop nothing
+        CMP,            // Pop two values and set the flags from their difference
+        BRZ,            // Branch if Z is set
+        BRNZ,           // Branch if Z is clear
+        BRLT,           // Branch if N != V, signed less than after CMP or SUB
+        BRGE,           // Branch if N == V, signed greater or equal
+        BRGT,           // Branch if Z is clear and N == V, signed greater than
+        BRLE,           // Branch if Z is set or N != V, signed less or equal
+
+        // Call instructions, the operand word is the target or the signed local slot
+        CALL,           // Push a frame returning after the target word and jump to the target
+        LOAD_LOCAL,     // Push the value of a local slot of the current frame
+        STORE_LOCAL,    // Pop the top of stack into a local slot of the current frame
+
+        // Channel instructions, they wait for the host when the channel is empty or full
+        IN,             // Push the next value of the input channel, halt at the end of the stream
+        OUT,            // Pop the top of stack into the output channel
+
+        // Native instructions, the operand word is the index of a registered native function
+        CALL_NATIVE,    // Replace the arguments on the stack with the results of the native function
+
+        PRIMITIVE_COUNT,
 } PRIMITIVE_INSTRUCTION_TYPE;
 
 
@@ -59,7 +85,16 @@ typedef enum PRIMITIVE_INSTRUCTION_TYPE
  * R - Reserved flag
  * R - Reserved flag
  * R - Reserved flag
+ *
+ * ADD, SUB, MUL, DIV, CMP and the comparisons set Z, N, C and V from their result, every other
+ * instruction leaves the flags alone. Comparisons and CMP set them like SUB, C is the unsigned
+ * carry of ADD and the borrow of SUB, V the signed overflow. MUL sets C and V together when the
+ * product wraps, DIV clears C and sets V for INT64_MIN / -1. I is never set.
  */
-// unsigned char FLAG_REGISTER;
+#define FLAG_Z                  0x80    // Zero flag
+#define FLAG_N                  0x40    // Negative flag
+#define FLAG_C                  0x20    // Carry flag
+#define FLAG_V                  0x10    // Overflow flag
+#define FLAG_I                  0x08    // Interrupt flag
 
 #endif // DEFS_H
\ No newline at end of file
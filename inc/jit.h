@@ -0,0 +1,39 @@
+/***
+ *
+ * @file: jit.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the x86-64 template JIT of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "stackvm.h"
+
+/**
+ * @brief Runs the attached program as native code
+ * @param vm Pointer to the StackVM context
+ * @return void
+ * @note The program is compiled on its first run and cached in the program, so every context
+ *       attached to it reuses the native code. Verified programs are compiled without
+ *       per-instruction checks and run natively when entered like the unchecked threaded code,
+ *       other programs are compiled with stack and call bound checks. `RET` jumps through a
+ *       dispatch table of the program addresses, the frame pointer and call stack live in the jit frame.
+ *       Traced runs, runs that do not meet the entry conditions, programs holding IN, OUT or CALL_NATIVE and
+ *       hosts other than x86-64 Linux fall back to the threaded engine.
+ */
+void stackvm_run_jit(stackvm_t *vm);
+
+/**
+ * @brief Frees the native code of a program
+ * @param code Native code cached in the program, may be NULL
+ * @return void
+ */
+void jit_free(struct jit_code *code);
+
+#endif // JIT_H
@@ -0,0 +1,90 @@
+/***
+ *
+ * @file: metrics.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the runtime metrics of the StackVM contexts and of the process
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "stackvm.h"
+
+#define METRICS_BUCKETS         24              // Buckets of the run latency histogram, the last one is unbounded
+#define METRICS_FIRST_BUCKET    128             // Upper bound of the first latency bucket in ns, every next bound doubles
+
+/**
+ * @brief Runtime counters of a context or of the process
+ * @note Counted when `stackvm_run` or `stackvm_run_for` returns, a run resumed after a pause is a run of its own.
+ *       The instructions retired are the ones dispatched, like the budget of `stackvm_run_for` counts them:
+ *       the instruction that halted or faulted the run is included, a superinstruction of the optimizer or
+ *       a block of the JIT counts every instruction it replaces. Bucket `i` of the histogram counts the runs
+ *       that took at most `METRICS_FIRST_BUCKET << i` ns, and more for the last bucket.
+ */
+typedef struct metrics
+{
+        uint64_t runs;                          // Runs
+        uint64_t instructions;                  // Instructions retired
+        uint64_t halts[ERROR_COUNT];            // Runs that halted by reason, ERROR_NONE counts HALT
+        uint64_t pauses;                        // Runs that paused on the budget or on a channel
+        uint64_t peak_depth;                    // Deepest operand stack of any run in cells
+        uint64_t latency[METRICS_BUCKETS];      // Runs by latency
+        uint64_t latency_sum;                   // Latency of every run in ns
+} metrics_t;
+
+/**
+ * @brief Starts the measurement of a run
+ * @return Clock at the start of the run in ns
+ */
+uint64_t metrics_begin(void);
+
+/**
+ * @brief Counts a run in the context and in the process
+ * @param vm Pointer to the StackVM context counting its runs
+ * @param start Clock returned by `metrics_begin`
+ * @return void
+ * @note The counted engine variants leave the instructions retired in `vm->retired` and the deepest
+ *       stack they dispatched an instruction with in `vm->peak`, the final depth is added to it.
+ *       The process counters live in a shard of the calling thread that only that thread writes,
+ *       so contexts running on different threads never contend.
+ */
+void metrics_end(stackvm_t *vm, uint64_t start);
+
+/**
+ * @brief Adds up the counters of every thread
+ * @param total Receives the counters of the process
+ * @return void
+ * @note Thread-safe, the shards are read while their threads keep counting. The shard of a thread
+ *       outlives the thread, so the counters of the process never go backwards.
+ */
+void metrics_collect(metrics_t *total);
+
+/**
+ * @brief Writes counters in the Prometheus text exposition format
+ * @param out Output stream
+ * @param metrics Counters of a context or of the process
+ * @return 0 on success, -1 on failure
+ */
+int metrics_write(FILE *out, const metrics_t *metrics);
+
+/**
+ * @brief Writes the counters of the process to a file
+ * @param path Path of the file, replaced atomically for the scrapers reading it
+ * @return 0 on success, -1 on failure
+ */
+int metrics_save(const char *path);
+
+/**
+ * @brief Sends the counters of the process to a Unix domain socket
+ * @param path Path of a listening stream socket
+ * @return 0 on success, -1 on failure
+ * @note Connects, writes the whole exposition and closes the connection.
+ */
+int metrics_send(const char *path);
+
+#endif // METRICS_H
@@ -0,0 +1,85 @@
+/***
+ *
+ * @file: native.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the registry of native functions called by the CALL_NATIVE instruction
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "stackvm.h"
+
+#define NATIVE_MAX              1024            // Native functions a process can register
+
+/**
+ * @brief Native function
+ * @param args Arguments on the operand stack, `args[0]` was pushed first
+ * @param data Pointer registered with the function
+ * @return true on success, false to halt the program with ERROR_NATIVE_FAILED
+ * @note The function reads its `arity` arguments in place and writes its `results` starting at `args[0]`,
+ *       they replace the arguments on the stack. It may run on any thread running a context.
+ */
+typedef bool (*native_fn_t)(cell_t *args, void *data);
+
+/**
+ * @brief Entry of the native function table
+ * @note CALL_NATIVE indexes the table with its operand word, nothing is looked up by name at run time.
+ */
+typedef struct native
+{
+        native_fn_t fn;                    // Function
+        void *data;                        // Pointer passed to every call
+        uint8_t arity;                     // Arguments popped from the stack
+        uint8_t results;                   // Results pushed onto the stack
+        char *name;                        // Name used by the assembler
+} native_t;
+
+extern native_t native_table[NATIVE_MAX]; // Registered functions, the first `native_count()` entries are valid
+extern uint32_t native_registered;        // Number of registered functions, published after the entry
+
+/**
+ * @brief Registers a native function
+ * @param name Unique name of the function
+ * @param arity Arguments popped from the stack
+ * @param results Results pushed onto the stack
+ * @param fn Function
+ * @param data Pointer passed to every call of the function
+ * @return Index of the function for CALL_NATIVE, -1 on failure
+ * @note Thread-safe. Functions are never unregistered, so indices stay valid for the life of the process.
+ *       Programs calling a function are verified against its arity, register it before creating them.
+ */
+int native_register(const char *name, uint8_t arity, uint8_t results, native_fn_t fn, void *data);
+
+/**
+ * @brief Finds a native function by name
+ * @param name Name of the function
+ * @return Index of the function, -1 if no function has that name
+ */
+int native_find(const char *name);
+
+/**
+ * @brief Returns the number of registered native functions
+ * @return Number of functions, every index below it is valid
+ */
+static inline uint32_t native_count(void)
+{
+        return __atomic_load_n(&native_registered, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Returns a registered native function
+ * @param index Index of the function
+ * @return Pointer to the table entry, NULL if no function has that index
+ */
+static inline const native_t *native_get(uint32_t index)
+{
+        return (index < native_count()) ? &native_table[index] : NULL;
+}
+
+#endif // NATIVE_H
@@ -0,0 +1,47 @@
+/***
+ *
+ * @file: optimize.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the peephole optimizer of the threaded code
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "program.h"
+
+#ifndef STACKVM_OPTIMIZE
+#define STACKVM_OPTIMIZE        1               // Optimize the unchecked threaded code, 0 translates it word for word
+#endif
+
+/**
+ * @brief Translates a verified program into optimized unchecked threaded code
+ * @param program Pointer to the verified program
+ * @param removed Receives the number of instructions removed by the optimizer
+ * @return Pointer to the threaded code on success, NULL on failure
+ * @note Constant subexpressions are folded, including `NOT` and conditional branches on a constant,
+ *       `push imm; OP` is fused into one immediate superinstruction and a comparison followed by
+ *       `BRF` or `BRT` into one compare-and-branch superinstruction.
+ *       Instructions are never combined across a branch target, branch targets are remapped to
+ *       the rewritten code and every entry remembers the program address it came from.
+ *       Flag-setting instructions are only folded away when `flags_dead` holds.
+ */
+struct thread_cache *thread_optimize(const program_t *program, uint32_t *removed);
+
+/**
+ * @brief Tells whether the flags set by an instruction are overwritten before anything reads them
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @param pc Address of the flag-setting instruction
+ * @return true if the straight-line code after `pc` sets the flags again before a branch,
+ *         a flag branch, a possible fault or the end of the program
+ * @note Pushes can fault on a checked run, so the answer only holds for verified programs run unchecked.
+ */
+bool flags_dead(const uint32_t *code, uint32_t size, uint32_t pc);
+
+#endif // OPTIMIZE_H
@@ -0,0 +1,128 @@
+/***
+ *
+ * @file: pool.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the work-stealing job scheduler of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "stackvm.h"
+
+#define POOL_MAX_WORKERS        256             // Largest number of worker threads
+#define POOL_DEQUE_SIZE         1024            // Jobs held by the deque of one worker, a power of two
+
+/**
+ * @brief Job of the scheduler
+ * @note A job runs a program once per input tuple like `stackvm_run_batch`. The caller owns the job
+ *       and everything it points to, and keeps them alive and untouched from `pool_submit` until
+ *       `pool_await` or `pool_wait` returned.
+ */
+typedef struct pool_job
+{
+        program_t *program;                // Program to run
+        const cell_t *inputs;              // Input tuples, `arity` values each
+        uint32_t arity;                    // Number of values per input tuple
+        size_t count;                      // Number of input tuples
+        cell_t *results;                   // Caller-provided buffer of `count` results
+        size_t done;                       // Tuples evaluated, the job stops at the first tuple that faulted
+        vm_error_t error;                  // Error of the faulting tuple, ERROR_NONE if every tuple ran
+        uint32_t worker;                   // Worker that ran the job
+        uint32_t finished;                 // Set once the results are written, read with `pool_await`
+        struct pool_job *next;             // Link of the submission queue, owned by the scheduler
+} pool_job_t;
+
+/**
+ * @brief Configuration of a scheduler
+ * @note Zero fields take their defaults: one worker per online CPU and the default context configuration.
+ */
+typedef struct pool_config
+{
+        uint32_t workers;                  // Number of worker threads
+        engine_t engine;                   // Execution engine of every context
+        stackvm_config_t vm;               // Segment sizes of the contexts
+        bool metrics;                      // Count the runs of every context, see `stackvm_metrics`
+} pool_config_t;
+
+/**
+ * @brief Statistics of one worker
+ * @note Counters grow for the lifetime of the scheduler and are read without stopping the worker.
+ */
+typedef struct pool_stats
+{
+        uint64_t jobs;                     // Jobs run
+        uint64_t tuples;                   // Input tuples evaluated
+        uint64_t stolen;                   // Jobs taken from the deques of other workers
+        uint64_t refills;                  // Batches moved from the submission queue to the own deque
+        uint64_t parks;                    // Times the worker slept for lack of work
+        uint64_t busy_ns;                  // Time spent running jobs in nanoseconds
+} pool_stats_t;
+
+typedef struct pool pool_t;
+
+/**
+ * @brief Creates a scheduler and starts its worker threads
+ * @param config Configuration of the scheduler, NULL for the defaults
+ * @return Pointer to the scheduler on success, NULL on failure
+ * @note Every worker owns one pre-allocated context for the whole lifetime of the scheduler
+ *       and a deque of jobs. Submitted jobs enter a shared queue, idle workers move a share of it
+ *       into their own deque and workers that run dry steal from the deques of the others.
+ */
+pool_t *pool_create(const pool_config_t *config);
+
+/**
+ * @brief Waits for every submitted job, stops the worker threads and frees the scheduler
+ * @param pool Pointer to the scheduler, may be NULL
+ * @return void
+ */
+void pool_free(pool_t *pool);
+
+/**
+ * @brief Submits jobs
+ * @param pool Pointer to the scheduler
+ * @param jobs Array of jobs
+ * @param count Number of jobs
+ * @return void
+ * @note Thread-safe. The whole array enters the submission queue under one lock,
+ *       so submitting many jobs at once costs one lock and one wake-up.
+ */
+void pool_submit(pool_t *pool, pool_job_t *jobs, size_t count);
+
+/**
+ * @brief Waits until a job has finished
+ * @param pool Pointer to the scheduler
+ * @param job Pointer to a submitted job
+ * @return Error of the job, ERROR_NONE if every tuple ran
+ */
+vm_error_t pool_await(pool_t *pool, pool_job_t *job);
+
+/**
+ * @brief Waits until every submitted job has finished
+ * @param pool Pointer to the scheduler
+ * @return void
+ */
+void pool_wait(pool_t *pool);
+
+/**
+ * @brief Returns the number of worker threads
+ * @param pool Pointer to the scheduler
+ * @return Number of workers
+ */
+uint32_t pool_workers(const pool_t *pool);
+
+/**
+ * @brief Reads the statistics of a worker
+ * @param pool Pointer to the scheduler
+ * @param worker Index of the worker, below `pool_workers`
+ * @param stats Receives the statistics
+ * @return 0 on success, -1 if the worker does not exist
+ */
+int pool_stats(const pool_t *pool, uint32_t worker, pool_stats_t *stats);
+
+#endif // POOL_H
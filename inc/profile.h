@@ -0,0 +1,166 @@
+/***
+ *
+ * @file: profile.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the instruction-level profiler of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PROFILE_PERIOD          64              // Instructions between two timed instructions
+#define PROFILE_NONE            UINT32_MAX      // No instruction
+
+#if defined(__x86_64__)
+#define PROFILE_UNIT            "TSC cycles"    // Unit of the profile ticks
+#else
+#define PROFILE_UNIT            "ns"            // Unit of the profile ticks
+#endif
+
+/**
+ * @brief Counters of one program address
+ */
+typedef struct profile_counter
+{
+        uint64_t hits;                  // Executions of the instruction
+        uint64_t taken;                 // Executions that branched to the target
+        uint64_t samples;               // Executions that were timed
+        uint64_t ticks;                 // Clock ticks of the timed executions
+        uint32_t target;                // Branch target, PROFILE_NONE for instructions that always fall through
+} profile_counter_t;
+
+/**
+ * @brief Instruction profile of a StackVM context
+ * @note Every executed instruction bumps the hit counter of its address. A branch is counted as
+ *       taken when the next instruction executed is its target. Every PROFILE_PERIOD-th instruction
+ *       is timed from the end of its hook to the start of the next one, with the cost of reading the
+ *       clock measured once and subtracted. The ticks are TSC cycles on x86-64 and nanoseconds elsewhere.
+ */
+typedef struct profile
+{
+        const uint32_t *code;           // Program words of the profiled program
+        uint32_t size;                  // Number of program words
+        profile_counter_t *counters;    // Counters of every program address
+        uint64_t runs;                  // Runs profiled
+        uint32_t branch;                // Branch executed last, PROFILE_NONE once its outcome is counted
+        uint32_t timed;                 // Instruction being timed, PROFILE_NONE when none is
+        uint32_t countdown;             // Instructions until the next timed one
+        uint64_t stamp;                 // Clock at the end of the hook of the timed instruction
+        uint64_t overhead;              // Ticks of two back-to-back clock reads
+} profile_t;
+
+/**
+ * @brief Creates a profile
+ * @param code Pointer to the program words, may be NULL
+ * @param size Number of program words
+ * @return Pointer to the profile on success, NULL on failure
+ */
+profile_t *profile_open(const uint32_t *code, uint32_t size);
+
+/**
+ * @brief Frees a profile
+ * @param profile Pointer to the profile, may be NULL
+ * @return void
+ */
+void profile_close(profile_t *profile);
+
+/**
+ * @brief Points a profile at a program
+ * @param profile Pointer to the profile
+ * @param code Pointer to the program words, may be NULL
+ * @param size Number of program words
+ * @return 0 on success, -1 on failure
+ * @note The counters are kept when the program is unchanged and cleared otherwise.
+ */
+int profile_bind(profile_t *profile, const uint32_t *code, uint32_t size);
+
+/**
+ * @brief Reads the profiling clock
+ * @return Ticks since an arbitrary point
+ */
+static inline uint64_t profile_clock(void)
+{
+#if defined(__x86_64__)
+        return __builtin_ia32_rdtsc();
+#else
+        struct timespec now;
+        timespec_get(&now, TIME_UTC);
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Counts one instruction
+ * @param profile Pointer to the profile
+ * @param pc Program counter of the instruction, below the program size
+ * @return void
+ * @note Called by the engines before every instruction through the same hooks as the trace,
+ *       but only on runs with profiling enabled.
+ */
+static inline void profile_step(profile_t *profile, uint32_t pc)
+{
+        profile_counter_t *counters = profile->counters;
+        if (profile->timed != PROFILE_NONE)
+        {
+                uint64_t ticks = profile_clock() - profile->stamp;
+                counters[profile->timed].ticks += (ticks > profile->overhead) ? ticks - profile->overhead : 0;
+                counters[profile->timed].samples++;
+                profile->timed = PROFILE_NONE;
+        }
+        if (profile->branch != PROFILE_NONE)
+        {
+                counters[profile->branch].taken += (pc == counters[profile->branch].target);
+                profile->branch = PROFILE_NONE;
+        }
+        counters[pc].hits++;
+        if (counters[pc].target != PROFILE_NONE)
+        {
+                profile->branch = pc;
+        }
+        if (--profile->countdown == 0)
+        {
+                profile->countdown = PROFILE_PERIOD;
+                profile->timed     = pc;
+                profile->stamp     = profile_clock();   // Last, so the hook itself is not timed
+        }
+        return;
+}
+
+/**
+ * @brief Ends a profiled run
+ * @param profile Pointer to the profile
+ * @return void
+ * @note Called by `stackvm_run`. A branch that was the last instruction of the run left the program, so it was taken.
+ */
+void profile_end(profile_t *profile);
+
+/**
+ * @brief Prints the flat profile
+ * @param out Output stream
+ * @param profile Pointer to the profile
+ * @return void
+ * @note One line per executed opcode sorted by count, with the estimated ticks of every opcode
+ *       extrapolated from the timed executions of each address.
+ */
+void profile_report(FILE *out, const profile_t *profile);
+
+/**
+ * @brief Prints the annotated disassembly
+ * @param out Output stream
+ * @param profile Pointer to the profile
+ * @return void
+ * @note Every instruction is prefixed with its hits, its share of the run, its mean ticks
+ *       and, for branches, how often it was taken.
+ */
+void profile_annotate(FILE *out, const profile_t *profile);
+
+#endif // PROFILE_H
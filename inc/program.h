@@ -0,0 +1,124 @@
+/***
+ *
+ * @file: program.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the read-only program (code segment) shared by StackVM contexts
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PROGRAM_MAGIC           0x504d5653      // "SVMP" in little endian
+#define PROGRAM_VERSION         1               // Version of the binary program format
+
+/**
+ * @brief Header of a binary program file
+ * @note The header is followed by the code section and the optional constants section.
+ *       Sections are made of little-endian 32-bit words and start at 4-byte aligned offsets,
+ *       the checksum is the CRC-32 of the code section followed by the constants section.
+ */
+typedef struct program_header
+{
+        uint32_t magic;                    // PROGRAM_MAGIC
+        uint16_t version;                  // PROGRAM_VERSION
+        uint16_t flags;                    // Reserved, 0
+        uint32_t code_offset;              // Offset of the code section in bytes
+        uint32_t code_size;                // Size of the code section in words
+        uint32_t constants_offset;         // Offset of the constants section in bytes, 0 when there is none
+        uint32_t constants_size;           // Size of the constants section in words
+        uint32_t checksum;                 // CRC-32 of the sections
+        uint32_t reserved;                 // Reserved, 0
+} program_header_t;
+
+/**
+ * @brief Program of the StackVM
+ * @note A program owns a read-only code segment and everything derived from it,
+ *       such as the threaded code of the threaded engine.
+ *       A program is loaded once and can be attached to any number of StackVM contexts,
+ *       it must outlive every context it is attached to.
+ */
+typedef struct program
+{
+        const uint32_t *code;              // Read-only code segment
+        uint32_t size;                     // Size of the code segment in words
+        const uint32_t *constants;         // Read-only constants section, NULL when there is none
+        uint32_t constants_size;           // Size of the constants section in words
+        const void *mapping;               // Mapping holding the code segment, the whole file for loaded programs
+        size_t mapped;                     // Size of the mapping in bytes
+        struct thread_cache *threaded;     // Unchecked threaded code, only translated for verified programs
+        uint32_t removed;                  // Instructions removed from the unchecked threaded code by the optimizer
+        struct thread_cache *checked;      // Checked threaded code shared by every context running the program
+        struct jit_code *jit;              // Native code, compiled by the first run on the JIT engine
+        struct jit_code *jit_counted;      // Native code counting the instructions and the stack depth, compiled by the first counted run
+        struct vector_program *vector;     // Vectorized program, prepared by the first batch on the vector engine
+        bool verified;                     // The program passed the verifier
+        uint32_t entry_depth;              // Values the program pops below the stack depth it was entered with
+        uint32_t max_depth;                // Values the program pushes above the stack depth it was entered with
+        uint32_t max_frames;               // Deepest nesting of frames pushed by CALL
+        const char *verify_error;          // Why the verifier rejected the program, NULL if verified
+        uint32_t verify_pc;                // Address of the instruction rejected by the verifier
+} program_t;
+
+/**
+ * @brief Creates a program from an array of instruction words
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @return Pointer to the program on success, NULL on failure
+ * @note The instruction words are copied into a code segment that is made read-only,
+ *       the caller keeps ownership of `code`.
+ *       The program is verified once here: verified programs run without per-instruction
+ *       checks whenever the stack they are entered with is deep and large enough,
+ *       every other program runs fully checked.
+ *       The unchecked threaded code of a verified program is rewritten by the peephole optimizer.
+ */
+program_t *program_create(const uint32_t *code, size_t size);
+
+/**
+ * @brief Loads a program from a binary program file
+ * @param path Path of the file
+ * @return Pointer to the program on success, NULL on failure
+ * @note The file is mapped read-only and shared, the code segment points into the mapping,
+ *       so the code is never copied and every process loading the file shares the same pages.
+ *       The header, the section bounds and the checksum are validated before the program is verified.
+ */
+program_t *program_open(const char *path);
+
+/**
+ * @brief Writes a binary program file
+ * @param path Path of the file
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @param constants Pointer to the constants, may be NULL
+ * @param count Number of constants
+ * @return 0 on success, -1 on failure
+ */
+int program_save(const char *path, const uint32_t *code, size_t size, const uint32_t *constants, size_t count);
+
+/**
+ * @brief Continues a CRC-32 over a block of bytes
+ * @param crc CRC-32 of the preceding blocks, 0 for the first block
+ * @param data Pointer to the block
+ * @param size Size of the block in bytes
+ * @return CRC-32 of every block so far
+ * @note The checksum of the program and snapshot files.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size);
+
+/**
+ * @brief Frees a program
+ * @param program Pointer to the program
+ * @return void
+ * @note No StackVM context may still be attached to the program.
+ */
+void program_free(program_t *program);
+
+#endif // PROGRAM_H
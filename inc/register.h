@@ -0,0 +1,42 @@
+/***
+ *
+ * @file: register.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the register-caching execution engine of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef REGISTER_H
+#define REGISTER_H
+
+#include "stackvm.h"
+
+/**
+ * @brief Runs the attached program with the register-caching engine
+ * @param vm Pointer to the StackVM context
+ * @return void
+ * @note Every program word is decoded when it runs and dispatched through a table of handler addresses.
+ *       The program counter, the stack pointer and the top of stack live in locals for the whole run,
+ *       the stack segment only holds the values below the top of stack. The registers are written
+ *       back to the context when the VM halts, when it faults and before every trace hook.
+ *       Verified programs run without per-instruction checks under the same conditions as on the
+ *       threaded engine, every other run is fully checked.
+ */
+void stackvm_run_register(stackvm_t *vm);
+
+/**
+ * @brief Runs the attached program with the register-caching engine for at most a number of instructions
+ * @param vm Pointer to the StackVM context
+ * @param budget Instruction budget of the run
+ * @return void
+ * @note The budget is counted down in a local before every instruction. When it runs out the registers
+ *       are written back and the context is left in STATE_PAUSED on the next instruction.
+ *       Budgeted runs of the threaded, vector and JIT engines take this entry point as well.
+ */
+void stackvm_run_register_for(stackvm_t *vm, uint64_t budget);
+
+#endif // REGISTER_H
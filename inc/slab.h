@@ -0,0 +1,81 @@
+/***
+ *
+ * @file: slab.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the slab allocator that recycles StackVM contexts
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "stackvm.h"
+
+#define SLAB_DEFAULT_COUNT      64              // Contexts carved from one arena by default
+
+/**
+ * @brief Statistics of a slab
+ */
+typedef struct slab_stats
+{
+        uint64_t acquired;                 // Contexts handed out
+        uint64_t arenas;                   // Arenas allocated
+        uint32_t contexts;                 // Contexts carved from the arenas
+        uint32_t idle;                     // Contexts waiting on the free list
+} slab_stats_t;
+
+typedef struct slab slab_t;
+
+/**
+ * @brief Creates a slab of StackVM contexts
+ * @param config Segment sizes shared by every context of the slab, NULL for the defaults
+ * @param count Contexts carved from each arena, 0 for SLAB_DEFAULT_COUNT
+ * @return Pointer to the slab on success, NULL on failure
+ * @note An arena is one zeroed allocation holding `count` contexts with their stack, data and call
+ *       stack segments, each context on its own cache lines. The first arena is allocated here and
+ *       another one whenever the free list runs dry.
+ */
+slab_t *slab_create(const stackvm_config_t *config, uint32_t count);
+
+/**
+ * @brief Frees a slab and all of its arenas
+ * @param slab Pointer to the slab, may be NULL
+ * @return void
+ * @note Every context acquired from the slab must have been released before.
+ */
+void slab_free(slab_t *slab);
+
+/**
+ * @brief Takes a context from the slab
+ * @param slab Pointer to the slab
+ * @return Pointer to a context in its initial state, NULL if a new arena could not be allocated
+ * @note Thread-safe. The context is used like one of `stackvm_create` and handed back with
+ *       `stackvm_free(vm)`. The most recently released context is handed out first while its
+ *       cache lines are still warm.
+ */
+stackvm_t *slab_acquire(slab_t *slab);
+
+/**
+ * @brief Returns a context to its slab
+ * @param slab Pointer to the slab the context was acquired from
+ * @param vm Pointer to the context, its program, trace and profile already dropped
+ * @return void
+ * @note Called by `stackvm_free`. The context is reset, which clears only the stack cells below
+ *       its high-water mark, so recycling costs the same for every configured stack size.
+ *       The data segment keeps what the host wrote into it.
+ */
+void slab_release(slab_t *slab, stackvm_t *vm);
+
+/**
+ * @brief Reads the statistics of a slab
+ * @param slab Pointer to the slab
+ * @param stats Receives the statistics
+ * @return void
+ */
+void slab_stats(slab_t *slab, slab_stats_t *stats);
+
+#endif // SLAB_H
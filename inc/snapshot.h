@@ -0,0 +1,115 @@
+/***
+ *
+ * @file: snapshot.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the snapshots that save and restore the state of a StackVM context
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "stackvm.h"
+
+#define SNAPSHOT_MAGIC          0x534d5653      // "SVMS" in little endian
+#define SNAPSHOT_VERSION        1               // Version of the snapshot format
+#define SNAPSHOT_ALIGN          65536           // Alignment of the memory image, a multiple of every page size
+
+/**
+ * @brief Header of a snapshot
+ * @note The header is followed by the code section of the program and the call stack section,
+ *       the memory image starts at a SNAPSHOT_ALIGN aligned offset and spans the guard cell, the stack
+ *       and the data segment of the context. Only the live stack cells and the data segment up to its
+ *       last non-zero cell are written, the rest of the image is a hole of the file and reads as zeros.
+ *       The checksum is the CRC-32 of the header with a zero checksum, the code and the call stack.
+ */
+typedef struct snapshot_header
+{
+        uint32_t magic;                    // SNAPSHOT_MAGIC
+        uint16_t version;                  // SNAPSHOT_VERSION
+        uint8_t state;                     // State of the context
+        uint8_t flags;                     // Flag register
+        uint32_t pc;                       // Program counter
+        uint32_t sp;                       // Stack pointer
+        uint32_t fp;                       // Frame pointer
+        uint32_t calls;                    // Frames on the call stack
+        uint32_t engine;                   // Execution engine
+        uint32_t code_size;                // Largest program accepted by the context in words
+        uint32_t stack_size;               // Size of the operand stack segment in cells
+        uint32_t data_size;                // Size of the data segment in cells
+        uint32_t call_size;                // Size of the call stack in frames
+        uint32_t program_offset;           // Offset of the code section in bytes
+        uint32_t program_size;             // Size of the code section in words
+        uint32_t frames_offset;            // Offset of the call stack section in bytes
+        uint32_t checksum;                 // CRC-32 of the header and the sections
+        uint32_t reserved;                 // Reserved, 0
+        uint64_t memory_offset;            // Offset of the memory image in bytes
+        uint64_t memory_size;              // Size of the memory image in bytes
+} snapshot_header_t;
+
+/**
+ * @brief Snapshot of a StackVM context
+ * @note The snapshot lives in a file, or in an anonymous memory file for `snapshot_take`,
+ *       so every context restored from it maps the same pages.
+ */
+typedef struct snapshot
+{
+        snapshot_header_t header;          // Registers and layout
+        int fd;                            // File holding the snapshot
+        program_t *program;                // Program every restored context runs
+        frame_t *frames;                   // Call stack copied into every restored context
+        bool owns_program;                 // The program was loaded from the snapshot and is freed with it
+} snapshot_t;
+
+/**
+ * @brief Takes a snapshot of a context
+ * @param vm Pointer to the StackVM context with a program attached
+ * @return Pointer to the snapshot on success, NULL on failure
+ * @note The snapshot is written into an anonymous memory file. It refers to the program of the
+ *       context, which must outlive the snapshot and every context restored from it.
+ *       The trace and the profile are not part of the snapshot.
+ */
+snapshot_t *snapshot_take(const stackvm_t *vm);
+
+/**
+ * @brief Writes a snapshot of a context to a file
+ * @param vm Pointer to the StackVM context with a program attached
+ * @param path Path of the file
+ * @return 0 on success, -1 on failure
+ * @note The file holds a copy of the program, it is sparse where the memory image is zero.
+ */
+int snapshot_save(const stackvm_t *vm, const char *path);
+
+/**
+ * @brief Opens a snapshot file
+ * @param path Path of the file
+ * @return Pointer to the snapshot on success, NULL on failure
+ * @note The header, the section bounds and the checksum are validated and the program is created
+ *       and verified once here, every context restored from the snapshot shares it.
+ */
+snapshot_t *snapshot_open(const char *path);
+
+/**
+ * @brief Closes a snapshot
+ * @param snapshot Pointer to the snapshot, may be NULL
+ * @return void
+ * @note Contexts restored from a snapshot that owns its program must be freed before.
+ */
+void snapshot_close(snapshot_t *snapshot);
+
+/**
+ * @brief Restores a snapshot into a fresh context
+ * @param snapshot Pointer to the snapshot
+ * @return Pointer to the context on success, NULL on failure
+ * @note The stack and data segments of the context are a private copy-on-write mapping of the memory
+ *       image, so restoring costs one mmap whatever the segment sizes are and the contexts share
+ *       every page none of them wrote to. The context continues exactly where the snapshot was taken,
+ *       a paused context with `stackvm_run_for` or `stackvm_run`, and is released with `stackvm_free`.
+ */
+stackvm_t *snapshot_restore(const snapshot_t *snapshot);
+
+#endif // SNAPSHOT_H
@@ -16,27 +16,99 @@
 #define GET_TYPE(instr)         (((instr) & 0xc0000000) >> 30) // Macro to get the type of instruction
 #define GET_DATA(instr)         (((instr) & 0x3fffffff))       // Macro to get the data of instruction
 #define GET_OPCODE(instr)       (((instr) | 0x40000000))       // Macro to create an instruction from PRIMITIVE_INSTRUCTION_TYPE
+#define GET_IMMEDIATE(instr)    ((cell_t)(int32_t)(((instr) & 0x80000000) ? ((instr) | 0xc0000000) : GET_DATA(instr))) // Macro to get the sign-extended value of a push
+#define GET_PUSH(value)         ((((uint32_t)(value)) & 0x3fffffff) | (((value) < 0) ? 0x80000000 : 0)) // Macro to create a push from a value in [IMMEDIATE_MIN, IMMEDIATE_MAX]
+#define GET_WIDE(low, high)     ((cell_t)(((uint64_t)(high) << 32) | (uint32_t)(low)))                // Macro to get the value of a LIT from its operand words
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "defs.h"
+#include "trace.h"
+#include "profile.h"
+#include "program.h"
+
+typedef int64_t cell_t;                 // Value of an operand stack or data segment slot
+
+#define IMMEDIATE_MIN           (-(INT64_C(1) << 30))   // Smallest value of a push, NEGATIVE_INTEGER holds the low 30 bits of its two's complement
+#define IMMEDIATE_MAX           ((INT64_C(1) << 30) - 1) // Largest value of a push, wider values need LIT
+
+#ifndef STACK_MEMORY_SIZE
+#define STACK_MEMORY_SIZE       1024    // Default size of the operand stack segment in cells
+#endif
+#ifndef CODE_MEMORY_SIZE
+#define CODE_MEMORY_SIZE        1024    // Default size of the code segment in words
+#endif
+#ifndef DATA_MEMORY_SIZE
+#define DATA_MEMORY_SIZE        256     // Default size of the data segment in cells
+#endif
+#ifndef CALL_STACK_SIZE
+#define CALL_STACK_SIZE         256     // Default size of the call stack in frames
+#endif
+#define STACK_GUARD             1       // Cells below the operand stack, engines caching the top of stack spill into it
+#ifndef STACKVM_METRICS
+#define STACKVM_METRICS         1       // Count the instructions retired by every engine, 0 compiles the counting out
+#endif
+
 /**
  * @brief State of the StackVM
  * @note This enum defines the possible states of the StackVM.
- *       The state can be RESET, RUN, or HALT.
+ *       The state can be RESET, RUN, HALT or PAUSED.
  *       The state is used to control the execution flow of the StackVM.
  *       It determines whether the StackVM is ready to run, currently running,
- *       or has reached a halt condition.
+ *       has reached a halt condition, has used up the instruction budget of `stackvm_run_for`
+ *       or waits for the host to fill or drain a channel.
+ *       A PAUSED context continues at its program counter on the next run.
  */
 typedef enum state
 {
         STATE_RESET             = 0b00,
         STATE_RUN               = 0b01,
         STATE_HALT              = 0b10,
+        STATE_PAUSED            = 0b11,
 } state_t;
 
+/**
+ * @brief Outcome of a budgeted run
+ * @note Returned by `stackvm_run_for`.
+ */
+typedef enum run_status
+{
+        RUN_HALTED              = 0,            // The program reached a HALT instruction
+        RUN_PAUSED,                             // The instruction budget ran out or a channel waits for the host, the context is resumable
+        RUN_FAULTED,                            // The program halted abnormally, the error is in the context
+} run_status_t;
+
+/**
+ * @brief Errors of the StackVM
+ * @note This enum defines why the StackVM halted abnormally.
+ *       The error is kept in the context after the run, ERROR_NONE means the program
+ *       reached a HALT instruction.
+ */
+typedef enum vm_error
+{
+        ERROR_NONE              = 0,
+        ERROR_DIVISION_BY_ZERO,
+        ERROR_UNDEFINED_PRIMITIVE,
+        ERROR_UNDEFINED_INSTRUCTION,
+        ERROR_STACK_UNDERFLOW,
+        ERROR_STACK_OVERFLOW,
+        ERROR_INVALID_ADDRESS,
+        ERROR_INVALID_STAGE,
+        ERROR_NO_PROGRAM,
+        ERROR_CALL_OVERFLOW,
+        ERROR_CALL_UNDERFLOW,
+        ERROR_INVALID_LOCAL,
+        ERROR_NO_CHANNEL,
+        ERROR_UNDEFINED_NATIVE,
+        ERROR_NATIVE_FAILED,
+        ERROR_OUT_OF_MEMORY,
+        ERROR_COUNT,
+} vm_error_t;
+
 /**
  * @brief Instruction types for the StackVM
  * @note This enum defines the types of instructions that can be executed by the StackVM.
@@ -51,28 +123,255 @@ typedef enum instruction
         UNDEFINED_INSTRUCTION   = 0b11,
 } instr_t;
 
+/**
+ * @brief Execution engines of the StackVM
+ * @note This enum defines the engines that `stackvm_run` can use to execute a program.
+ *       ENGINE_STAGED walks every instruction through the fetch, decode and execute stages.
+ *       ENGINE_THREADED pre-decodes the loaded program into direct-threaded code and
+ *       dispatches every instruction with a single indirect jump.
+ *       ENGINE_VECTOR evaluates batches of straight-line programs with SIMD lanes,
+ *       single runs and programs it cannot vectorize run on the threaded engine.
+ *       ENGINE_REGISTER decodes the program words in a switch loop that keeps the program
+ *       counter, stack pointer and top of stack in locals for the whole run.
+ *       ENGINE_JIT compiles the program into x86-64 machine code on its first run.
+ *       All engines produce the same stack results for the same program.
+ */
+typedef enum engine
+{
+        ENGINE_STAGED           = 0,
+        ENGINE_THREADED         = 1,
+        ENGINE_VECTOR           = 2,
+        ENGINE_REGISTER         = 3,
+        ENGINE_JIT              = 4,
+        ENGINE_COUNT,
+} engine_t;
+
+/**
+ * @brief Segment sizes of a StackVM context
+ * @note The code segment is sized in 32-bit instruction words, the stack and data segments in cells
+ *       and the call stack in frames.
+ *       A size of 0 selects the default of the segment.
+ *       The code segment size bounds the programs accepted by `load_program`,
+ *       the stack and data segments are allocated by the context.
+ */
+typedef struct stackvm_config
+{
+        uint32_t code_size;                // Size of the code segment
+        uint32_t stack_size;               // Size of the operand stack segment
+        uint32_t data_size;                // Size of the data segment
+        uint32_t call_size;                // Size of the call stack
+} stackvm_config_t;
+
+/**
+ * @brief Call stack frame
+ * @note CALL pushes a frame and RET pops it. Local slot `n` of the running function is the
+ *       operand stack cell `fp + n`, so negative slots reach the arguments pushed by the caller.
+ */
+typedef struct frame
+{
+        uint32_t ret;                      // Return address, the word after the target of the CALL
+        uint32_t fp;                       // Frame pointer of the caller
+} frame_t;
+
 /**
  * @brief StackVM structure
  * @note This structure represents the state of the StackVM.
  *       It contains the program counter, stack pointer, memory pointer,
- *       instruction type, data register, current state, and a function pointer
- *       to the current instruction stage function.
+ *       instruction type, data register, current state, flag register, a function pointer
+ *       to the current instruction stage function and the selected execution engine.
+ *       The read-only code segment belongs to the attached program and may be shared with
+ *       other contexts, the operand stack and data segments are private to the context.
  */
 typedef struct stackvm
 {
         uint32_t pc;                       // Program counter
         uint32_t sp;                       // Stack pointer
-        void *memory;                      // Pointer to the memory
+        void *memory;                      // Pointer to the memory holding the stack and data segments
+        size_t mapping;                    // Bytes of the copy-on-write mapping of a snapshot holding the memory, 0 when allocated
         instr_t type;                      // Type of the instruction
         uint32_t data;                     // Data register
         state_t state;                     // Current state of the VM
+        uint8_t flags;                     // Flag register, FLAG_Z, FLAG_N, FLAG_C and FLAG_V of defs.h
+        vm_error_t error;                  // Reason of the last abnormal halt
         void (*stage)(struct stackvm *vm); // Current instruction stage function pointer
+        const uint32_t *code;              // Read-only code segment of the attached program
+        uint32_t size;                     // Size of the attached program in words
+        uint32_t code_size;                // Largest program accepted by load_program in words
+        cell_t *stack;                     // Operand stack segment
+        uint32_t stack_size;               // Size of the operand stack segment in cells
+        cell_t *data_segment;              // Data segment
+        uint32_t data_size;                // Size of the data segment in cells
+        frame_t *frames;                   // Call stack
+        uint32_t call_size;                // Size of the call stack in frames
+        uint32_t calls;                    // Frames on the call stack
+        uint32_t fp;                       // Frame pointer, the stack cell of local slot 0
+        uint32_t high;                     // Stack high-water mark, the cells runs may have written since the last reset
+        program_t *program;                // Attached program
+        bool owns_program;                 // The program was created by load_program and is freed with the context
+        engine_t engine;                   // Execution engine used by stackvm_run
+        struct thread_cache *threaded;     // Traced threaded code of the attached program
+        struct thread_cache *counted;      // Counting threaded code of the last counted run
+        void *lanes;                       // Lane stack of the vectorized batches, kept for the next batch
+        uint32_t lane_slots;               // Slots of the lane stack
+        trace_t *trace;                    // Trace sink, NULL when tracing is off
+        profile_t *profile;                // Instruction profile, NULL when profiling is off
+        struct metrics *metrics;           // Runtime counters, NULL when the runs are not counted
+        uint64_t retired;                  // Instructions retired by the last counted run
+        uint32_t peak;                     // Deepest stack of the last counted run in cells
+        struct slab *slab;                 // Slab the context is recycled into, NULL for contexts of stackvm_create
+        struct channel *in;                // Channel read by IN, NULL when none is attached
+        struct channel *out;               // Channel written by OUT, NULL when none is attached
 } stackvm_t;
 typedef void (*stage_t)(stackvm_t *vm);    // current instruction stage [Fetch, Decode, Execute]
 
+/**
+ * @brief Static properties of a primitive instruction
+ * @note Used by the engines, the verifier and the tools to agree on the stack effect of every opcode.
+ */
+typedef struct opcode_info
+{
+        const char *name;                  // Mnemonic
+        uint8_t pops;                      // Stack slots consumed
+        uint8_t pushes;                    // Stack slots produced
+        bool target;                       // Followed by a branch target word
+        uint8_t operands;                  // Operand words following the instruction word
+} opcode_info_t;
+
+/**
+ * @brief Cell arithmetic of the StackVM
+ * @note Results wrap around modulo 2^64 and division truncates toward zero, INT64_MIN / -1 wraps to INT64_MIN.
+ *       Every engine computes through these helpers or the matching machine instructions,
+ *       so overflowing programs produce the same values everywhere.
+ */
+static inline cell_t cell_add(cell_t a, cell_t b) { return (cell_t)((uint64_t)a + (uint64_t)b); }
+static inline cell_t cell_sub(cell_t a, cell_t b) { return (cell_t)((uint64_t)a - (uint64_t)b); }
+static inline cell_t cell_mul(cell_t a, cell_t b) { return (cell_t)((uint64_t)a * (uint64_t)b); }
+static inline cell_t cell_div(cell_t a, cell_t b) { return (b == -1) ? cell_sub(0, a) : a / b; } // b is never 0
+
+/**
+ * @brief Computes the flags set by an instruction
+ * @param opcode ADD, SUB, MUL, DIV, CMP or a comparison
+ * @param a Next on stack, the left operand
+ * @param b Top of stack, the right operand, never 0 for DIV
+ * @return Flag register after the instruction, `a` itself for any other opcode
+ * @note The threaded and register engines remember the opcode and operands of the last flag-setting
+ *       instruction and only call this when a flag branch or the end of the run needs the flags,
+ *       starting from HALT with the flags of the context in `a`.
+ */
+static inline uint8_t cell_flags(uint32_t opcode, cell_t a, cell_t b)
+{
+        cell_t result;
+        uint8_t flags;
+        switch (opcode)
+        {
+        case ADD:
+                result = cell_add(a, b);
+                flags  = (((uint64_t)result < (uint64_t)a) ? FLAG_C : 0) | ((((a ^ result) & (b ^ result)) < 0) ? FLAG_V : 0);
+                break;
+        case SUB: case CMP: case LT: case GT: case LE: case GE: case EQ: case NE:
+                result = cell_sub(a, b);
+                flags  = (((uint64_t)a < (uint64_t)b) ? FLAG_C : 0) | ((((a ^ b) & (a ^ result)) < 0) ? FLAG_V : 0);
+                break;
+        case MUL:
+                flags  = __builtin_mul_overflow(a, b, &result) ? (FLAG_C | FLAG_V) : 0;
+                break;
+        case DIV:
+                result = cell_div(a, b);
+                flags  = (a == INT64_MIN && b == -1) ? FLAG_V : 0;
+                break;
+        default:
+                return (uint8_t)a;
+        }
+        return flags | ((result == 0) ? FLAG_Z : 0) | ((result < 0) ? FLAG_N : 0);
+}
+
+/**
+ * @brief Tells whether a flag branch is taken
+ * @param opcode BRZ, BRNZ, BRLT, BRGE, BRGT or BRLE
+ * @param flags Flag register
+ * @return true if the branch is taken
+ */
+static inline bool flag_taken(uint32_t opcode, uint8_t flags)
+{
+        bool zero = (flags & FLAG_Z) != 0;
+        bool less = ((flags & FLAG_N) != 0) != ((flags & FLAG_V) != 0);
+        switch (opcode)
+        {
+        case BRZ:  return zero;
+        case BRNZ: return !zero;
+        case BRLT: return less;
+        case BRGE: return !less;
+        case BRGT: return !zero && !less;
+        default:   return zero || less;                 // BRLE
+        }
+}
+
+/**
+ * @brief Tells whether a run may skip the per-instruction checks
+ * @param vm Pointer to the StackVM context with a program attached
+ * @return true if the program is verified, entered at its first instruction outside any call, and the
+ *         stack and call stack leave room for the depths recorded by the verifier
+ */
+static inline bool stackvm_unchecked(const stackvm_t *vm)
+{
+        const program_t *program = vm->program;
+        return program->verified && vm->pc == 0 && vm->calls == 0 && vm->fp == 0 &&
+               vm->sp + 1 >= program->entry_depth &&
+               (uint64_t)(uint32_t)(vm->sp + 1) + program->max_depth <= vm->stack_size &&
+               program->max_frames <= vm->call_size;
+}
+
+/**
+ * @brief Tells whether a run calls the per-instruction hook
+ * @param vm Pointer to the StackVM context
+ * @return true if tracing or profiling is on
+ */
+static inline bool stackvm_hooked(const stackvm_t *vm)
+{
+        return vm->trace || vm->profile;
+}
+
+/**
+ * @brief Tells whether a run counts the instructions it retires and its peak stack depth
+ * @param vm Pointer to the StackVM context
+ * @return true if the metrics are on
+ */
+static inline bool stackvm_counted(const stackvm_t *vm)
+{
+#if STACKVM_METRICS
+        return vm->metrics != NULL;
+#else
+        (void)vm;
+        return false;
+#endif
+}
+
+/**
+ * @brief Per-instruction hook of the traced engine variants
+ * @param vm Pointer to the StackVM context
+ * @param code Pointer to the program words
+ * @param size Number of program words
+ * @param pc Program counter of the instruction, below `size`
+ * @param stack Pointer to the operand stack
+ * @param sp Stack pointer
+ * @return void
+ */
+static inline void stackvm_hook(stackvm_t *vm, const uint32_t *code, uint32_t size, uint32_t pc, const cell_t *stack, uint32_t sp)
+{
+        if (vm->trace)
+        {
+                trace_step(vm->trace, code, size, pc, stack, sp);
+        }
+        if (vm->profile)
+        {
+                profile_step(vm->profile, pc);
+        }
+}
+
 /**
  * @brief Initializes the StackVM context
  * @param vm Pointer to the StackVM context
+ * @param config Segment sizes of the context, NULL for the defaults
  * @return void
  * @note This function should be called to initialize the StackVM context before using it.
  *       It sets the initial state of the StackVM, allocates memory for the stack and
@@ -84,7 +383,25 @@ typedef void (*stage_t)(stackvm_t *vm);    // current instruction stage [Fetch,
  *       If the StackVM context is already initialized, this function will reset the state
  *       and reinitialize the memory and registers.
  */
-void stackvm_init(stackvm_t *vm);
+void stackvm_init(stackvm_t *vm, const stackvm_config_t *config);
+
+/**
+ * @brief Resolves the segment sizes of a configuration
+ * @param config Segment sizes, NULL for the defaults
+ * @return Configuration with every zero size replaced by the default of its segment
+ */
+stackvm_config_t stackvm_config(const stackvm_config_t *config);
+
+/**
+ * @brief Initializes the StackVM context on segments owned by the caller
+ * @param vm Pointer to the StackVM context
+ * @param config Resolved segment sizes of the context
+ * @param memory Zeroed guard cell, stack and data segments, `STACK_GUARD + stack_size + data_size` cells
+ * @param frames Call stack of `call_size` frames
+ * @return void
+ * @note Sets the registers like `stackvm_init` without allocating anything, used by the slab allocator.
+ */
+void stackvm_place(stackvm_t *vm, const stackvm_config_t *config, void *memory, frame_t *frames);
 
 /**
  * @brief Frees the StackVM context
@@ -92,6 +409,8 @@ void stackvm_init(stackvm_t *vm);
  * @return void
  * @note This function should be called to free the resources allocated for the StackVM context.
  *       It is important to call this function to avoid memory leaks.
+ *       Contexts taken from a slab with `slab_acquire` are reset and returned to their slab instead,
+ *       the memory of contexts restored from a snapshot is unmapped.
  *       The function will free the memory allocated for the StackVM context and reset the state.
  *       After calling this function, the StackVM context should not be used anymore.
  *       It is recommended to call this function when the StackVM is no longer needed or before
@@ -114,6 +433,9 @@ void stackvm_free(stackvm_t *vm);
  *       It is recommended to call this function before loading a new program into the StackVM.
  *       This function does not free the memory allocated for the StackVM context,
  *       it only resets the state and clears the stack.
+ *       Only the stack cells below the high-water mark `vm->high` are cleared, so the cost depends
+ *       on the depth the runs reached rather than the size of the stack segment. The data segment
+ *       is written by no instruction and is left to the host.
  *       If you want to completely free the StackVM context, you should call `stackvm_free(vm)` instead.
  *       This function is typically called when you want to restart the StackVM without
  *       creating a new context, for example, when running multiple programs in a loop.
@@ -139,6 +461,120 @@ void stackvm_reset(stackvm_t *vm);
  */
 void stackvm_run(stackvm_t *vm);
 
+/**
+ * @brief Runs the StackVM for at most a number of instructions
+ * @param vm Pointer to the StackVM context
+ * @param max_instructions Instruction budget of the run
+ * @return RUN_HALTED, RUN_PAUSED or RUN_FAULTED
+ * @note When the budget runs out before the program halts, the context is left in STATE_PAUSED with
+ *       the program counter on the next instruction and the stack, flags and call stack written back,
+ *       so `stackvm_run_for` or `stackvm_run` continue exactly where it stopped. A budget of 0 pauses
+ *       without running anything. The staged engine counts the budget itself, the other engines run
+ *       budgeted slices on the register engine, unchecked only while the context is entered like
+ *       an unchecked run. Every engine stops after the same instruction.
+ */
+run_status_t stackvm_run_for(stackvm_t *vm, uint64_t max_instructions);
+
+/**
+ * @brief Selects the execution engine of the StackVM
+ * @param vm Pointer to the StackVM context
+ * @param engine Execution engine to be used by `stackvm_run`
+ * @return void
+ * @note The engine can be changed between runs. Unknown engines fall back to ENGINE_STAGED.
+ */
+void stackvm_set_engine(stackvm_t *vm, engine_t engine);
+
+/**
+ * @brief Returns the name of an execution engine
+ * @param engine Execution engine
+ * @return Name of the engine, or NULL if the engine is unknown
+ */
+const char *stackvm_engine_name(engine_t engine);
+
+/**
+ * @brief Sets the trace level of the StackVM
+ * @param vm Pointer to the StackVM context
+ * @param level Trace level, TRACE_OFF disables tracing
+ * @param out Output stream of the trace, owned by the caller
+ * @return 0 on success, -1 on failure
+ * @note The engines pick their traced or quiet variant once at the start of every run,
+ *       so a run with TRACE_OFF executes no trace code at all.
+ *       Building with `-DSTACKVM_TRACE=0` compiles every trace hook out and only TRACE_OFF is accepted.
+ */
+int stackvm_trace(stackvm_t *vm, trace_level_t level, FILE *out);
+
+/**
+ * @brief Turns the instruction profiler of the StackVM on or off
+ * @param vm Pointer to the StackVM context
+ * @param enable true to count every instruction of the following runs, false to drop the profile
+ * @return 0 on success, -1 on failure
+ * @note The profile accumulates over runs of the same program in `vm->profile` and restarts when another
+ *       program is attached, print it with `profile_report` and `profile_annotate`. Profiled runs take
+ *       the traced engine variants, so profiling a fraction of the contexts keeps the others on the fast path.
+ *       Building with `-DSTACKVM_TRACE=0` compiles the hooks out and profiling cannot be enabled.
+ */
+int stackvm_profile(stackvm_t *vm, bool enable);
+
+/**
+ * @brief Turns the runtime metrics of the StackVM on or off
+ * @param vm Pointer to the StackVM context
+ * @param enable true to count the following runs, false to drop the counters
+ * @return 0 on success, -1 on failure
+ * @note The counters of the context accumulate in `vm->metrics` and every counted run is added to the
+ *       counters of the process as well, read them with `metrics_collect`. Every engine picks a counted
+ *       variant once per run, like it picks the traced one, that counts the instructions it retires into
+ *       `vm->retired` and the deepest stack into `vm->peak`. The other runs leave `vm->retired` at 0 and
+ *       `vm->peak` at the entry depth and execute the same code as a build without metrics. A counted run
+ *       also reads the clock twice. Batches of straight-line programs on ENGINE_VECTOR bypass the contexts, only their
+ *       last tuple is counted.
+ *       Building with `-DSTACKVM_METRICS=0` compiles the counting out and the metrics cannot be enabled.
+ */
+int stackvm_metrics(stackvm_t *vm, bool enable);
+
+/**
+ * @brief Attaches the input and output channels of the StackVM
+ * @param vm Pointer to the StackVM context
+ * @param in Channel read by IN, NULL for none
+ * @param out Channel written by OUT, NULL for none
+ * @return void
+ * @note The channels are owned by the caller and stay attached across resets, IN or OUT without
+ *       a channel faults. IN on an empty channel and OUT on a full one leave the context in STATE_PAUSED
+ *       on that instruction, the host refills or drains the channel and resumes with `stackvm_run`
+ *       or `stackvm_run_for`. IN on an empty closed channel halts the program like HALT.
+ *       Contexts restored from a snapshot and recycled by a slab start without channels.
+ */
+void stackvm_channels(stackvm_t *vm, struct channel *in, struct channel *out);
+
+/**
+ * @brief Returns the mnemonic of a primitive instruction
+ * @param opcode Primitive instruction from PRIMITIVE_INSTRUCTION_TYPE
+ * @return Mnemonic of the instruction, or NULL if the opcode is undefined
+ */
+const char *stackvm_opcode_name(uint32_t opcode);
+
+/**
+ * @brief Returns the static properties of a primitive instruction
+ * @param opcode Primitive instruction from PRIMITIVE_INSTRUCTION_TYPE
+ * @return Properties of the instruction, or NULL if the opcode is undefined
+ */
+const opcode_info_t *stackvm_opcode_info(uint32_t opcode);
+
+/**
+ * @brief Halts the StackVM with an error
+ * @param vm Pointer to the StackVM context
+ * @param error Reason of the halt
+ * @return void
+ * @note Prints the error message, records the error in the context and sets the state to HALT.
+ */
+void stackvm_fault(stackvm_t *vm, vm_error_t error);
+
+/**
+ * @brief Returns the message of an error
+ * @param error Error of the StackVM
+ * @return Message describing the error
+ */
+const char *stackvm_error_message(vm_error_t error);
+
 /**
  * @brief Creates a new StackVM context
  * @return Pointer to the StackVM context on success, NULL on failure
@@ -146,21 +582,45 @@ void stackvm_run(stackvm_t *vm);
  *       It is important to call this function before using any other StackVM functions.
  *       The function will allocate memory for the StackVM context, initialize the registers,
  *       set the initial state to RESET, and set the current instruction stage to the fetch stage
- *       It is recommended to call this function only once when creating a new StackVM context.
- *       After calling this function, the StackVM context will be ready to run a program.
+ *       Every call returns an independent context that owns all of its run state,
+ *       so any number of contexts can run concurrently on different threads.
+ *       The context must be released with `stackvm_free(vm)`.
  */
 stackvm_t *stackvm_ctxt();
 
+/**
+ * @brief Creates a new StackVM context with the given segment sizes
+ * @param config Segment sizes of the context, NULL for the defaults
+ * @return Pointer to the StackVM context on success, NULL on failure
+ * @note `stackvm_ctxt()` is equivalent to `stackvm_create(NULL)`.
+ */
+stackvm_t *stackvm_create(const stackvm_config_t *config);
+
 /**
  * @brief Loads a program into the StackVM memory
+ * @param vm Pointer to the StackVM context
  * @param program Pointer to the program to be loaded
  * @param size Size of the program
  * @return void
  * @note This function loads a program into the StackVM memory.
  *       It is important to call this function after creating a StackVM context
  *       and before running the StackVM.
+ *       The program is copied into a read-only code segment owned by the context,
+ *       use `attach_program` to share one code segment between many contexts instead.
+ *       Branch instructions (BR, BRT, BRF) take their target address from the
+ *       program word that follows them, LIT takes its value from the two words that follow it.
+ */
+void load_program(stackvm_t *vm, void *program, size_t size);
+
+/**
+ * @brief Attaches a program to the StackVM context
+ * @param vm Pointer to the StackVM context
+ * @param program Pointer to the program, owned by the caller
+ * @return void
+ * @note The code segment of the program is used in place, nothing is copied.
+ *       The program counter is set to the first instruction of the program.
  */
-void load_program(void *program, size_t size);
+void attach_program(stackvm_t *vm, program_t *program);
 
 /**
  * @brief Fetches the next instruction from the StackVM memory
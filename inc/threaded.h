@@ -0,0 +1,150 @@
+/***
+ *
+ * @file: threaded.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the direct-threaded execution engine of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef THREADED_H
+#define THREADED_H
+
+#include "stackvm.h"
+
+#define THREAD_WEIGHT_MAX       0x8000          // The optimizer stops combining entries of this weight, sums stay within 16 bits
+
+/**
+ * Handlers that only exist in threaded code. They are numbered after the last
+ * PRIMITIVE_INSTRUCTION_TYPE so that both share the same handler table.
+ */
+enum
+{
+        THREAD_PUSH = PRIMITIVE_COUNT,  // Push the sign-extended operand onto the stack
+        THREAD_UNDEFINED_PRIMITIVE,     // Primitive instruction outside PRIMITIVE_INSTRUCTION_TYPE
+        THREAD_UNDEFINED_INSTRUCTION,   // UNDEFINED_INSTRUCTION type
+        THREAD_END,                     // Program counter ran past the loaded program
+        THREAD_TRACE,                   // Record the entry in the trace, then run its handler
+        THREAD_COUNT,                   // Count the entry and the stack depth, then run its handler
+
+        // Superinstructions of the peephole optimizer, the operand is the sign-extended immediate
+        THREAD_PUSH_ADD,                // push imm; ADD
+        THREAD_PUSH_SUB,                // push imm; SUB
+        THREAD_PUSH_MUL,                // push imm; MUL
+        THREAD_PUSH_DIV,                // push imm; DIV with a non-zero immediate
+        THREAD_PUSH_AND,                // push imm; AND
+        THREAD_PUSH_OR,                 // push imm; OR
+        THREAD_PUSH_XOR,                // push imm; XOR
+        THREAD_PUSH_LT,                 // push imm; LT
+        THREAD_PUSH_GT,                 // push imm; GT
+        THREAD_PUSH_LE,                 // push imm; LE
+        THREAD_PUSH_GE,                 // push imm; GE
+        THREAD_PUSH_EQ,                 // push imm; EQ
+        THREAD_PUSH_NE,                 // push imm; NE
+        THREAD_PUSH_CMP,                // push imm; CMP
+
+        // Superinstructions of the peephole optimizer, the operand is the branch target
+        THREAD_LT_BRF,                  // LT; BRF
+        THREAD_GT_BRF,                  // GT; BRF
+        THREAD_LE_BRF,                  // LE; BRF
+        THREAD_GE_BRF,                  // GE; BRF
+        THREAD_EQ_BRF,                  // EQ; BRF
+        THREAD_NE_BRF,                  // NE; BRF
+        THREAD_LT_BRT,                  // LT; BRT
+        THREAD_GT_BRT,                  // GT; BRT
+        THREAD_LE_BRT,                  // LE; BRT
+        THREAD_GE_BRT,                  // GE; BRT
+        THREAD_EQ_BRT,                  // EQ; BRT
+        THREAD_NE_BRT,                  // NE; BRT
+        THREAD_HANDLER_COUNT,
+};
+
+/**
+ * @brief Threaded code entry
+ * @note Entry `i` of the threaded code translated by `thread_compile` corresponds to program word `i`,
+ *       so program addresses and threaded code indices are interchangeable.
+ *       A branch or a local slot instruction is followed by an entry for its operand word and LIT by entries
+ *       for its two operand words, those are never dispatched. The operand of a LIT entry is the program
+ *       address of its low operand word, the operand of CALL the entry of its target, and it returns
+ *       to the entry after its target entry.
+ *       Every entry of `thread_compile` weighs one instruction, a superinstruction or folded constant of
+ *       the optimizer weighs every instruction it replaces, so the retired count matches the other engines.
+ *       How far the pushes it replaces lift the stack is kept in `rise` of the cache rather than in the entry,
+ *       so counted runs report the peak depth of the other engines.
+ */
+typedef struct thread
+{
+        const void *handler;            // Address of the handler executing this entry
+        uint32_t operand;               // Pushed value, immediate, branch target, local slot or LIT operand address
+        uint16_t opcode;                // Index of the handler in the handler table
+        uint16_t weight;                // Program instructions retired by dispatching the entry
+} thread_t;
+
+/**
+ * @brief Threaded code
+ * @note Optimized threaded code no longer matches the program word for word,
+ *       `origin` maps its entries back to program addresses.
+ */
+struct thread_cache
+{
+        uint32_t size;                  // Number of entries before the THREAD_END entry
+        bool traced;                    // Every entry dispatches through the trace handler
+        bool checked;                   // Entries dispatch to the handlers checking the stack bounds
+        uint32_t *origin;               // Program address of every entry, NULL when entry `i` is program word `i`
+        uint16_t *rise;                 // Cells the replaced instructions of every entry push above its stack, NULL like `origin`
+        const struct thread_cache *source; // Threaded code a counting copy dispatches like, NULL for any other
+        thread_t code[];                // Threaded code, followed by THREAD_END entries
+};
+
+/**
+ * @brief Runs the loaded program with the threaded engine
+ * @param vm Pointer to the StackVM context
+ * @return void
+ * @note Quiet runs execute the threaded code translated once when the program was created,
+ *       traced runs translate a private copy into the context on their first run and counted runs
+ *       copy the code they run into the context with every entry dispatching through the counter.
+ *       A verified program entered at its first instruction runs without per-instruction checks
+ *       when the stack pointer leaves room for its stack depth, any other run checks the stack
+ *       bounds of every instruction and halts with an error instead of leaving the stack segment.
+ *       Every instruction is dispatched with a single indirect jump, the program counter
+ *       and stack pointer are kept in locals and written back when the VM halts.
+ */
+void stackvm_run_threaded(stackvm_t *vm);
+
+/**
+ * @brief Translates a program into threaded code
+ * @param program Pointer to the instruction words
+ * @param size Number of instruction words
+ * @param traced Dispatch every entry through the trace handler, requires `checked`
+ * @param checked Dispatch every entry to the handlers checking the stack bounds
+ * @return Pointer to the threaded code on success, NULL on failure
+ * @note Entry `i` of the threaded code holds the handler address and operand of program word `i`.
+ */
+struct thread_cache *thread_compile(const uint32_t *program, uint32_t size, bool traced, bool checked);
+
+/**
+ * @brief Returns the handler table of the threaded engine
+ * @param checked Return the handlers checking the stack bounds
+ * @return Handler addresses indexed by opcode, superinstructions only have unchecked handlers
+ */
+const void *const *thread_handlers(bool checked);
+
+/**
+ * @brief Frees threaded code
+ * @param cache Pointer to the threaded code, may be NULL
+ * @return void
+ */
+void thread_cache_free(struct thread_cache *cache);
+
+/**
+ * @brief Releases the traced threaded code cached in the StackVM context
+ * @param vm Pointer to the StackVM context
+ * @return void
+ * @note This function is called whenever the attached program or the trace changes and when the context is freed.
+ */
+void threaded_free(stackvm_t *vm);
+
+#endif // THREADED_H
@@ -0,0 +1,127 @@
+/***
+ *
+ * @file: trace.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file defines the instruction tracing subsystem of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef STACKVM_TRACE
+#define STACKVM_TRACE           1               // Build tracing support, 0 compiles every trace hook out
+#endif
+
+#define TRACE_MAGIC             0x544d5653      // "SVMT" in little endian
+#define TRACE_VERSION           2               // Version of the binary trace format
+#define TRACE_BUFFER_SIZE       4096            // Number of records buffered before they are written
+
+/**
+ * @brief Trace levels of the StackVM
+ * @note TRACE_OFF runs the quiet fast path without any trace hook.
+ *       TRACE_OPS prints the mnemonic and operands of every executed instruction.
+ *       TRACE_FULL writes a binary record of the machine state before every instruction,
+ *       the records are buffered and can be pretty-printed with the `tracedump` tool.
+ */
+typedef enum trace_level
+{
+        TRACE_OFF               = 0,
+        TRACE_OPS               = 1,
+        TRACE_FULL              = 2,
+} trace_level_t;
+
+/**
+ * @brief Header of a binary trace file
+ */
+typedef struct trace_header
+{
+        uint32_t magic;                 // TRACE_MAGIC
+        uint16_t version;               // TRACE_VERSION
+        uint16_t record_size;           // Size of one trace record in bytes
+} trace_header_t;
+
+/**
+ * @brief Binary trace record
+ * @note The record holds the state of the machine before the instruction is executed.
+ *       Stack slots that do not exist are recorded as 0.
+ */
+typedef struct trace_record
+{
+        uint32_t pc;                    // Program counter
+        uint32_t instruction;           // Instruction word at the program counter
+        uint32_t sp;                    // Stack pointer
+        uint32_t target;                // Target address of a branch instruction
+        int64_t tos;                    // Top of stack
+        int64_t nos;                    // Next on stack
+        int64_t immediate;              // Value pushed by a push or LIT instruction
+} trace_record_t;
+
+/**
+ * @brief Trace sink of a StackVM context
+ */
+typedef struct trace
+{
+        trace_level_t level;                    // Trace level
+        FILE *out;                              // Output stream of the trace
+        uint32_t count;                         // Number of buffered records
+        trace_record_t buffer[TRACE_BUFFER_SIZE]; // Records not yet written to the output
+} trace_t;
+
+/**
+ * @brief Creates a trace sink
+ * @param level Trace level
+ * @param out Output stream, text for TRACE_OPS and binary for TRACE_FULL
+ * @return Pointer to the trace sink on success, NULL on failure
+ * @note For TRACE_FULL the trace header is written immediately.
+ */
+trace_t *trace_open(trace_level_t level, FILE *out);
+
+/**
+ * @brief Flushes and frees a trace sink
+ * @param trace Pointer to the trace sink
+ * @return void
+ * @note The output stream is not closed, it is owned by the caller.
+ */
+void trace_close(trace_t *trace);
+
+/**
+ * @brief Records one instruction
+ * @param trace Pointer to the trace sink
+ * @param code Pointer to the program words
+ * @param size Number of program words
+ * @param pc Program counter of the instruction, below `size`
+ * @param stack Pointer to the operand stack
+ * @param sp Stack pointer
+ * @return void
+ * @note Called by the engines before every instruction, but only on runs with tracing enabled.
+ *       Branch targets and wide immediates are read from the words following the instruction,
+ *       missing words are recorded as a target of `size` and an immediate of 0.
+ */
+void trace_step(trace_t *trace, const uint32_t *code, uint32_t size, uint32_t pc, const int64_t *stack, uint32_t sp);
+
+/**
+ * @brief Writes the buffered records to the output stream
+ * @param trace Pointer to the trace sink
+ * @return void
+ * @note Called by `stackvm_run` when the VM halts.
+ */
+void trace_flush(trace_t *trace);
+
+/**
+ * @brief Prints the mnemonic and operands of a trace record
+ * @param out Output stream
+ * @param record Pointer to the trace record
+ * @return void
+ * @note No newline is printed, callers may append the state of the record.
+ */
+void trace_print(FILE *out, const trace_record_t *record);
+
+#endif // TRACE_H
@@ -0,0 +1,59 @@
+/***
+ *
+ * @file: vector.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the SIMD vectorized batch interpreter of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "stackvm.h"
+
+struct vector_program;
+
+/**
+ * @brief Runs a batch on the vectorized interpreter
+ * @param vm Pointer to the StackVM context with the program attached
+ * @param inputs Input tuples, laid out as for `stackvm_run_batch`
+ * @param arity Number of values per input tuple
+ * @param count Number of input tuples
+ * @param results Caller-provided buffer of `count` results
+ * @return true if the batch was evaluated, false if the program cannot be vectorized
+ * @note Every stack slot holds one lane per input tuple, so each dispatched instruction
+ *       processes 16 tuples with AVX2, 8 with SSE2 or 8 with the portable scalar kernel, one 64-bit cell per lane.
+ *       The kernel is chosen once at startup from the CPUID feature bits. The program is prepared by
+ *       the first batch and cached in it for every context, the lane stack is kept in the context
+ *       for the next batch. The registers and the stack of the context are left untouched.
+ *       Only straight-line programs ending in HALT and made of pushes, LIT, ADD, SUB, MUL, AND, OR,
+ *       XOR, NOT and the comparison instructions are vectorized, the caller falls back to the
+ *       scalar engines for everything else.
+ */
+bool vector_run_batch(stackvm_t *vm, const cell_t *inputs, uint32_t arity, size_t count, cell_t *results);
+
+/**
+ * @brief Releases the lane stack kept in the StackVM context
+ * @param vm Pointer to the StackVM context
+ * @return void
+ */
+void vector_free(stackvm_t *vm);
+
+/**
+ * @brief Frees the vectorized form of a program
+ * @param vp Vectorized program cached in the program, may be NULL
+ * @return void
+ */
+void vector_program_free(struct vector_program *vp);
+
+/**
+ * @brief Returns the name of the instruction set used by the vectorized interpreter
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char *vector_isa(void);
+
+#endif // VECTOR_H
@@ -0,0 +1,34 @@
+/***
+ *
+ * @file: verify.h
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This header file declares the load-time bytecode verifier of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "program.h"
+
+/**
+ * @brief Verifies a program and records the result in it
+ * @param program Pointer to the program
+ * @return true if the program is verified, false otherwise
+ * @note Starting at the first instruction, every reachable instruction is checked for a valid opcode,
+ *       branch targets are checked to be the first word of an instruction inside the program,
+ *       and the stack depth is tracked along every path. A program is verified when every path
+ *       ends in HALT and every instruction is reached with the same stack depth on all paths.
+ *       Every CALL target is verified as a function of its own whose RETs agree on the stack depth,
+ *       calls then apply the stack effect of their function. Recursive calls are not verified.
+ *       Local slots must lie below the top of stack and above the bottom of the stack.
+ *       On success `entry_depth`, `max_depth` and `max_frames` of the program are set, on failure
+ *       `verify_error` and `verify_pc` describe the first problem found.
+ */
+bool program_verify(program_t *program);
+
+#endif // VERIFY_H
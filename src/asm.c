@@ -0,0 +1,794 @@
+/***
+ *
+ * @file: asm.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the text assembler and disassembler of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "asm.h"
+#include "native.h"
+
+#define LABEL_UNDEFINED         UINT32_MAX                      // Label referenced but not defined yet
+
+/**
+ * @brief Label of the source
+ */
+typedef struct asm_label
+{
+        uint32_t hash;                  // FNV-1a hash of the name
+        uint32_t length;                // Length of the name
+        size_t name;                    // Offset of the name in the name arena
+        uint32_t address;               // Address of the labelled instruction, LABEL_UNDEFINED until defined
+} asm_label_t;
+
+/**
+ * @brief Branch target waiting for its label to be defined
+ */
+typedef struct asm_fixup
+{
+        size_t position;                // Address of the target word
+        size_t line;                    // Source line of the branch
+        uint32_t label;                 // Index of the label
+} asm_fixup_t;
+
+/**
+ * @brief Assembler state
+ * @note Every array grows geometrically, so the number of allocations is logarithmic in the source size.
+ */
+typedef struct assembler
+{
+        uint32_t *code;                 // Emitted instruction words
+        size_t size;
+        size_t capacity;
+
+        asm_label_t *labels;            // Labels in order of first appearance
+        size_t label_count;
+        size_t label_capacity;
+        uint32_t *slots;                // Open-addressing hash table of label indices plus one, 0 is empty
+        size_t slot_count;              // Power of two
+
+        char *names;                    // Arena holding the label names
+        size_t names_size;
+        size_t names_capacity;
+
+        asm_fixup_t *fixups;            // Forward branches
+        size_t fixup_count;
+        size_t fixup_capacity;
+
+        size_t line;                    // Current source line
+        asm_error_t *error;
+} assembler_t;
+
+/**
+ * @brief Records an assembler error
+ * @param as Pointer to the assembler
+ * @param line Source line of the error, 0 if there is none
+ * @param format printf format of the message
+ * @return false
+ */
+static bool fail(assembler_t *as, size_t line, const char *format, ...)
+{
+        if (as->error)
+        {
+                va_list args;
+                va_start(args, format);
+                vsnprintf(as->error->message, sizeof(as->error->message), format, args);
+                va_end(args);
+                as->error->line = line;
+        }
+        return false;
+}
+
+/**
+ * @brief Makes room for one more element in a growable array
+ * @param array Pointer to the array
+ * @param capacity Pointer to the capacity of the array in elements
+ * @param count Number of elements in use
+ * @param element Size of an element in bytes
+ * @return true on success, false if the allocation failed
+ */
+static bool reserve(void **array, size_t *capacity, size_t count, size_t element)
+{
+        if (count < *capacity)
+        {
+                return true;
+        }
+
+        size_t grown = *capacity ? *capacity * 2 : 256;
+        void *resized = realloc(*array, grown * element);
+        if (!resized)
+        {
+                return false;
+        }
+        *array    = resized;
+        *capacity = grown;
+        return true;
+}
+
+/**
+ * @brief Appends an instruction word
+ * @param as Pointer to the assembler
+ * @param word Instruction word
+ * @return true on success, false on failure
+ */
+static bool emit(assembler_t *as, uint32_t word)
+{
+        if (!reserve((void **)&as->code, &as->capacity, as->size, sizeof(uint32_t)))
+        {
+                return fail(as, as->line, "out of memory");
+        }
+        if (as->size >= UINT32_MAX)
+        {
+                return fail(as, as->line, "program exceeds the address space");
+        }
+        as->code[as->size++] = word;
+        return true;
+}
+
+/**
+ * @brief Looks up a label, adding it as undefined on first use
+ * @param as Pointer to the assembler
+ * @param name Name of the label
+ * @param length Length of the name
+ * @param index Pointer receiving the index of the label
+ * @return true on success, false on failure
+ */
+static bool label(assembler_t *as, const char *name, size_t length, uint32_t *index)
+{
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+        {
+                hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+        }
+
+        size_t mask = as->slot_count - 1;
+        for (size_t slot = hash & mask; as->slot_count && as->slots[slot]; slot = (slot + 1) & mask)
+        {
+                const asm_label_t *entry = &as->labels[as->slots[slot] - 1];
+                if (entry->hash == hash && entry->length == length && memcmp(as->names + entry->name, name, length) == 0)
+                {
+                        *index = as->slots[slot] - 1;
+                        return true;
+                }
+        }
+
+        // Keep the table at most half full
+        if ((as->label_count + 1) * 2 > as->slot_count)
+        {
+                size_t count   = as->slot_count ? as->slot_count * 2 : 1024;
+                uint32_t *grown = calloc(count, sizeof(uint32_t));
+                if (!grown)
+                {
+                        return fail(as, as->line, "out of memory");
+                }
+                for (size_t i = 0; i < as->label_count; i++)
+                {
+                        size_t slot = as->labels[i].hash & (count - 1);
+                        while (grown[slot])
+                        {
+                                slot = (slot + 1) & (count - 1);
+                        }
+                        grown[slot] = (uint32_t)i + 1;
+                }
+                free(as->slots);
+                as->slots      = grown;
+                as->slot_count = count;
+        }
+
+        if (length > UINT32_MAX || as->label_count >= UINT32_MAX - 1 ||
+            !reserve((void **)&as->labels, &as->label_capacity, as->label_count, sizeof(asm_label_t)))
+        {
+                return fail(as, as->line, "out of memory");
+        }
+        while (as->names_capacity - as->names_size < length)
+        {
+                if (!reserve((void **)&as->names, &as->names_capacity, as->names_capacity, 1))
+                {
+                        return fail(as, as->line, "out of memory");
+                }
+        }
+        memcpy(as->names + as->names_size, name, length);
+
+        as->labels[as->label_count] = (asm_label_t){
+                .hash    = hash,
+                .length  = (uint32_t)length,
+                .name    = as->names_size,
+                .address = LABEL_UNDEFINED,
+        };
+        as->names_size += length;
+
+        size_t slot = hash & (as->slot_count - 1);
+        while (as->slots[slot])
+        {
+                slot = (slot + 1) & (as->slot_count - 1);
+        }
+        as->slots[slot] = (uint32_t)as->label_count + 1;
+        *index          = (uint32_t)as->label_count++;
+        return true;
+}
+
+static inline bool is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool is_ident_start(char c)
+{
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.';
+}
+
+static inline bool is_ident(char c)
+{
+        return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool is_end(const char *p, const char *end)
+{
+        return p == end || *p == ';' || *p == '#';
+}
+
+static inline const char *skip_space(const char *p, const char *end)
+{
+        while (p < end && is_space(*p))
+        {
+                p++;
+        }
+        return p;
+}
+
+/**
+ * @brief Parses a decimal or `0x` hexadecimal integer with an optional sign
+ * @param p Pointer to the cursor, advanced past the integer
+ * @param end End of the line
+ * @param value Pointer receiving the value
+ * @return true on success, false if there is no integer or it does not fit in 64 bits
+ */
+static bool number(const char **p, const char *end, int64_t *value)
+{
+        const char *s = *p;
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+'))
+        {
+                negative = *s++ == '-';
+        }
+
+        unsigned base = 10;
+        if (end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+        {
+                base = 16;
+                s += 2;
+        }
+
+        const char *digits = s;
+        uint64_t magnitude = 0;
+        for (; s < end; s++)
+        {
+                unsigned digit;
+                if (*s >= '0' && *s <= '9')
+                {
+                        digit = *s - '0';
+                }
+                else if (base == 16 && (*s | 0x20) >= 'a' && (*s | 0x20) <= 'f')
+                {
+                        digit = (*s | 0x20) - 'a' + 10;
+                }
+                else
+                {
+                        break;
+                }
+
+                if (magnitude > (UINT64_C(1) << 63) / base)
+                {
+                        return false;
+                }
+                magnitude = magnitude * base + digit;
+        }
+        if (s == digits || (s < end && is_ident(*s)) || magnitude > (uint64_t)INT64_MAX + negative)
+        {
+                return false;
+        }
+
+        *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+        *p     = s;
+        return true;
+}
+
+/**
+ * @brief Looks up a mnemonic
+ * @param name Mnemonic, case-insensitive
+ * @param length Length of the mnemonic
+ * @param opcode Pointer receiving the primitive instruction
+ * @return true if the mnemonic names a primitive instruction
+ */
+static bool mnemonic(const char *name, size_t length, uint32_t *opcode)
+{
+        const opcode_info_t *info;
+        for (uint32_t op = 0; (info = stackvm_opcode_info(op)); op++)
+        {
+                size_t i = 0;
+                while (i < length && info->name[i] && ((name[i] >= 'A' && name[i] <= 'Z') ? (name[i] | 0x20) : name[i]) == info->name[i])
+                {
+                        i++;
+                }
+                if (i == length && !info->name[i])
+                {
+                        *opcode = op;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/**
+ * @brief Compares an identifier with a lowercase keyword
+ * @param name Identifier, case-insensitive
+ * @param length Length of the identifier
+ * @param keyword Keyword
+ * @return true if they match
+ */
+static bool keyword(const char *name, size_t length, const char *keyword)
+{
+        size_t i = 0;
+        while (i < length && keyword[i] && (name[i] | 0x20) == keyword[i])
+        {
+                i++;
+        }
+        return i == length && !keyword[i];
+}
+
+/**
+ * @brief Assembles one source line
+ * @param as Pointer to the assembler
+ * @param p Start of the line
+ * @param end End of the line, excluding the newline
+ * @return true on success, false on failure
+ */
+static bool assemble_line(assembler_t *as, const char *p, const char *end)
+{
+        as->line++;
+
+        const char *name;
+        size_t length;
+        for (;;)
+        {
+                p = skip_space(p, end);
+                if (is_end(p, end))
+                {
+                        return true;
+                }
+                if (!is_ident_start(*p))
+                {
+                        return fail(as, as->line, "unexpected '%c'", *p);
+                }
+
+                name = p;
+                while (p < end && is_ident(*p))
+                {
+                        p++;
+                }
+                length = p - name;
+                if (p == end || *p != ':')
+                {
+                        break;
+                }
+
+                // Label definition
+                uint32_t index;
+                if (!label(as, name, length, &index))
+                {
+                        return false;
+                }
+                if (as->labels[index].address != LABEL_UNDEFINED)
+                {
+                        return fail(as, as->line, "label '%.*s' is already defined", (int)length, name);
+                }
+                as->labels[index].address = (uint32_t)as->size;
+                p++;
+        }
+
+        const char *operand = skip_space(p, end);
+        if (p < end && !is_space(*p) && !is_end(p, end))
+        {
+                return fail(as, as->line, "unexpected '%c' after '%.*s'", *p, (int)length, name);
+        }
+        p = operand;
+
+        int64_t value;
+        uint32_t opcode;
+        if (keyword(name, length, "push") || keyword(name, length, "lit"))
+        {
+                if (!number(&p, end, &value))
+                {
+                        return fail(as, as->line, "%.*s expects a 64-bit integer", (int)length, name);
+                }
+                // Values outside the 30-bit immediate of a push are encoded as LIT
+                if (length == 4 && value >= IMMEDIATE_MIN && value <= IMMEDIATE_MAX)
+                {
+                        if (!emit(as, GET_PUSH(value)))
+                        {
+                                return false;
+                        }
+                }
+                else if (!emit(as, GET_OPCODE(LIT)) || !emit(as, (uint32_t)value) || !emit(as, (uint32_t)((uint64_t)value >> 32)))
+                {
+                        return false;
+                }
+        }
+        else if (keyword(name, length, ".word"))
+        {
+                if (!number(&p, end, &value) || value < INT32_MIN || value > UINT32_MAX)
+                {
+                        return fail(as, as->line, ".word expects a 32-bit integer");
+                }
+                if (!emit(as, (uint32_t)value))
+                {
+                        return false;
+                }
+        }
+        else if (mnemonic(name, length, &opcode))
+        {
+                if (!emit(as, GET_OPCODE(opcode)))
+                {
+                        return false;
+                }
+
+                if (stackvm_opcode_info(opcode)->target)
+                {
+                        if (p < end && is_ident_start(*p))
+                        {
+                                const char *target = p;
+                                while (p < end && is_ident(*p))
+                                {
+                                        p++;
+                                }
+
+                                uint32_t index;
+                                if (!label(as, target, p - target, &index))
+                                {
+                                        return false;
+                                }
+                                if (as->labels[index].address == LABEL_UNDEFINED)
+                                {
+                                        if (!reserve((void **)&as->fixups, &as->fixup_capacity, as->fixup_count, sizeof(asm_fixup_t)))
+                                        {
+                                                return fail(as, as->line, "out of memory");
+                                        }
+                                        as->fixups[as->fixup_count++] = (asm_fixup_t){ as->size, as->line, index };
+                                }
+                                if (!emit(as, as->labels[index].address))
+                                {
+                                        return false;
+                                }
+                        }
+                        else if (number(&p, end, &value) && value >= 0 && value <= UINT32_MAX)
+                        {
+                                if (!emit(as, (uint32_t)value))
+                                {
+                                        return false;
+                                }
+                        }
+                        else
+                        {
+                                return fail(as, as->line, "%.*s expects a label or an address", (int)length, name);
+                        }
+                }
+                else if (opcode == CALL_NATIVE)
+                {
+                        if (p < end && is_ident_start(*p))
+                        {
+                                const char *native = p;
+                                while (p < end && is_ident(*p))
+                                {
+                                        p++;
+                                }
+                                char buffer[64];
+                                int found = -1;
+                                if ((size_t)(p - native) < sizeof(buffer))
+                                {
+                                        memcpy(buffer, native, p - native);
+                                        buffer[p - native] = '\0';
+                                        found = native_find(buffer);
+                                }
+                                if (found < 0)
+                                {
+                                        return fail(as, as->line, "undefined native function '%.*s'", (int)(p - native), native);
+                                }
+                                value = found;
+                        }
+                        else if (!number(&p, end, &value) || value < 0 || value > UINT32_MAX)
+                        {
+                                return fail(as, as->line, "%.*s expects a native function or its index", (int)length, name);
+                        }
+                        if (!emit(as, (uint32_t)value))
+                        {
+                                return false;
+                        }
+                }
+                else if (stackvm_opcode_info(opcode)->operands)
+                {
+                        if (!number(&p, end, &value) || value < INT32_MIN || value > INT32_MAX)
+                        {
+                                return fail(as, as->line, "%.*s expects a 32-bit local slot", (int)length, name);
+                        }
+                        if (!emit(as, (uint32_t)value))
+                        {
+                                return false;
+                        }
+                }
+        }
+        else
+        {
+                return fail(as, as->line, "unknown instruction '%.*s'", (int)length, name);
+        }
+
+        p = skip_space(p, end);
+        if (!is_end(p, end))
+        {
+                return fail(as, as->line, "unexpected '%c' after instruction", *p);
+        }
+        return true;
+}
+
+/**
+ * @brief Assembles every complete line of a block of source
+ * @param as Pointer to the assembler
+ * @param p Start of the block
+ * @param end End of the block
+ * @return Start of the incomplete last line, NULL on failure
+ */
+static const char *assemble_lines(assembler_t *as, const char *p, const char *end)
+{
+        const char *newline;
+        while ((newline = memchr(p, '\n', end - p)))
+        {
+                if (!assemble_line(as, p, newline))
+                {
+                        return NULL;
+                }
+                p = newline + 1;
+        }
+        return p;
+}
+
+/**
+ * @brief Patches the forward branches and hands out the code
+ * @param as Pointer to the assembler
+ * @param size Pointer receiving the number of instruction words
+ * @return Instruction words on success, NULL on failure
+ */
+static uint32_t *finish(assembler_t *as, size_t *size)
+{
+        for (size_t i = 0; i < as->fixup_count; i++)
+        {
+                const asm_fixup_t *fixup = &as->fixups[i];
+                const asm_label_t *entry = &as->labels[fixup->label];
+                if (entry->address == LABEL_UNDEFINED)
+                {
+                        fail(as, fixup->line, "undefined label '%.*s'", (int)entry->length, as->names + entry->name);
+                        return NULL;
+                }
+                as->code[fixup->position] = entry->address;
+        }
+        if (as->size == 0)
+        {
+                fail(as, 0, "empty program");
+                return NULL;
+        }
+
+        uint32_t *code = as->code;
+        *size          = as->size;
+        as->code       = NULL;
+        return code;
+}
+
+/**
+ * @brief Releases the assembler state
+ * @param as Pointer to the assembler
+ * @return void
+ */
+static void release(assembler_t *as)
+{
+        free(as->code);
+        free(as->labels);
+        free(as->slots);
+        free(as->names);
+        free(as->fixups);
+        return;
+}
+
+uint32_t *asm_assemble(FILE *in, size_t *size, asm_error_t *error)
+{
+        assembler_t as = { .error = error };
+        char *buffer   = malloc(ASM_CHUNK_SIZE);
+        if (!buffer)
+        {
+                fail(&as, 0, "out of memory");
+                return NULL;
+        }
+
+        uint32_t *code = NULL;
+        size_t used    = 0;
+        for (;;)
+        {
+                size_t count = fread(buffer + used, 1, ASM_CHUNK_SIZE - used, in);
+                used += count;
+
+                const char *rest = assemble_lines(&as, buffer, buffer + used);
+                if (!rest)
+                {
+                        break;
+                }
+
+                size_t remaining = buffer + used - rest;
+                if (count == 0)
+                {
+                        if (ferror(in))
+                        {
+                                fail(&as, 0, "failed to read the source");
+                                break;
+                        }
+                        if (remaining && !assemble_line(&as, rest, rest + remaining))
+                        {
+                                break;
+                        }
+                        code = finish(&as, size);
+                        break;
+                }
+                if (remaining == ASM_CHUNK_SIZE)
+                {
+                        fail(&as, as.line + 1, "line longer than %d bytes", ASM_CHUNK_SIZE);
+                        break;
+                }
+
+                // Carry the incomplete last line over to the next chunk
+                memmove(buffer, rest, remaining);
+                used = remaining;
+        }
+
+        free(buffer);
+        release(&as);
+        return code;
+}
+
+uint32_t *asm_assemble_buffer(const char *source, size_t length, size_t *size, asm_error_t *error)
+{
+        assembler_t as = { .error = error };
+        uint32_t *code = NULL;
+
+        const char *end  = source + length;
+        const char *rest = assemble_lines(&as, source, end);
+        if (rest && (rest == end || assemble_line(&as, rest, end)))
+        {
+                code = finish(&as, size);
+        }
+
+        release(&as);
+        return code;
+}
+
+/**
+ * @brief Prints one instruction without indentation or newline
+ * @param out Output stream
+ * @param code Pointer to the instruction words
+ * @param size Number of instruction words
+ * @param pc Address of the instruction
+ * @param labels Non-zero for the addresses printed as `L<address>`, NULL for plain addresses
+ * @return Number of words printed
+ */
+static size_t print_instruction(FILE *out, const uint32_t *code, size_t size, size_t pc, const uint8_t *labels)
+{
+        uint32_t word = code[pc];
+        uint32_t data = GET_DATA(word);
+        switch (GET_TYPE(word))
+        {
+        case POSITIVE_INTEGER:
+        case NEGATIVE_INTEGER:
+                fprintf(out, "push %" PRId64, GET_IMMEDIATE(word));
+                return 1;
+        case PRIMITIVE_INSTRUCTION:
+                break;
+        default:
+                fprintf(out, ".word 0x%08x", word);
+                return 1;
+        }
+
+        const opcode_info_t *info = stackvm_opcode_info(data);
+        if (!info || pc + info->operands >= size)
+        {
+                fprintf(out, ".word 0x%08x", word);
+                return 1;
+        }
+        if (data == LIT)
+        {
+                fprintf(out, "%s %" PRId64, info->name, GET_WIDE(code[pc + 1], code[pc + 2]));
+        }
+        else if (data == CALL_NATIVE && native_get(code[pc + 1]))
+        {
+                fprintf(out, "%s %s", info->name, native_get(code[pc + 1])->name);
+        }
+        else if (data == CALL_NATIVE)
+        {
+                fprintf(out, "%s %u", info->name, code[pc + 1]);
+        }
+        else if (!info->target && info->operands)
+        {
+                fprintf(out, "%s %" PRId32, info->name, (int32_t)code[pc + 1]);
+        }
+        else if (!info->target)
+        {
+                fprintf(out, "%s", info->name);
+        }
+        else if (labels && code[pc + 1] < size && labels[code[pc + 1]])
+        {
+                fprintf(out, "%s L%u", info->name, code[pc + 1]);
+        }
+        else
+        {
+                fprintf(out, "%s %u", info->name, code[pc + 1]);
+        }
+        return 1 + (size_t)info->operands;
+}
+
+size_t asm_print(FILE *out, const uint32_t *code, size_t size, size_t pc)
+{
+        return print_instruction(out, code, size, pc, NULL);
+}
+
+int asm_disassemble(FILE *out, const uint32_t *code, size_t size)
+{
+        enum
+        {
+                START  = 1 << 0,        // Word starts an instruction
+                TARGET = 1 << 1,        // Word is the target of a branch
+        };
+
+        uint8_t *flags = calloc(size ? size : 1, sizeof(uint8_t));
+        if (!flags)
+        {
+                return -1;
+        }
+
+        // Decode linearly to find the instruction starts and the branch targets
+        for (size_t pc = 0; pc < size; pc++)
+        {
+                flags[pc] |= START;
+                const opcode_info_t *info = GET_TYPE(code[pc]) == PRIMITIVE_INSTRUCTION ? stackvm_opcode_info(GET_DATA(code[pc])) : NULL;
+                if (info && info->operands && pc + info->operands < size)
+                {
+                        if (info->target && code[pc + 1] < size)
+                        {
+                                flags[code[pc + 1]] |= TARGET;
+                        }
+                        pc += info->operands;           // Skip the operand words
+                }
+        }
+
+        for (size_t pc = 0; pc < size; pc++)
+        {
+                flags[pc] = ((flags[pc] & (START | TARGET)) == (START | TARGET)); // Labelled instruction starts
+        }
+
+        for (size_t pc = 0; pc < size; )
+        {
+                if (flags[pc])
+                {
+                        fprintf(out, "L%zu:\n", pc);
+                }
+                fputs("        ", out);
+                pc += print_instruction(out, code, size, pc, flags);
+                fputc('\n', out);
+        }
+
+        free(flags);
+        return ferror(out) ? -1 : 0;
+}
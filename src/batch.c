@@ -0,0 +1,58 @@
+/***
+ *
+ * @file: batch.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the batch execution API of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "batch.h"
+#include "vector.h"
+
+size_t stackvm_run_batch(stackvm_t *vm, const cell_t *inputs, uint32_t arity, size_t count, cell_t *results)
+{
+        if (!vm || !vm->program || !results || (arity && !inputs))
+        {
+                fprintf(stderr, "Error: Invalid batch or VM context\n");
+                return 0;
+        }
+        if (arity > vm->stack_size)
+        {
+                fprintf(stderr, "Error: Input tuples of %u values exceed the stack of %u cells\n", arity, vm->stack_size);
+                return 0;
+        }
+
+        size_t first = 0;
+        if (vm->engine == ENGINE_VECTOR && !stackvm_hooked(vm) && count > 1 &&
+            vector_run_batch(vm, inputs, arity, count - 1, results))
+        {
+                first = count - 1; // Evaluated in SIMD lanes, the last tuple leaves the context like any run
+        }
+
+        for (size_t i = first; i < count; i++)
+        {
+                // Rewind the registers, the stack slots are overwritten by the pushes below
+                vm->pc    = 0;
+                vm->state = STATE_RESET;
+                vm->stage = NULL;
+                vm->calls = 0;
+                vm->fp    = 0;
+                vm->flags = 0;
+                memcpy(vm->stack, inputs + i * arity, arity * sizeof(cell_t));
+                vm->sp    = arity - 1;
+
+                stackvm_run(vm);
+                if (vm->error != ERROR_NONE)
+                {
+                        return i; // The tuple faulted, its result is undefined
+                }
+                results[i] = (vm->sp != (uint32_t)-1) ? vm->stack[vm->sp] : 0;
+        }
+        return count;
+}
@@ -0,0 +1,131 @@
+/***
+ *
+ * @file: channel.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the ring buffer channels that stream values into and out of a StackVM context
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "channel.h"
+
+channel_t *channel_create(uint32_t capacity)
+{
+        if (capacity == 0 || capacity > (UINT32_C(1) << 31))
+        {
+                fprintf(stderr, "Error: Invalid channel capacity %u\n", capacity);
+                return NULL;
+        }
+        uint32_t cells = 1;
+        while (cells < capacity)
+        {
+                cells <<= 1;                                    // Indices are masked, never divided
+        }
+
+        channel_t *channel = (channel_t *)aligned_alloc(CHANNEL_CACHE_LINE, sizeof(channel_t));
+        cell_t *ring       = (cell_t *)malloc((size_t)cells * sizeof(cell_t));
+        if (!channel || !ring)
+        {
+                free(ring);
+                free(channel);
+                return NULL;
+        }
+        memset(channel, 0, sizeof(*channel));
+        channel->cells = ring;
+        channel->mask  = cells - 1;
+        return channel;
+}
+
+void channel_free(channel_t *channel)
+{
+        if (!channel)
+        {
+                return;
+        }
+        free(channel->cells);
+        free(channel);
+        return;
+}
+
+cell_t *channel_reserve(channel_t *channel, uint32_t *count)
+{
+        uint64_t tail       = channel->tail;
+        channel->head_cache = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+        uint32_t offset     = (uint32_t)tail & channel->mask;
+        uint32_t room       = channel->mask + 1 - (uint32_t)(tail - channel->head_cache);
+        uint32_t run        = channel->mask + 1 - offset;                       // Cells before the ring wraps
+        *count = (room < run) ? room : run;
+        return &channel->cells[offset];
+}
+
+void channel_commit(channel_t *channel, uint32_t count)
+{
+        __atomic_store_n(&channel->tail, channel->tail + count, __ATOMIC_RELEASE); // Publishes the filled cells
+        return;
+}
+
+const cell_t *channel_peek(channel_t *channel, uint32_t *count)
+{
+        uint64_t head       = channel->head;
+        channel->tail_cache = __atomic_load_n(&channel->tail, __ATOMIC_ACQUIRE);
+        uint32_t offset     = (uint32_t)head & channel->mask;
+        uint32_t ready      = (uint32_t)(channel->tail_cache - head);
+        uint32_t run        = channel->mask + 1 - offset;                       // Values before the ring wraps
+        *count = (ready < run) ? ready : run;
+        return &channel->cells[offset];
+}
+
+void channel_consume(channel_t *channel, uint32_t count)
+{
+        __atomic_store_n(&channel->head, channel->head + count, __ATOMIC_RELEASE); // Hands the cells back to the producer
+        return;
+}
+
+uint32_t channel_write(channel_t *channel, const cell_t *values, uint32_t count)
+{
+        uint32_t written = 0;
+        while (written < count)
+        {
+                uint32_t room;
+                cell_t *cells = channel_reserve(channel, &room);
+                if (room == 0)
+                {
+                        break;                                  // Full
+                }
+                room = (count - written < room) ? count - written : room;
+                memcpy(cells, values + written, room * sizeof(cell_t));
+                channel_commit(channel, room);
+                written += room;
+        }
+        return written;
+}
+
+uint32_t channel_read(channel_t *channel, cell_t *values, uint32_t count)
+{
+        uint32_t taken = 0;
+        while (taken < count)
+        {
+                uint32_t ready;
+                const cell_t *cells = channel_peek(channel, &ready);
+                if (ready == 0)
+                {
+                        break;                                  // Empty
+                }
+                ready = (count - taken < ready) ? count - taken : ready;
+                memcpy(values + taken, cells, ready * sizeof(cell_t));
+                channel_consume(channel, ready);
+                taken += ready;
+        }
+        return taken;
+}
+
+void channel_close(channel_t *channel)
+{
+        __atomic_store_n(&channel->closed, true, __ATOMIC_RELEASE); // Ordered after every committed value
+        return;
+}
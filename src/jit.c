@@ -0,0 +1,896 @@
+/***
+ *
+ * @file: jit.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the x86-64 template JIT of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+
+#include <sys/mman.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "threaded.h"
+#include "optimize.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED           1
+#else
+#define JIT_SUPPORTED           0
+#endif
+
+#define JIT_WORD_BYTES          96              // Upper bound of the native code of one program word
+#define JIT_FIXED_BYTES         256             // Upper bound of the prologue, the epilogue and the end of program
+#define JIT_COUNT_BYTES         26              // Upper bound of the counting of one program word and its entry stub
+
+#define X86_CF                  0x001           // Carry flag of RFLAGS
+#define X86_ZF                  0x040           // Zero flag of RFLAGS
+#define X86_SF                  0x080           // Sign flag of RFLAGS
+#define X86_OF                  0x800           // Overflow flag of RFLAGS
+
+/**
+ * @brief Machine state exchanged with the native code
+ * @note The offsets of the fields are encoded in the prologue and the epilogue.
+ */
+typedef struct jit_frame
+{
+        cell_t *top;                    // [0]  Slot of the top of stack, the guard cell when empty
+        cell_t *base;                   // [8]  Bottom of the operand stack
+        cell_t *limit;                  // [16] Highest slot of the operand stack
+        uint32_t pc;                    // [24] Program counter on entry and on exit
+        uint32_t error;                 // [28] vm_error_t of the exit
+        uint64_t flags;                 // [32] Flag register as CF, ZF, SF and OF of RFLAGS
+        uint32_t fp;                    // [40] Stack index of local slot 0
+        frame_t *call;                  // [48] Next free call frame
+        frame_t *call_limit;            // [56] End of the call stack
+        frame_t *call_base;             // [64] Bottom of the call stack
+        uint64_t retired;               // [72] Instructions of the blocks entered, kept in rbx by counted code
+        cell_t *peak;                   // [80] Highest slot of the top of stack, kept in r12 by counted code
+} jit_frame_t;
+
+typedef void (*jit_entry_t)(jit_frame_t *frame);
+
+struct jit_code
+{
+        void *memory;                   // Executable mapping
+        size_t mapped;                  // Size of the mapping in bytes
+        jit_entry_t entry;              // Native entry point
+        bool checked;                   // Compiled with stack bound checks, entered at any program counter
+        uint32_t *rest;                 // Instructions after every program word in its block, NULL unless counted
+};
+
+static struct jit_code jit_unsupported; // Cached for programs the JIT cannot compile
+
+void jit_free(struct jit_code *code)
+{
+        if (!code || code == &jit_unsupported)
+        {
+                return;
+        }
+        munmap(code->memory, code->mapped);
+        free(code->rest);
+        free(code);
+        return;
+}
+
+#if JIT_SUPPORTED
+
+/**
+ * @brief Native code under construction
+ */
+typedef struct jit_buffer
+{
+        uint8_t *bytes;                 // Code
+        size_t count;                   // Bytes emitted
+        uint32_t *offsets;              // Offset of the native code of every program word, then of the end of program
+        uint32_t *patches;              // Offsets of rel32 fields waiting for the offset of a program word
+        uint32_t *targets;              // Program word of every patch
+        uint32_t patch_count;           // Number of patches
+        uint32_t epilogue;              // Offset of the epilogue
+} jit_buffer_t;
+
+static void emit(jit_buffer_t *b, const uint8_t *bytes, size_t count)
+{
+        memcpy(b->bytes + b->count, bytes, count);
+        b->count += count;
+        return;
+}
+
+static void emit32(jit_buffer_t *b, uint32_t value)
+{
+        memcpy(b->bytes + b->count, &value, sizeof(value));
+        b->count += sizeof(value);
+        return;
+}
+
+#define EMIT(b, ...)            emit((b), (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+/**
+ * @brief Emits a jump to the epilogue
+ * @param b Native code under construction
+ * @return void
+ */
+static void emit_leave(jit_buffer_t *b)
+{
+        EMIT(b, 0xe9);                                          // jmp epilogue
+        emit32(b, b->epilogue - (uint32_t)(b->count + 4));
+        return;
+}
+
+/**
+ * @brief Emits an exit of the native code
+ * @param b Native code under construction
+ * @param pc Program counter written back to the context
+ * @param error Reason of the exit
+ * @return void
+ * @note 15 bytes long, conditional exits jump over it.
+ */
+static void emit_exit(jit_buffer_t *b, uint32_t pc, vm_error_t error)
+{
+        EMIT(b, 0xb9);                                          // mov ecx, pc
+        emit32(b, pc);
+        EMIT(b, 0xba);                                          // mov edx, error
+        emit32(b, error);
+        emit_leave(b);
+        return;
+}
+
+/**
+ * @brief Emits a jump to the native code of a program word
+ * @param b Native code under construction
+ * @param opcode Jump opcode bytes, without the rel32
+ * @param count Number of opcode bytes
+ * @param target Program word, resolved once every word is emitted
+ * @return void
+ */
+static void emit_jump(jit_buffer_t *b, const uint8_t *opcode, size_t count, uint32_t target)
+{
+        emit(b, opcode, count);
+        b->patches[b->patch_count]   = (uint32_t)b->count;
+        b->targets[b->patch_count++] = target;
+        emit32(b, 0);
+        return;
+}
+
+/**
+ * @brief Emits a jump through the dispatch table to the program address in rcx
+ * @param b Native code under construction
+ * @param table Receives the offset of the rel32 field addressing the dispatch table
+ * @return void
+ * @note The caller checks that rcx is inside the program.
+ */
+static void emit_dispatch(jit_buffer_t *b, uint32_t *table)
+{
+        EMIT(b, 0x4c, 0x8d, 0x15);                              // lea r10, [rip + table]
+        *table = (uint32_t)b->count;
+        emit32(b, 0);
+        EMIT(b, 0x41, 0xff, 0x24, 0xca);                        // jmp [r10 + rcx * 8]
+        return;
+}
+
+/**
+ * @brief Emits the count of the instructions retired by a block
+ * @param b Native code under construction
+ * @param count Instructions of the block
+ * @return void
+ * @note lea leaves RFLAGS alone.
+ */
+static void emit_count(jit_buffer_t *b, uint32_t count)
+{
+        if (count < 0x80)
+        {
+                EMIT(b, 0x48, 0x8d, 0x5b, (uint8_t)count);     // lea rbx, [rbx + count]
+                return;
+        }
+        EMIT(b, 0x48, 0x8d, 0x9b);                              // lea rbx, [rbx + count]
+        emit32(b, count);
+        return;
+}
+
+/**
+ * @brief Emits the peak tracking of a push in counted code
+ * @param b Native code under construction
+ * @param counted Compiling counted code, nothing is emitted otherwise
+ * @return void
+ * @note Only pushes raise the stack pointer, the flags of the VM live in r11.
+ */
+static void emit_pushed(jit_buffer_t *b, bool counted)
+{
+        if (counted)
+        {
+                EMIT(b, 0x4c, 0x39, 0xe6);                      // cmp rsi, r12
+                EMIT(b, 0x4c, 0x0f, 0x47, 0xe6);                // cmova r12, rsi
+        }
+        return;
+}
+
+/**
+ * @brief Returns the instruction the native code continues with when an instruction falls through
+ * @param in Pointer to the program words
+ * @param size Number of program words
+ * @param pc Program address of the instruction
+ * @return Address of the next instruction, UINT32_MAX if the instruction branches, returns, halts or always exits
+ */
+static uint32_t jit_next(const uint32_t *in, uint32_t size, uint32_t pc)
+{
+        uint32_t instruction = in[pc];
+        if (GET_TYPE(instruction) == POSITIVE_INTEGER || GET_TYPE(instruction) == NEGATIVE_INTEGER)
+        {
+                return pc + 1;
+        }
+        const opcode_info_t *info = stackvm_opcode_info(GET_DATA(instruction));
+        if (GET_TYPE(instruction) != PRIMITIVE_INSTRUCTION || !info || info->target ||
+            GET_DATA(instruction) == HALT || GET_DATA(instruction) == RET || pc + info->operands >= size)
+        {
+                return UINT32_MAX;
+        }
+        return pc + 1 + info->operands;                         // LIT and the local slot instructions skip their operand words
+}
+
+/**
+ * @brief Splits a program into the blocks counting the instructions retired
+ * @param in Pointer to the program words
+ * @param size Number of program words
+ * @param leader Receives the words starting a block, `size` flags cleared by the caller
+ * @return Instructions after every program word up to the end of its block, NULL on failure
+ * @note Every block adds its instructions to rbx once when it is entered. Blocks start at the first
+ *       word, at branch targets, after conditional branches and at return addresses, a word entered
+ *       through the dispatch table anywhere else adds the rest of its block in an entry stub.
+ */
+static uint32_t *jit_blocks(const uint32_t *in, uint32_t size, bool *leader)
+{
+        uint32_t *rest = malloc((size_t)size * sizeof(uint32_t));
+        if (!rest)
+        {
+                return NULL;
+        }
+        leader[0] = true;
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                const opcode_info_t *info = stackvm_opcode_info(GET_DATA(in[pc]));
+                if (GET_TYPE(in[pc]) != PRIMITIVE_INSTRUCTION || !info || !info->target)
+                {
+                        continue;
+                }
+                if (pc + 1 < size && in[pc + 1] < size)
+                {
+                        leader[in[pc + 1]] = true;
+                }
+                if (pc + 2 < size)
+                {
+                        leader[pc + 2] = true;                  // Not taken or returned to
+                }
+        }
+        for (uint32_t pc = size; pc-- > 0; )
+        {
+                uint32_t next = jit_next(in, size, pc);
+                rest[pc] = (next < size && !leader[next]) ? 1 + rest[next] : 0;
+        }
+        return rest;
+}
+
+/**
+ * @brief Compiles a program into native code
+ * @param program Pointer to the program
+ * @param counted Count the instructions retired in rbx and the highest top of stack slot in r12
+ * @return Pointer to the native code on success, NULL on failure
+ */
+static struct jit_code *jit_compile(const program_t *program, bool counted)
+{
+        uint32_t size       = program->size;
+        const uint32_t *in  = program->code;
+        if (size > INT32_MAX)
+        {
+                return NULL;                                    // Program addresses are compared as signed 32-bit immediates
+        }
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                if (in[pc] == GET_OPCODE(IN) || in[pc] == GET_OPCODE(OUT))
+                {
+                        return NULL;                            // Channel instructions wait for the host, the threaded engine runs them
+                }
+                if (in[pc] == GET_OPCODE(CALL_NATIVE))
+                {
+                        return NULL;                            // Native calls go through the table of the threaded engine
+                }
+        }
+        bool checked        = !program->verified;               // Verified programs are only entered when they fit the stack
+        bool returns        = false;                            // RET dispatches through the table as well
+        for (uint32_t pc = 0; pc < size && !checked && !returns; pc++)
+        {
+                returns = (in[pc] == GET_OPCODE(RET));
+        }
+        size_t capacity     = JIT_FIXED_BYTES + (size_t)(JIT_WORD_BYTES + JIT_COUNT_BYTES) * size;
+        size_t table_bytes  = (checked || returns) ? (size_t)size * sizeof(uint64_t) : 0;
+        uint32_t patch_room = 3 * size + 1;
+        uint32_t *tables    = calloc(2 * (size_t)patch_room + 2 * (size_t)size + 1, sizeof(uint32_t));
+        bool *leader        = calloc(size + 1, sizeof(bool));
+        uint32_t *rest      = (leader && size) ? jit_blocks(in, size, leader) : NULL;
+        jit_buffer_t b      = { .bytes = malloc(capacity) };
+        if (!b.bytes || !tables || !rest)
+        {
+                free(b.bytes);
+                free(tables);
+                free(leader);
+                free(rest);
+                return NULL;
+        }
+        b.patches = tables;
+        b.targets = tables + patch_room;
+        b.offsets = tables + 2 * (size_t)patch_room;
+        uint32_t *stubs = b.offsets + size + 1;                 // Entry stub of every word that does not start a block
+
+        // Epilogue: write the machine state back to the frame
+        b.epilogue = (uint32_t)b.count;
+        EMIT(&b, 0x48, 0x89, 0x06);                             // mov [rsi], rax
+        EMIT(&b, 0x48, 0x89, 0x37);                             // mov [rdi], rsi
+        EMIT(&b, 0x89, 0x4f, 0x18);                             // mov [rdi + 24], ecx
+        EMIT(&b, 0x89, 0x57, 0x1c);                             // mov [rdi + 28], edx
+        EMIT(&b, 0x4c, 0x89, 0x5f, 0x20);                       // mov [rdi + 32], r11
+        if (counted)
+        {
+                EMIT(&b, 0x48, 0x89, 0x5f, 0x48);               // mov [rdi + 72], rbx
+                EMIT(&b, 0x4c, 0x89, 0x67, 0x50);               // mov [rdi + 80], r12
+                EMIT(&b, 0x41, 0x5c);                           // pop r12
+                EMIT(&b, 0x5b);                                 // pop rbx
+        }
+        EMIT(&b, 0xc3);                                         // ret
+
+        // Prologue: rsi = top, rax = top of stack, r8 = base, r9 = limit, r11 = flags,
+        // rbx = instructions retired and r12 = highest top of stack slot in counted code
+        uint32_t entry = (uint32_t)b.count;
+        uint32_t entry_table = 0;
+        if (counted)
+        {
+                EMIT(&b, 0x53);                                 // push rbx
+                EMIT(&b, 0x41, 0x54);                           // push r12
+                EMIT(&b, 0x48, 0x8b, 0x5f, 0x48);               // mov rbx, [rdi + 72]
+                EMIT(&b, 0x4c, 0x8b, 0x67, 0x50);               // mov r12, [rdi + 80]
+        }
+        EMIT(&b, 0x48, 0x8b, 0x37);                             // mov rsi, [rdi]
+        EMIT(&b, 0x4c, 0x8b, 0x47, 0x08);                       // mov r8, [rdi + 8]
+        EMIT(&b, 0x4c, 0x8b, 0x4f, 0x10);                       // mov r9, [rdi + 16]
+        EMIT(&b, 0x48, 0x8b, 0x06);                             // mov rax, [rsi]
+        EMIT(&b, 0x4c, 0x8b, 0x5f, 0x20);                       // mov r11, [rdi + 32]
+        if (checked)
+        {
+                EMIT(&b, 0x8b, 0x4f, 0x18);                     // mov ecx, [rdi + 24]
+                EMIT(&b, 0x81, 0xf9);                           // cmp ecx, size
+                emit32(&b, size);
+                EMIT(&b, 0x72, 0x0a);                           // jb dispatch
+                EMIT(&b, 0xba);                                 // mov edx, ERROR_INVALID_ADDRESS
+                emit32(&b, ERROR_INVALID_ADDRESS);
+                emit_leave(&b);
+                emit_dispatch(&b, &entry_table);
+        }
+
+        uint32_t *ret_tables = calloc((size_t)size + 1, sizeof(uint32_t)); // rel32 fields addressing the dispatch table
+        uint32_t ret_count   = 0;
+        if (!ret_tables)
+        {
+                free(b.bytes);
+                free(tables);
+                free(leader);
+                free(rest);
+                return NULL;
+        }
+
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                uint32_t instruction = in[pc];
+                uint32_t data        = GET_DATA(instruction);
+                b.offsets[pc]        = (uint32_t)b.count;
+                if (counted && leader[pc])
+                {
+                        emit_count(&b, 1 + rest[pc]);           // The block retires all of its instructions on entry
+                }
+
+                switch (GET_TYPE(instruction))
+                {
+                case POSITIVE_INTEGER:
+                case NEGATIVE_INTEGER:
+                        if (checked)
+                        {
+                                EMIT(&b, 0x4c, 0x39, 0xce, 0x72, 0x0f); // cmp rsi, r9; jb push
+                                emit_exit(&b, pc, ERROR_STACK_OVERFLOW);
+                        }
+                        EMIT(&b, 0x48, 0x89, 0x06);             // mov [rsi], rax
+                        EMIT(&b, 0x48, 0x83, 0xc6, 0x08);       // add rsi, 8
+                        EMIT(&b, 0x48, 0xc7, 0xc0);             // mov rax, sign-extended immediate
+                        emit32(&b, (uint32_t)GET_IMMEDIATE(instruction));
+                        emit_pushed(&b, counted);
+                        continue;
+                case PRIMITIVE_INSTRUCTION:
+                        break;
+                default:
+                        emit_exit(&b, pc, ERROR_UNDEFINED_INSTRUCTION);
+                        continue;
+                }
+
+                const opcode_info_t *info = stackvm_opcode_info(data);
+                if (!info)
+                {
+                        emit_exit(&b, pc, ERROR_UNDEFINED_PRIMITIVE);
+                        continue;
+                }
+                if (checked && info->pops == 2)
+                {
+                        EMIT(&b, 0x4c, 0x39, 0xc6, 0x77, 0x0f); // cmp rsi, r8; ja op
+                        emit_exit(&b, pc, ERROR_STACK_UNDERFLOW);
+                }
+                else if (checked && info->pops == 1)
+                {
+                        EMIT(&b, 0x4c, 0x39, 0xc6, 0x73, 0x0f); // cmp rsi, r8; jae op
+                        emit_exit(&b, pc, ERROR_STACK_UNDERFLOW);
+                }
+                if (data == DIV)
+                {
+                        EMIT(&b, 0x48, 0x85, 0xc0, 0x75, 0x0f); // test rax, rax; jnz div
+                        emit_exit(&b, pc, ERROR_DIVISION_BY_ZERO);
+                }
+                if (data == LIT)
+                {
+                        if (pc + 2 >= size)
+                        {
+                                emit_exit(&b, pc, ERROR_INVALID_ADDRESS); // Missing operand words
+                                continue;
+                        }
+                        if (checked)
+                        {
+                                EMIT(&b, 0x4c, 0x39, 0xce, 0x72, 0x0f); // cmp rsi, r9; jb lit
+                                emit_exit(&b, pc, ERROR_STACK_OVERFLOW);
+                        }
+                        EMIT(&b, 0x48, 0x89, 0x06);             // mov [rsi], rax
+                        EMIT(&b, 0x48, 0x83, 0xc6, 0x08);       // add rsi, 8
+                        EMIT(&b, 0x48, 0xb8);                   // mov rax, imm64
+                        emit32(&b, in[pc + 1]);
+                        emit32(&b, in[pc + 2]);
+                        emit_pushed(&b, counted);
+                        emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, pc + 3); // Skip the operand words
+                        continue;
+                }
+                if (data == LOAD_LOCAL || data == STORE_LOCAL)
+                {
+                        if (pc + 1 >= size)
+                        {
+                                emit_exit(&b, pc, ERROR_INVALID_ADDRESS); // Missing slot word
+                                continue;
+                        }
+                        // rcx = base + (fp + slot) * 8, the slot word is sign-extended
+                        EMIT(&b, 0x8b, 0x57, 0x28);             // mov edx, [rdi + 40]
+                        EMIT(&b, 0x48, 0x81, 0xc2);             // add rdx, slot
+                        emit32(&b, in[pc + 1]);
+                        EMIT(&b, 0x49, 0x8d, 0x0c, 0xd0);       // lea rcx, [r8 + rdx * 8]
+                        if (checked)
+                        {
+                                EMIT(&b, 0x48, 0x85, 0xd2, 0x78, 0x05); // test rdx, rdx; js fault
+                                EMIT(&b, 0x48, 0x39, 0xf1);     // cmp rcx, rsi
+                                EMIT(&b, (data == LOAD_LOCAL) ? 0x76 : 0x72, 0x0f); // jbe/jb op, a store reads below its value
+                                emit_exit(&b, pc, ERROR_INVALID_LOCAL);
+                        }
+                        if (data == LOAD_LOCAL)
+                        {
+                                if (checked)
+                                {
+                                        EMIT(&b, 0x4c, 0x39, 0xce, 0x72, 0x0f); // cmp rsi, r9; jb load
+                                        emit_exit(&b, pc, ERROR_STACK_OVERFLOW);
+                                }
+                                EMIT(&b, 0x48, 0x89, 0x06);     // mov [rsi], rax
+                                EMIT(&b, 0x48, 0x83, 0xc6, 0x08); // add rsi, 8
+                                EMIT(&b, 0x48, 0x8b, 0x01);     // mov rax, [rcx]
+                                emit_pushed(&b, counted);
+                        }
+                        else
+                        {
+                                EMIT(&b, 0x48, 0x89, 0x01);     // mov [rcx], rax
+                                EMIT(&b, 0x48, 0x83, 0xee, 0x08); // sub rsi, 8
+                                EMIT(&b, 0x48, 0x8b, 0x06);     // mov rax, [rsi]
+                        }
+                        if (checked)
+                        {
+                                emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, pc + 2); // Skip the slot word
+                        }
+                        else
+                        {
+                                b.offsets[++pc] = (uint32_t)b.count; // Verified code never enters the slot word
+                        }
+                        continue;
+                }
+                if (info->pops >= 1 && data != NOT)
+                {
+                        EMIT(&b, 0x48, 0x89, 0xc1);             // mov rcx, rax
+                        EMIT(&b, 0x48, 0x83, 0xee, 0x08);       // sub rsi, 8
+                        EMIT(&b, 0x48, 0x8b, 0x06);             // mov rax, [rsi]
+                }
+
+                uint32_t target = (pc + 1 < size) ? in[pc + 1] : size; // Missing target words leave the program
+                bool flags      = (data == ADD || data == SUB || data == MUL || data == DIV || data == CMP ||
+                                   (data >= LT && data <= NE)) && (checked || !flags_dead(in, size, pc)); // Flags set here can be read
+                switch (data)
+                {
+                case HALT:
+                        emit_exit(&b, pc, ERROR_NONE);
+                        break;
+                case ADD:
+                        EMIT(&b, 0x48, 0x01, 0xc8);             // add rax, rcx
+                        if (flags)
+                        {
+                                EMIT(&b, 0x9c, 0x41, 0x5b);     // pushfq; pop r11
+                        }
+                        break;
+                case SUB:
+                        EMIT(&b, 0x48, 0x29, 0xc8);             // sub rax, rcx
+                        if (flags)
+                        {
+                                EMIT(&b, 0x9c, 0x41, 0x5b);     // pushfq; pop r11
+                        }
+                        break;
+                case MUL:
+                        EMIT(&b, 0x48, 0x0f, 0xaf, 0xc1);       // imul rax, rcx
+                        if (flags)
+                        {
+                                // imul sets CF and OF, ZF and SF come from the product
+                                EMIT(&b, 0x9c, 0x41, 0x5b);     // pushfq; pop r11
+                                EMIT(&b, 0x48, 0x85, 0xc0);     // test rax, rax
+                                EMIT(&b, 0x9c, 0x5a);           // pushfq; pop rdx
+                                EMIT(&b, 0x41, 0x81, 0xe3);     // and r11d, CF | OF
+                                emit32(&b, X86_CF | X86_OF);
+                                EMIT(&b, 0x81, 0xe2);           // and edx, ZF | SF
+                                emit32(&b, X86_ZF | X86_SF);
+                                EMIT(&b, 0x41, 0x09, 0xd3);     // or r11d, edx
+                        }
+                        break;
+                case DIV:
+                        // idiv faults on INT64_MIN / -1, a divisor of -1 negates instead
+                        EMIT(&b, 0x48, 0x83, 0xf9, 0xff);       // cmp rcx, -1
+                        if (!flags)
+                        {
+                                EMIT(&b, 0x75, 0x05);           // jne idiv
+                                EMIT(&b, 0x48, 0xf7, 0xd8);     // neg rax
+                                EMIT(&b, 0xeb, 0x05);           // jmp done
+                                EMIT(&b, 0x48, 0x99);           // idiv: cqo
+                                EMIT(&b, 0x48, 0xf7, 0xf9);     // idiv rcx
+                                break;
+                        }
+                        // neg sets OF for INT64_MIN and CF for any other non-zero value, idiv leaves the flags undefined
+                        EMIT(&b, 0x75, 0x0f);                   // jne idiv
+                        EMIT(&b, 0x48, 0xf7, 0xd8);             // neg rax
+                        EMIT(&b, 0x9c, 0x41, 0x5b);             // pushfq; pop r11
+                        EMIT(&b, 0x41, 0x81, 0xe3);             // and r11d, ZF | SF | OF
+                        emit32(&b, X86_ZF | X86_SF | X86_OF);
+                        EMIT(&b, 0xeb, 0x0b);                   // jmp done
+                        EMIT(&b, 0x48, 0x99);                   // idiv: cqo
+                        EMIT(&b, 0x48, 0xf7, 0xf9);             // idiv rcx
+                        EMIT(&b, 0x48, 0x85, 0xc0);             // test rax, rax
+                        EMIT(&b, 0x9c, 0x41, 0x5b);             // pushfq; pop r11
+                        break;
+                case AND:
+                        EMIT(&b, 0x48, 0x21, 0xc8);             // and rax, rcx
+                        break;
+                case OR:
+                        EMIT(&b, 0x48, 0x09, 0xc8);             // or rax, rcx
+                        break;
+                case NOT:
+                        EMIT(&b, 0x48, 0xf7, 0xd0);             // not rax
+                        break;
+                case XOR:
+                        EMIT(&b, 0x48, 0x31, 0xc8);             // xor rax, rcx
+                        break;
+                case LT:
+                case GT:
+                case LE:
+                case GE:
+                case EQ:
+                case NE:
+                {
+                        static const uint8_t setcc[PRIMITIVE_COUNT] =
+                        {
+                                [LT] = 0x9c, [GT] = 0x9f, [LE] = 0x9e, [GE] = 0x9d, [EQ] = 0x94, [NE] = 0x95,
+                        };
+                        EMIT(&b, 0x48, 0x39, 0xc8);             // cmp rax, rcx
+                        if (flags)
+                        {
+                                EMIT(&b, 0x9c, 0x41, 0x5b);     // pushfq; pop r11
+                        }
+                        EMIT(&b, 0x0f, setcc[data], 0xc0);      // setcc al, signed
+                        EMIT(&b, 0x0f, 0xb6, 0xc0);             // movzx eax, al
+                        break;
+                }
+                case CMP:
+                        EMIT(&b, 0x48, 0x39, 0xc8);             // cmp rax, rcx
+                        if (flags)
+                        {
+                                EMIT(&b, 0x9c, 0x41, 0x5b);     // pushfq; pop r11
+                        }
+                        EMIT(&b, 0x48, 0x83, 0xee, 0x08);       // sub rsi, 8
+                        EMIT(&b, 0x48, 0x8b, 0x06);             // mov rax, [rsi]
+                        break;
+                case BR:
+                        if (target <= size)
+                        {
+                                emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, target);
+                        }
+                        else
+                        {
+                                emit_exit(&b, target, ERROR_INVALID_ADDRESS);
+                        }
+                        break;
+                case BRT:
+                case BRF:
+                case BRZ:
+                case BRNZ:
+                case BRLT:
+                case BRGE:
+                case BRGT:
+                case BRLE:
+                {
+                        // The condition is left in ZF, jnz takes BRT, BRZ, BRLT and BRLE, jz the others
+                        bool nonzero = (data == BRT || data == BRZ || data == BRLT || data == BRLE);
+                        if (data == BRT || data == BRF)
+                        {
+                                EMIT(&b, 0x48, 0x85, 0xc9);     // test rcx, rcx
+                        }
+                        else if (data == BRZ || data == BRNZ)
+                        {
+                                EMIT(&b, 0x41, 0xf6, 0xc3, X86_ZF); // test r11b, ZF
+                        }
+                        else
+                        {
+                                // Bit 7 of edx is SF ^ OF and bit 6 is ZF, DF is always clear
+                                EMIT(&b, 0x44, 0x89, 0xda);     // mov edx, r11d
+                                EMIT(&b, 0xc1, 0xea, 0x04);     // shr edx, 4
+                                EMIT(&b, 0x44, 0x31, 0xda);     // xor edx, r11d
+                                EMIT(&b, 0xf6, 0xc2, (data == BRLT || data == BRGE) ? 0x80 : 0xc0); // test dl, less or less | zero
+                        }
+                        if (target <= size)
+                        {
+                                emit_jump(&b, (const uint8_t[]){ 0x0f, nonzero ? 0x85 : 0x84 }, 2, target);
+                        }
+                        else
+                        {
+                                EMIT(&b, nonzero ? 0x74 : 0x75, 0x0f); // jz/jnz over the exit
+                                emit_exit(&b, target, ERROR_INVALID_ADDRESS);
+                        }
+                        if (pc + 2 <= size)
+                        {
+                                emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, pc + 2); // Skip the branch target word
+                        }
+                        else
+                        {
+                                emit_exit(&b, pc + 2, ERROR_INVALID_ADDRESS);
+                        }
+                        break;
+                }
+                case CALL:
+                        if (checked)
+                        {
+                                EMIT(&b, 0x48, 0x8b, 0x4f, 0x30);       // mov rcx, [rdi + 48]
+                                EMIT(&b, 0x48, 0x3b, 0x4f, 0x38, 0x72, 0x0f); // cmp rcx, [rdi + 56]; jb call
+                                emit_exit(&b, pc, ERROR_CALL_OVERFLOW);
+                        }
+                        // Push the frame { pc + 2, fp }, local slot 0 is the first free stack slot
+                        EMIT(&b, 0x48, 0x8b, 0x4f, 0x30);       // mov rcx, [rdi + 48]
+                        EMIT(&b, 0xc7, 0x01);                   // mov dword [rcx], pc + 2
+                        emit32(&b, pc + 2);
+                        EMIT(&b, 0x8b, 0x57, 0x28);             // mov edx, [rdi + 40]
+                        EMIT(&b, 0x89, 0x51, 0x04);             // mov [rcx + 4], edx
+                        EMIT(&b, 0x48, 0x83, 0xc1, 0x08);       // add rcx, 8
+                        EMIT(&b, 0x48, 0x89, 0x4f, 0x30);       // mov [rdi + 48], rcx
+                        EMIT(&b, 0x48, 0x89, 0xf2);             // mov rdx, rsi
+                        EMIT(&b, 0x4c, 0x29, 0xc2);             // sub rdx, r8
+                        EMIT(&b, 0x48, 0xc1, 0xfa, 0x03);       // sar rdx, 3
+                        EMIT(&b, 0xff, 0xc2);                   // inc edx
+                        EMIT(&b, 0x89, 0x57, 0x28);             // mov [rdi + 40], edx
+                        if (target <= size)
+                        {
+                                emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, target);
+                        }
+                        else
+                        {
+                                emit_exit(&b, target, ERROR_INVALID_ADDRESS);
+                        }
+                        break;
+                case RET:
+                        EMIT(&b, 0x48, 0x8b, 0x4f, 0x30);       // mov rcx, [rdi + 48]
+                        if (checked)
+                        {
+                                EMIT(&b, 0x48, 0x3b, 0x4f, 0x40, 0x77, 0x0f); // cmp rcx, [rdi + 64]; ja ret
+                                emit_exit(&b, pc, ERROR_CALL_UNDERFLOW);
+                        }
+                        // Pop the frame, restore fp and dispatch to the return address
+                        EMIT(&b, 0x48, 0x83, 0xe9, 0x08);       // sub rcx, 8
+                        EMIT(&b, 0x48, 0x89, 0x4f, 0x30);       // mov [rdi + 48], rcx
+                        EMIT(&b, 0x8b, 0x51, 0x04);             // mov edx, [rcx + 4]
+                        EMIT(&b, 0x89, 0x57, 0x28);             // mov [rdi + 40], edx
+                        EMIT(&b, 0x8b, 0x09);                   // mov ecx, [rcx]
+                        EMIT(&b, 0x48, 0x81, 0xf9);             // cmp rcx, size
+                        emit32(&b, size);
+                        EMIT(&b, 0x72, 0x0f);                   // jb dispatch
+                        emit_exit(&b, size, ERROR_INVALID_ADDRESS);
+                        emit_dispatch(&b, &ret_tables[ret_count++]);
+                        break;
+                }
+        }
+        b.offsets[size] = (uint32_t)b.count;
+        emit_exit(&b, size, ERROR_INVALID_ADDRESS);             // Running past the last word
+        for (uint32_t pc = 0; pc < size && table_bytes; pc++)
+        {
+                stubs[pc] = b.offsets[pc];
+                if (counted && !leader[pc])
+                {
+                        stubs[pc] = (uint32_t)b.count;          // Entered in the middle of a block, retire the rest of it
+                        emit_count(&b, 1 + rest[pc]);
+                        emit_jump(&b, (const uint8_t[]){ 0xe9 }, 1, pc);
+                }
+        }
+
+        for (uint32_t i = 0; i < b.patch_count; i++)
+        {
+                int32_t rel = (int32_t)(b.offsets[b.targets[i]] - (b.patches[i] + 4));
+                memcpy(b.bytes + b.patches[i], &rel, sizeof(rel));
+        }
+
+        // Dispatch table of absolute addresses for entries and returns, 8-byte aligned after the code
+        size_t table  = (b.count + 7) & ~(size_t)7;
+        size_t mapped = table + table_bytes;
+        struct jit_code *code = malloc(sizeof(*code));
+        void *memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (!code || memory == MAP_FAILED)
+        {
+                free(code);
+                free(b.bytes);
+                free(tables);
+                free(ret_tables);
+                free(leader);
+                free(rest);
+                if (memory != MAP_FAILED)
+                {
+                        munmap(memory, mapped);
+                }
+                return NULL;
+        }
+        memcpy(memory, b.bytes, b.count);
+        if (table_bytes)
+        {
+                uint64_t *addresses = (uint64_t *)((uint8_t *)memory + table);
+                for (uint32_t pc = 0; pc < size; pc++)
+                {
+                        addresses[pc] = (uint64_t)(uintptr_t)((uint8_t *)memory + stubs[pc]);
+                }
+                if (checked)
+                {
+                        ret_tables[ret_count++] = entry_table;
+                }
+                for (uint32_t i = 0; i < ret_count; i++)
+                {
+                        int32_t rel = (int32_t)(table - (ret_tables[i] + 4));
+                        memcpy((uint8_t *)memory + ret_tables[i], &rel, sizeof(rel));
+                }
+        }
+        free(b.bytes);
+        free(tables);
+        free(ret_tables);
+        free(leader);
+        if (!counted)
+        {
+                free(rest);                                     // Only the exits of counted code give instructions back
+                rest = NULL;
+        }
+
+        if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) // Never writable and executable at once
+        {
+                munmap(memory, mapped);
+                free(code);
+                free(rest);
+                return NULL;
+        }
+        code->memory  = memory;
+        code->mapped  = mapped;
+        code->entry   = (jit_entry_t)(void *)((uint8_t *)memory + entry);
+        code->checked = checked;
+        code->rest    = rest;
+        return code;
+}
+
+#else
+
+static struct jit_code *jit_compile(const program_t *program, bool counted)
+{
+        (void)program;
+        (void)counted;
+        return NULL; // Native code generation needs x86-64 Linux
+}
+
+#endif // JIT_SUPPORTED
+
+/**
+ * @brief Returns the native code of a program, compiling it on first use
+ * @param program Pointer to the program
+ * @param counted Return the code counting the instructions retired and the peak stack depth
+ * @return Pointer to the native code, NULL if the program cannot be compiled
+ * @note Contexts on several threads may race to compile the same program,
+ *       the first published code wins and the others are freed.
+ */
+static struct jit_code *jit_lookup(program_t *program, bool counted)
+{
+        struct jit_code **slot = counted ? &program->jit_counted : &program->jit;
+        struct jit_code *code  = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (!code)
+        {
+                struct jit_code *expected = NULL;
+                code = jit_compile(program, counted);
+                code = code ? code : &jit_unsupported;
+                if (!__atomic_compare_exchange_n(slot, &expected, code, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                {
+                        jit_free(code);
+                        code = expected;
+                }
+        }
+        return (code != &jit_unsupported) ? code : NULL;
+}
+
+void stackvm_run_jit(stackvm_t *vm)
+{
+        program_t *program = vm->program;
+        if (!program)
+        {
+                stackvm_fault(vm, ERROR_NO_PROGRAM);
+                return;
+        }
+
+        bool counted          = stackvm_counted(vm);                   // Counting is chosen once per run
+        struct jit_code *code = stackvm_hooked(vm) ? NULL : jit_lookup(program, counted);
+        bool enter = code && (code->checked || stackvm_unchecked(vm));
+        if (!enter)
+        {
+                stackvm_run_threaded(vm); // Traced, unsupported or not entered like the unchecked code
+                return;
+        }
+
+        jit_frame_t frame =
+        {
+                .top   = vm->stack - 1 + (uint32_t)(vm->sp + 1),
+                .base  = vm->stack,
+                .limit = vm->stack + vm->stack_size - 1,
+                .pc    = vm->pc,
+                .error = ERROR_NONE,
+                .flags = ((vm->flags & FLAG_C) ? X86_CF : 0) | ((vm->flags & FLAG_Z) ? X86_ZF : 0) |
+                         ((vm->flags & FLAG_N) ? X86_SF : 0) | ((vm->flags & FLAG_V) ? X86_OF : 0),
+                .fp         = vm->fp,
+                .call       = vm->frames + vm->calls,
+                .call_limit = vm->frames + vm->call_size,
+                .call_base  = vm->frames,
+                .retired    = 0,
+                .peak       = vm->stack - 1 + vm->peak,
+        };
+        vm->state = STATE_RUN;
+        code->entry(&frame);
+        if (counted)
+        {
+                // Blocks retire all of their instructions on entry, an exit gives back the ones after it and
+                // leaving the program retires the fetch past its end like on the other engines
+                vm->retired = (frame.pc < vm->size) ? frame.retired - code->rest[frame.pc] : frame.retired + 1;
+                vm->peak    = (uint32_t)(frame.peak - vm->stack + 1);
+        }
+        vm->pc = frame.pc;
+        vm->sp = (uint32_t)(frame.top - vm->stack);
+        vm->fp = frame.fp;
+        vm->calls = (uint32_t)(frame.call - vm->frames);
+        vm->flags = ((frame.flags & X86_CF) ? FLAG_C : 0) | ((frame.flags & X86_ZF) ? FLAG_Z : 0) |
+                    ((frame.flags & X86_SF) ? FLAG_N : 0) | ((frame.flags & X86_OF) ? FLAG_V : 0);
+        if (frame.error != ERROR_NONE)
+        {
+                stackvm_fault(vm, (vm_error_t)frame.error);
+                return;
+        }
+        vm->state = STATE_HALT;
+        return;
+}
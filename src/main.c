@@ -10,8 +10,64 @@
  * 
  */
 
+#include <inttypes.h>
+
 #include "defs.h"
 #include "stackvm.h"
+#include "channel.h"
+#include "metrics.h"
+
+#define MAIN_CHANNEL_CAPACITY   4096    // Cells of the channels of `-i`
+
+/**
+ * @brief Streams values between files and the channels of a context until its program stops
+ * @param vm Pointer to the StackVM context with a program and channels attached
+ * @param input Whitespace separated integers read by IN
+ * @param output Receives every value written by OUT, one per line
+ * @param slice Instruction budget of every run, 0 for whole runs
+ * @return Number of runs
+ */
+static uint64_t main_stream(stackvm_t *vm, FILE *input, FILE *output, uint64_t slice)
+{
+        uint64_t runs = 0;
+        do
+        {
+                uint32_t room;
+                cell_t *cells = channel_reserve(vm->in, &room);
+                uint32_t filled = 0;
+                while (filled < room && !vm->in->closed && fscanf(input, "%" SCNd64, &cells[filled]) == 1)
+                {
+                        filled++;
+                }
+                channel_commit(vm->in, filled);
+                if (filled < room)
+                {
+                        channel_close(vm->in);                  // End of the input, IN halts once it drained the channel
+                }
+                if (slice)
+                {
+                        stackvm_run_for(vm, slice);
+                }
+                else
+                {
+                        stackvm_run(vm);                        // Runs until the input is empty or the output full
+                }
+                runs++;
+
+                uint32_t ready;
+                const cell_t *values = channel_peek(vm->out, &ready);
+                while (ready)
+                {
+                        for (uint32_t i = 0; i < ready; i++)
+                        {
+                                fprintf(output, "%" PRId64 "\n", values[i]);
+                        }
+                        channel_consume(vm->out, ready);
+                        values = channel_peek(vm->out, &ready);
+                }
+        } while (vm->state == STATE_PAUSED);
+        return runs;
+}
 
 int main(int argc, char const *argv[])
 {
@@ -28,10 +84,196 @@ int main(int argc, char const *argv[])
                 fprintf(stderr, "Error: Failed to create VM context\n");
                 return EXIT_FAILURE; // Exit with error
         }
-        uint32_t program[] = {3, 4, GET_OPCODE(DIV), 6, GET_OPCODE(MUL), 8, 9, GET_OPCODE(ADD), GET_OPCODE(SUB), 10, GET_OPCODE(ADD), GET_OPCODE(HALT)}; // Load your program here
-        size_t size = sizeof(program) / sizeof(program[0]); // Set the size of the program
-        load_program(program, size); // Load the program into the VM memory
-        stackvm_run(vm); // Start the VM
+
+        trace_level_t trace_level = TRACE_OFF;
+        const char *trace_file    = "stackvm.trace";
+        const char *program_file  = NULL;
+        const char *profile_mode  = NULL;
+        uint64_t slice            = 0;
+        const char *input_file    = NULL;
+        const char *metrics_file  = NULL;
+
+        // Select the execution engine with `-e <engine>`, the trace with `-t <ops|full> [-o <file>]`
+        // a binary program file with `-p <file>`, the profile with `-P <flat|annotate>`
+        // time slices of `-s <instructions>`, the values streamed through IN and OUT with `-i <file|->`
+        // and where the runtime metrics go with `-M <file|unix:socket|->`
+        for (int i = 1; i < argc; i++)
+        {
+                if (i + 1 >= argc)
+                {
+                        continue;
+                }
+                if (strcmp(argv[i], "-t") == 0)
+                {
+                        trace_level = (strcmp(argv[i + 1], "full") == 0) ? TRACE_FULL
+                                    : (strcmp(argv[i + 1], "ops") == 0)  ? TRACE_OPS
+                                    : TRACE_OFF;
+                        continue;
+                }
+                if (strcmp(argv[i], "-o") == 0)
+                {
+                        trace_file = argv[i + 1];
+                        continue;
+                }
+                if (strcmp(argv[i], "-p") == 0)
+                {
+                        program_file = argv[i + 1];
+                        continue;
+                }
+                if (strcmp(argv[i], "-P") == 0)
+                {
+                        profile_mode = argv[i + 1];
+                        continue;
+                }
+                if (strcmp(argv[i], "-s") == 0)
+                {
+                        slice = strtoull(argv[i + 1], NULL, 10);
+                        continue;
+                }
+                if (strcmp(argv[i], "-i") == 0)
+                {
+                        input_file = argv[i + 1];
+                        continue;
+                }
+                if (strcmp(argv[i], "-M") == 0)
+                {
+                        metrics_file = argv[i + 1];
+                        continue;
+                }
+                if (strcmp(argv[i], "-e") != 0)
+                {
+                        continue;
+                }
+                engine_t engine = 0;
+                while (engine < ENGINE_COUNT && strcmp(argv[i + 1], stackvm_engine_name(engine)) != 0)
+                {
+                        engine++;
+                }
+                if (engine == ENGINE_COUNT)
+                {
+                        fprintf(stderr, "Error: Unknown engine '%s'\n", argv[i + 1]);
+                        stackvm_free(vm);
+                        return EXIT_FAILURE; // Exit with error
+                }
+                stackvm_set_engine(vm, engine);
+        }
+
+        FILE *trace_out = NULL;
+        if (trace_level == TRACE_OPS)
+        {
+                trace_out = stdout;
+        }
+        else if (trace_level == TRACE_FULL && !(trace_out = fopen(trace_file, "wb")))
+        {
+                fprintf(stderr, "Error: Failed to open trace file '%s'\n", trace_file);
+                stackvm_free(vm);
+                return EXIT_FAILURE; // Exit with error
+        }
+        if (stackvm_trace(vm, trace_level, trace_out) != 0)
+        {
+                stackvm_free(vm);
+                return EXIT_FAILURE; // Exit with error
+        }
+
+        if (profile_mode && stackvm_profile(vm, true) != 0)
+        {
+                stackvm_free(vm);
+                return EXIT_FAILURE; // Exit with error
+        }
+
+        if (metrics_file && stackvm_metrics(vm, true) != 0)
+        {
+                stackvm_free(vm);
+                return EXIT_FAILURE; // Exit with error
+        }
+
+        program_t *mapped = NULL;
+        if (program_file)
+        {
+                if (!(mapped = program_open(program_file))) // Map the program file, the code is not copied
+                {
+                        stackvm_free(vm);
+                        return EXIT_FAILURE; // Exit with error
+                }
+                attach_program(vm, mapped);
+                fprintf(stdout, "Loaded program of size %u words from '%s'...\n", mapped->size, program_file);
+        }
+        else
+        {
+                uint32_t program[] = {3, 4, GET_OPCODE(DIV), 6, GET_OPCODE(MUL), 8, 9, GET_OPCODE(ADD), GET_OPCODE(SUB), 10, GET_OPCODE(ADD), GET_OPCODE(HALT)}; // Load your program here
+                size_t size = sizeof(program) / sizeof(program[0]); // Set the size of the program
+                load_program(vm, program, size); // Load the program into the VM memory
+        }
+        FILE *input     = NULL;
+        channel_t *in   = NULL;
+        channel_t *out  = NULL;
+        if (input_file)
+        {
+                input = (strcmp(input_file, "-") == 0) ? stdin : fopen(input_file, "r");
+                in    = channel_create(MAIN_CHANNEL_CAPACITY);
+                out   = channel_create(MAIN_CHANNEL_CAPACITY);
+                if (!input || !in || !out)
+                {
+                        fprintf(stderr, "Error: Failed to open the input '%s'\n", input_file);
+                        stackvm_free(vm);
+                        program_free(mapped);
+                        channel_free(in);
+                        channel_free(out);
+                        return EXIT_FAILURE; // Exit with error
+                }
+                stackvm_channels(vm, in, out);
+        }
+        if (input)
+        {
+                uint64_t runs = main_stream(vm, input, stdout, slice);
+                fprintf(stdout, "Streamed in %" PRIu64 " runs...\n", runs);
+        }
+        else if (slice)
+        {
+                uint64_t slices = 1;
+                while (stackvm_run_for(vm, slice) == RUN_PAUSED) // Resume until the program halts or faults
+                {
+                        slices++;
+                }
+                fprintf(stdout, "Ran in %" PRIu64 " slices of %" PRIu64 " instructions...\n", slices, slice);
+        }
+        else
+        {
+                stackvm_run(vm); // Start the VM
+        }
+        fprintf(stdout, "Result: %" PRId64 "\n", (vm->sp != (uint32_t)-1) ? vm->stack[vm->sp] : 0); // Top of stack after HALT
+        if (vm->profile && strcmp(profile_mode, "annotate") == 0)
+        {
+                profile_annotate(stdout, vm->profile); // Hits of every instruction next to its disassembly
+        }
+        else if (vm->profile)
+        {
+                profile_report(stdout, vm->profile); // Flat profile by opcode
+        }
+        int status = EXIT_SUCCESS;
+        if (metrics_file && strcmp(metrics_file, "-") == 0)
+        {
+                metrics_write(stdout, vm->metrics); // Counters of the context
+        }
+        else if (metrics_file && strncmp(metrics_file, "unix:", 5) == 0)
+        {
+                status = (metrics_send(metrics_file + 5) == 0) ? EXIT_SUCCESS : EXIT_FAILURE; // Counters of the process
+        }
+        else if (metrics_file)
+        {
+                status = (metrics_save(metrics_file) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
         stackvm_free(vm); // Free the VM context
-        return EXIT_SUCCESS;
+        program_free(mapped); // Programs outlive the contexts they are attached to
+        channel_free(in); // Channels outlive the contexts they are attached to
+        channel_free(out);
+        if (input && input != stdin)
+        {
+                fclose(input); // Close the input file
+        }
+        if (trace_out && trace_out != stdout)
+        {
+                fclose(trace_out); // Close the binary trace file
+        }
+        return status;
 }
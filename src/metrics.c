@@ -0,0 +1,307 @@
+/***
+ *
+ * @file: metrics.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the runtime metrics of the StackVM contexts and of the process
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _DEFAULT_SOURCE // clock_gettime, open_memstream, MSG_NOSIGNAL
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "metrics.h"
+
+/**
+ * @brief Counters of one thread
+ * @note Only the owning thread writes them, readers add them up with relaxed loads.
+ */
+typedef struct metrics_shard
+{
+        metrics_t counters;                     // Counters of the runs on the thread
+        struct metrics_shard *next;             // Next shard of the process
+} metrics_shard_t;
+
+static metrics_shard_t *metrics_shards;                                 // Shard of every thread that counted a run
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;       // Serializes the shard list
+static _Thread_local metrics_shard_t *metrics_local;                   // Shard of the calling thread
+
+static const char *const metrics_reasons[ERROR_COUNT] =
+{
+        [ERROR_NONE]                    = "halt",
+        [ERROR_DIVISION_BY_ZERO]        = "division_by_zero",
+        [ERROR_UNDEFINED_PRIMITIVE]     = "undefined_primitive",
+        [ERROR_UNDEFINED_INSTRUCTION]   = "undefined_instruction",
+        [ERROR_STACK_UNDERFLOW]         = "stack_underflow",
+        [ERROR_STACK_OVERFLOW]          = "stack_overflow",
+        [ERROR_INVALID_ADDRESS]         = "invalid_address",
+        [ERROR_INVALID_STAGE]           = "invalid_stage",
+        [ERROR_NO_PROGRAM]              = "no_program",
+        [ERROR_CALL_OVERFLOW]           = "call_overflow",
+        [ERROR_CALL_UNDERFLOW]          = "call_underflow",
+        [ERROR_INVALID_LOCAL]           = "invalid_local",
+        [ERROR_NO_CHANNEL]              = "no_channel",
+        [ERROR_UNDEFINED_NATIVE]        = "undefined_native",
+        [ERROR_NATIVE_FAILED]           = "native_failed",
+        [ERROR_OUT_OF_MEMORY]           = "out_of_memory",
+};
+
+/**
+ * @brief Reads the monotonic clock
+ * @return Nanoseconds since an arbitrary origin
+ */
+static uint64_t metrics_clock(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Returns the shard of the calling thread, creating it on first use
+ * @return Pointer to the shard, NULL if it could not be allocated
+ */
+static metrics_shard_t *metrics_shard(void)
+{
+        if (!metrics_local)
+        {
+                metrics_shard_t *shard = calloc(1, sizeof(*shard));
+                if (!shard)
+                {
+                        return NULL;
+                }
+                pthread_mutex_lock(&metrics_lock);
+                shard->next    = metrics_shards;
+                metrics_shards = shard;
+                pthread_mutex_unlock(&metrics_lock);
+                metrics_local  = shard;
+        }
+        return metrics_local;
+}
+
+/**
+ * @brief Adds to a counter written by a single thread
+ * @param counter Pointer to the counter
+ * @param value Value to be added
+ * @return void
+ * @note A plain load and store, never a locked instruction. The store is atomic so readers never see it torn.
+ */
+static inline void metrics_add(uint64_t *counter, uint64_t value)
+{
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+        return;
+}
+
+/**
+ * @brief Counts a finished run
+ * @param metrics Counters of the context or of the thread
+ * @param vm Pointer to the StackVM context after the run
+ * @param latency Latency of the run in ns
+ * @param peak Deepest stack of the run
+ * @return void
+ */
+static void metrics_count(metrics_t *metrics, const stackvm_t *vm, uint64_t latency, uint64_t peak)
+{
+        uint64_t bound  = METRICS_FIRST_BUCKET;
+        uint32_t bucket = 0;
+        while (bucket + 1 < METRICS_BUCKETS && latency > bound)
+        {
+                bucket++;
+                bound <<= 1;
+        }
+        metrics_add(&metrics->runs, 1);
+        metrics_add(&metrics->instructions, vm->retired);
+        if (vm->state == STATE_PAUSED)
+        {
+                metrics_add(&metrics->pauses, 1);
+        }
+        else
+        {
+                metrics_add(&metrics->halts[(vm->error < ERROR_COUNT) ? vm->error : ERROR_INVALID_STAGE], 1);
+        }
+        if (peak > __atomic_load_n(&metrics->peak_depth, __ATOMIC_RELAXED))
+        {
+                __atomic_store_n(&metrics->peak_depth, peak, __ATOMIC_RELAXED);
+        }
+        metrics_add(&metrics->latency[bucket], 1);
+        metrics_add(&metrics->latency_sum, latency);
+        return;
+}
+
+uint64_t metrics_begin(void)
+{
+        return metrics_clock();
+}
+
+void metrics_end(stackvm_t *vm, uint64_t start)
+{
+        uint64_t latency = metrics_clock() - start;
+        uint32_t peak    = vm->sp + 1;                          // The final depth, an empty stack wraps to 0
+        peak = (vm->peak > peak) ? vm->peak : peak;
+
+        metrics_count(vm->metrics, vm, latency, peak);
+        metrics_shard_t *shard = metrics_shard();
+        if (shard)
+        {
+                metrics_count(&shard->counters, vm, latency, peak);
+        }
+        return;
+}
+
+void metrics_collect(metrics_t *total)
+{
+        memset(total, 0, sizeof(*total));
+        uint64_t peak = 0;
+        pthread_mutex_lock(&metrics_lock);
+        for (const metrics_shard_t *shard = metrics_shards; shard; shard = shard->next)
+        {
+                const uint64_t *counters = (const uint64_t *)&shard->counters; // metrics_t only holds 64-bit counters
+                uint64_t *sums           = (uint64_t *)total;
+                for (size_t i = 0; i < sizeof(metrics_t) / sizeof(uint64_t); i++)
+                {
+                        sums[i] += __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+                }
+                uint64_t depth = __atomic_load_n(&shard->counters.peak_depth, __ATOMIC_RELAXED);
+                peak = (depth > peak) ? depth : peak;
+        }
+        pthread_mutex_unlock(&metrics_lock);
+        total->peak_depth = peak;                               // The deepest of the shards, not their sum
+        return;
+}
+
+int metrics_write(FILE *out, const metrics_t *metrics)
+{
+        fprintf(out, "# HELP stackvm_runs_total Runs of the StackVM contexts.\n");
+        fprintf(out, "# TYPE stackvm_runs_total counter\n");
+        fprintf(out, "stackvm_runs_total %llu\n", (unsigned long long)metrics->runs);
+        fprintf(out, "# HELP stackvm_instructions_retired_total Instructions retired by the runs.\n");
+        fprintf(out, "# TYPE stackvm_instructions_retired_total counter\n");
+        fprintf(out, "stackvm_instructions_retired_total %llu\n", (unsigned long long)metrics->instructions);
+        fprintf(out, "# HELP stackvm_halts_total Runs that halted, by reason.\n");
+        fprintf(out, "# TYPE stackvm_halts_total counter\n");
+        for (uint32_t i = 0; i < ERROR_COUNT; i++)
+        {
+                fprintf(out, "stackvm_halts_total{reason=\"%s\"} %llu\n", metrics_reasons[i],
+                        (unsigned long long)metrics->halts[i]);
+        }
+        fprintf(out, "# HELP stackvm_pauses_total Runs that paused on their budget or a channel.\n");
+        fprintf(out, "# TYPE stackvm_pauses_total counter\n");
+        fprintf(out, "stackvm_pauses_total %llu\n", (unsigned long long)metrics->pauses);
+        fprintf(out, "# HELP stackvm_peak_stack_depth Deepest operand stack of any run in cells.\n");
+        fprintf(out, "# TYPE stackvm_peak_stack_depth gauge\n");
+        fprintf(out, "stackvm_peak_stack_depth %llu\n", (unsigned long long)metrics->peak_depth);
+        fprintf(out, "# HELP stackvm_run_latency_seconds Latency of the runs.\n");
+        fprintf(out, "# TYPE stackvm_run_latency_seconds histogram\n");
+        uint64_t runs = 0;
+        for (uint32_t i = 0; i < METRICS_BUCKETS; i++)
+        {
+                runs += metrics->latency[i];                    // Prometheus buckets are cumulative
+                if (i + 1 < METRICS_BUCKETS)
+                {
+                        fprintf(out, "stackvm_run_latency_seconds_bucket{le=\"%.9g\"} %llu\n",
+                                (double)((uint64_t)METRICS_FIRST_BUCKET << i) * 1e-9, (unsigned long long)runs);
+                }
+                else
+                {
+                        fprintf(out, "stackvm_run_latency_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)runs);
+                }
+        }
+        fprintf(out, "stackvm_run_latency_seconds_sum %.9f\n", (double)metrics->latency_sum * 1e-9);
+        fprintf(out, "stackvm_run_latency_seconds_count %llu\n", (unsigned long long)runs);
+        return ferror(out) ? -1 : 0;
+}
+
+int metrics_save(const char *path)
+{
+        size_t length = strlen(path);
+        char *temporary = malloc(length + sizeof(".tmp"));
+        if (!temporary)
+        {
+                return -1;
+        }
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+
+        metrics_t total;
+        metrics_collect(&total);
+        FILE *out = fopen(temporary, "w");
+        int status = out ? metrics_write(out, &total) : -1;
+        if (out && fclose(out) != 0)
+        {
+                status = -1;
+        }
+        if (status == 0 && rename(temporary, path) != 0)
+        {
+                status = -1;                                    // Scrapers only ever see a complete file
+        }
+        if (status != 0)
+        {
+                fprintf(stderr, "Error: Failed to write the metrics to %s\n", path);
+                remove(temporary);
+        }
+        free(temporary);
+        return status;
+}
+
+int metrics_send(const char *path)
+{
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        if (strlen(path) >= sizeof(address.sun_path))
+        {
+                fprintf(stderr, "Error: Socket path too long: %s\n", path);
+                return -1;
+        }
+        strcpy(address.sun_path, path);
+
+        char *text    = NULL;
+        size_t length = 0;
+        FILE *out     = open_memstream(&text, &length);
+        if (!out)
+        {
+                return -1;
+        }
+        metrics_t total;
+        metrics_collect(&total);
+        int status = metrics_write(out, &total);
+        if (fclose(out) != 0 || status != 0)
+        {
+                free(text);
+                return -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (const struct sockaddr *)&address, sizeof(address)) != 0)
+        {
+                status = -1;
+        }
+        for (size_t sent = 0; status == 0 && sent < length; )
+        {
+                ssize_t count = send(fd, text + sent, length - sent, MSG_NOSIGNAL); // A closed peer must not raise SIGPIPE
+                if (count < 0)
+                {
+                        status = -1;
+                        break;
+                }
+                sent += (size_t)count;
+        }
+        if (status != 0)
+        {
+                fprintf(stderr, "Error: Failed to send the metrics to %s\n", path);
+        }
+        if (fd >= 0)
+        {
+                close(fd);
+        }
+        free(text);
+        return status;
+}
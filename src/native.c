@@ -0,0 +1,63 @@
+/***
+ *
+ * @file: native.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the registry of native functions called by the CALL_NATIVE instruction
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <pthread.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "native.h"
+
+native_t native_table[NATIVE_MAX];
+uint32_t native_registered;
+
+static pthread_mutex_t native_lock = PTHREAD_MUTEX_INITIALIZER; // Serializes the registrations
+
+int native_register(const char *name, uint8_t arity, uint8_t results, native_fn_t fn, void *data)
+{
+        if (!name || !*name || !fn)
+        {
+                fprintf(stderr, "Error: Invalid native function\n");
+                return -1;
+        }
+
+        pthread_mutex_lock(&native_lock);
+        uint32_t index = native_registered;
+        if (native_find(name) >= 0 || index >= NATIVE_MAX)
+        {
+                pthread_mutex_unlock(&native_lock);
+                fprintf(stderr, "Error: Failed to register native function '%s'\n", name);
+                return -1;
+        }
+        char *copy = strdup(name);
+        if (!copy)
+        {
+                pthread_mutex_unlock(&native_lock);
+                return -1;
+        }
+        native_table[index] = (native_t){ .fn = fn, .data = data, .arity = arity, .results = results, .name = copy };
+        __atomic_store_n(&native_registered, index + 1, __ATOMIC_RELEASE); // Readers see the whole entry
+        pthread_mutex_unlock(&native_lock);
+        return (int)index;
+}
+
+int native_find(const char *name)
+{
+        uint32_t count = native_count();
+        for (uint32_t i = 0; i < count; i++)
+        {
+                if (strcmp(native_table[i].name, name) == 0)
+                {
+                        return (int)i;
+                }
+        }
+        return -1;
+}
@@ -0,0 +1,401 @@
+/***
+ *
+ * @file: optimize.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the peephole optimizer of the threaded code
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "threaded.h"
+#include "optimize.h"
+
+/**
+ * Superinstruction of `push imm; OP` for every binary instruction, 0 if the pair is not fused
+ */
+static const uint32_t push_fused[PRIMITIVE_COUNT] =
+{
+        [ADD] = THREAD_PUSH_ADD,
+        [SUB] = THREAD_PUSH_SUB,
+        [MUL] = THREAD_PUSH_MUL,
+        [DIV] = THREAD_PUSH_DIV,
+        [AND] = THREAD_PUSH_AND,
+        [OR]  = THREAD_PUSH_OR,
+        [XOR] = THREAD_PUSH_XOR,
+        [LT]  = THREAD_PUSH_LT,
+        [GT]  = THREAD_PUSH_GT,
+        [LE]  = THREAD_PUSH_LE,
+        [GE]  = THREAD_PUSH_GE,
+        [EQ]  = THREAD_PUSH_EQ,
+        [NE]  = THREAD_PUSH_NE,
+        [CMP] = THREAD_PUSH_CMP,
+};
+
+/**
+ * Superinstructions of a comparison followed by `BRF` and by `BRT`
+ */
+static const uint32_t branch_fused[PRIMITIVE_COUNT][2] =
+{
+        [LT] = { THREAD_LT_BRF, THREAD_LT_BRT },
+        [GT] = { THREAD_GT_BRF, THREAD_GT_BRT },
+        [LE] = { THREAD_LE_BRF, THREAD_LE_BRT },
+        [GE] = { THREAD_GE_BRF, THREAD_GE_BRT },
+        [EQ] = { THREAD_EQ_BRF, THREAD_EQ_BRT },
+        [NE] = { THREAD_NE_BRF, THREAD_NE_BRT },
+};
+
+/**
+ * @brief Evaluates a binary instruction on two constants
+ * @param opcode Binary instruction
+ * @param nos Next on stack
+ * @param tos Top of stack
+ * @param result Receives the result
+ * @return true if the instruction was evaluated, false if it must run (division by zero)
+ *         or its result does not fit the 32-bit operand of a threaded push
+ */
+static bool fold(uint32_t opcode, cell_t nos, cell_t tos, cell_t *result)
+{
+        switch (opcode)
+        {
+        case ADD: *result = cell_add(nos, tos);         break;
+        case SUB: *result = cell_sub(nos, tos);         break;
+        case MUL: *result = cell_mul(nos, tos);         break;
+        case DIV: if (!tos) return false;
+                  *result = cell_div(nos, tos);         break;
+        case AND: *result = nos & tos;                  break;
+        case OR:  *result = nos | tos;                  break;
+        case XOR: *result = nos ^ tos;                  break;
+        case LT:  *result = nos < tos;                  break;
+        case GT:  *result = nos > tos;                  break;
+        case LE:  *result = nos <= tos;                 break;
+        case GE:  *result = nos >= tos;                 break;
+        case EQ:  *result = nos == tos;                 break;
+        case NE:  *result = nos != tos;                 break;
+        default:                                        return false;
+        }
+        return *result >= INT32_MIN && *result <= INT32_MAX;
+}
+
+/**
+ * @brief Raises the depth an entry reaches above its stack
+ * @param rise Depth of every entry above the stack it is dispatched with
+ * @param entry Index of the entry
+ * @param depth Depth one of its replaced instructions starts with
+ * @return void
+ */
+static void lift(uint16_t *rise, uint32_t entry, uint32_t depth)
+{
+        rise[entry] = (depth > rise[entry]) ? (uint16_t)depth : rise[entry];
+        return;
+}
+
+/**
+ * @brief Tells whether the operand of a threaded code entry is a branch target
+ * @param opcode Handler index of the entry
+ * @return true for branches and compare-and-branch superinstructions
+ */
+static bool has_target(uint32_t opcode)
+{
+        return (opcode < PRIMITIVE_COUNT && stackvm_opcode_info(opcode)->target) ||
+               (opcode >= THREAD_LT_BRF && opcode <= THREAD_NE_BRT);
+}
+
+bool flags_dead(const uint32_t *code, uint32_t size, uint32_t pc)
+{
+        for (uint32_t next = pc + 1; next < size; next++)
+        {
+                uint32_t instruction = code[next];
+                if (GET_TYPE(instruction) == POSITIVE_INTEGER || GET_TYPE(instruction) == NEGATIVE_INTEGER)
+                {
+                        continue;
+                }
+                if (GET_TYPE(instruction) != PRIMITIVE_INSTRUCTION)
+                {
+                        return false;
+                }
+                switch (GET_DATA(instruction))
+                {
+                case AND: case OR: case XOR: case NOT:
+                        break;                                  // Leaves the flags alone
+                case LIT:
+                        next += 2;                              // Skip the operand words
+                        break;
+                case LOAD_LOCAL: case STORE_LOCAL:
+                        next += 1;                              // Leaves the flags alone, skip the slot word
+                        break;
+                case ADD: case SUB: case MUL: case CMP:
+                case LT: case GT: case LE: case GE: case EQ: case NE:
+                        return true;                            // Overwrites the flags, DIV may fault first
+                default:
+                        return false;                           // Reads the flags, leaves the block or halts
+                }
+        }
+        return false;
+}
+
+struct thread_cache *thread_optimize(const program_t *program, uint32_t *removed)
+{
+        if (!program->verified)
+        {
+                return NULL; // Rewriting relies on the instruction boundaries and targets checked by the verifier
+        }
+
+        uint32_t size       = program->size;
+        const uint32_t *in  = program->code;
+        bool *leader        = calloc(size, sizeof(bool));                       // Instruction is a branch target
+        uint32_t *map       = malloc(size * sizeof(uint32_t));                  // Entry of every program address
+        uint32_t *origin    = malloc(((size_t)size + 1) * sizeof(uint32_t));    // Program address of every entry
+        uint16_t *rise      = calloc((size_t)size + 1, sizeof(uint16_t));       // Depth of every entry above its stack
+        struct thread_cache *cache = malloc(sizeof(*cache) + ((size_t)size + 1) * sizeof(thread_t));
+        if (!leader || !map || !origin || !rise || !cache)
+        {
+                free(leader);
+                free(map);
+                free(origin);
+                free(rise);
+                free(cache);
+                return NULL;
+        }
+
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                uint32_t instruction = in[pc];
+                const opcode_info_t *info = stackvm_opcode_info(GET_DATA(instruction));
+                if (GET_TYPE(instruction) != PRIMITIVE_INSTRUCTION || !info)
+                {
+                        continue;
+                }
+                if (info->target && pc + 1 < size && in[pc + 1] < size)
+                {
+                        leader[in[pc + 1]] = true;      // Unreachable branches were not verified, their targets may be anything
+                }
+                if (GET_DATA(instruction) == CALL && pc + 2 < size)
+                {
+                        leader[pc + 2] = true;          // RET enters after the target word
+                }
+                pc += info->operands;                   // Skip the operand words
+        }
+
+        thread_t *out        = cache->code;
+        uint32_t n           = 0;               // Number of entries emitted
+        uint32_t barrier     = 0;               // First entry that may be combined with the next instruction
+        uint32_t placeholder = 0;               // Target word entries, they are never dispatched
+        uint32_t original    = 0;               // Instructions of the program
+        uint32_t carry       = 0;               // Weight of removed instructions, retired by the entry at `carried`
+        uint32_t carried     = 0;
+        uint32_t lifted      = 0;               // Depth the removed instructions reach above the entry at `carried`
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                if (carry && n > carried)
+                {
+                        out[carried].weight += carry;   // The entry emitted after a branch never taken
+                        lift(rise, carried, lifted);
+                        carry = 0;
+                }
+                if (leader[pc])
+                {
+                        barrier = n; // Control can enter here, never combine with what came before
+                }
+                map[pc] = n;
+                original++;
+                if (pc + 1 < size)
+                {
+                        map[pc + 1] = n; // Target word, only ever the target of unreachable branches
+                }
+
+                uint32_t instruction = in[pc];
+                uint32_t data        = GET_DATA(instruction);
+                // Combined entries add up their weights, which the bound keeps within 16 bits
+                thread_t *last       = (n > barrier && out[n - 1].opcode == THREAD_PUSH && out[n - 1].weight < THREAD_WEIGHT_MAX) ? &out[n - 1] : NULL;
+                thread_t *prev       = (last && n - 1 > barrier && out[n - 2].opcode == THREAD_PUSH && out[n - 2].weight < THREAD_WEIGHT_MAX) ? &out[n - 2] : NULL;
+                const opcode_info_t *info = stackvm_opcode_info(data);
+                if (GET_TYPE(instruction) == POSITIVE_INTEGER || GET_TYPE(instruction) == NEGATIVE_INTEGER)
+                {
+                        out[n] = (thread_t){ .weight = 1, .opcode = THREAD_PUSH, .operand = (uint32_t)GET_IMMEDIATE(instruction) };
+                        origin[n++] = pc;
+                        continue;
+                }
+                if (GET_TYPE(instruction) != PRIMITIVE_INSTRUCTION || !info)
+                {
+                        // Only in unreachable code, the verifier rejects reachable undefined instructions
+                        uint32_t undefined = (GET_TYPE(instruction) != PRIMITIVE_INSTRUCTION) ? THREAD_UNDEFINED_INSTRUCTION : THREAD_UNDEFINED_PRIMITIVE;
+                        out[n] = (thread_t){ .weight = 1, .opcode = undefined };
+                        origin[n++] = pc;
+                        continue;
+                }
+                cell_t result;
+                if (data == LIT)
+                {
+                        if (pc + 2 >= size)
+                        {
+                                out[n] = (thread_t){ .weight = 1, .opcode = THREAD_END };    // Unreachable LIT without its operand words
+                                origin[n++] = pc;
+                                pc = size;
+                                continue;
+                        }
+                        map[pc + 2] = n;
+                        result = GET_WIDE(in[pc + 1], in[pc + 2]);
+                        if (result >= INT32_MIN && result <= INT32_MAX)
+                        {
+                                // Narrow enough for a plain push, which the following instructions can fold into
+                                out[n] = (thread_t){ .weight = 1, .opcode = THREAD_PUSH, .operand = (uint32_t)result };
+                                origin[n++] = pc;
+                                pc += 2;
+                                continue;
+                        }
+                        out[n] = (thread_t){ .weight = 1, .opcode = LIT, .operand = pc + 1 };
+                        origin[n++] = pc;
+                        for (int i = 1; i <= 2; i++)
+                        {
+                                out[n] = (thread_t){ .weight = 1, .opcode = THREAD_END };    // Operand word, skipped by the LIT handler
+                                origin[n++] = pc + i;
+                                placeholder++;
+                        }
+                        pc += 2;
+                        continue;
+                }
+                if (data == NOT && last)
+                {
+                        last->operand = ~last->operand;                 // push a; NOT
+                        last->weight++;
+                        lift(rise, n - 1, 1);
+                        continue;
+                }
+                if (info->pops == 2 && info->pushes == 1)
+                {
+                        bool flagless = (data == AND || data == OR || data == XOR || flags_dead(in, size, pc));
+                        if (prev && flagless && fold(data, (int32_t)prev->operand, (int32_t)last->operand, &result))
+                        {
+                                prev->operand = (uint32_t)result;       // push a; push b; OP
+                                prev->weight += last->weight + 1;
+                                lift(rise, n - 2, 1 + rise[n - 1]);     // b starts one cell above a
+                                lift(rise, n - 2, 2);
+                                rise[--n] = 0;
+                                continue;
+                        }
+                        if (last && !(data == DIV && last->operand == 0))
+                        {
+                                last->opcode = push_fused[data];        // push imm; OP
+                                last->weight++;
+                                lift(rise, n - 1, 1);
+                                continue;
+                        }
+                }
+                if (data == CMP && last)
+                {
+                        last->opcode = THREAD_PUSH_CMP;                 // push imm; CMP
+                        last->weight++;
+                        lift(rise, n - 1, 1);
+                        continue;
+                }
+                if (pc + info->operands >= size)
+                {
+                        out[n] = (thread_t){ .weight = 1, .opcode = THREAD_END };    // Unreachable instruction without its operand word
+                        origin[n++] = pc;
+                        continue;
+                }
+                if (data == BRT || data == BRF)
+                {
+                        uint32_t target = in[++pc];
+                        if (last)
+                        {
+                                // push c; BRT/BRF is an unconditional branch or nothing at all
+                                if ((last->operand != 0) == (data == BRT))
+                                {
+                                        last->opcode  = BR;
+                                        last->operand = target;
+                                        last->weight++;
+                                        lift(rise, n - 1, 1);
+                                }
+                                else if (pc + 1 < size && !leader[pc + 1])
+                                {
+                                        carry   = last->weight + 1;     // Retired by the instruction that follows
+                                        lifted  = (rise[n - 1] > 1) ? rise[n - 1] : 1;
+                                        rise[n - 1] = 0;
+                                        carried = --n;
+                                }
+                                else
+                                {
+                                        last->opcode  = BR;             // Nothing may retire the pair, branch to the next instruction
+                                        last->operand = pc + 1;
+                                        last->weight++;
+                                        lift(rise, n - 1, 1);
+                                }
+                                barrier = n;
+                                continue;
+                        }
+                        thread_t *compare = (n > barrier) ? &out[n - 1] : NULL;
+                        if (compare && compare->opcode < PRIMITIVE_COUNT && branch_fused[compare->opcode][data == BRT])
+                        {
+                                compare->opcode  = branch_fused[compare->opcode][data == BRT];  // compare; BRT/BRF
+                                compare->operand = target;
+                                compare->weight++;
+                        }
+                        else
+                        {
+                                out[n] = (thread_t){ .weight = 1, .opcode = data, .operand = target };
+                                origin[n++] = pc - 1;
+                        }
+                        out[n] = (thread_t){ .weight = 1, .opcode = THREAD_END };    // Target word, skipped when the branch is not taken
+                        origin[n++] = pc;
+                        placeholder++;
+                        barrier = n;
+                        continue;
+                }
+                if (info->operands == 1 && data != BR)
+                {
+                        out[n] = (thread_t){ .weight = 1, .opcode = data, .operand = in[++pc] }; // Flag branch, CALL or local slot
+                        origin[n++] = pc - 1;
+                        out[n] = (thread_t){ .weight = 1, .opcode = THREAD_END };    // Operand word, skipped by the handler
+                        origin[n++] = pc;
+                        placeholder++;
+                        barrier = info->target ? n : barrier;
+                        continue;
+                }
+                if (data == BR)
+                {
+                        out[n] = (thread_t){ .weight = 1, .opcode = BR, .operand = in[++pc] };
+                        origin[n++] = pc - 1;
+                        barrier = n;
+                        continue;
+                }
+                out[n] = (thread_t){ .weight = 1, .opcode = data };
+                origin[n++] = pc;
+        }
+
+        if (carry && n > carried)
+        {
+                out[carried].weight += carry;
+                lift(rise, carried, lifted);
+        }
+
+        const void *const *handlers = thread_handlers(false);
+        for (uint32_t i = 0; i < n; i++)
+        {
+                if (has_target(out[i].opcode))
+                {
+                        // Remap the branch target to the rewritten code, targets outside the program leave it
+                        out[i].operand = (out[i].operand < size) ? map[out[i].operand] : n;
+                }
+                out[i].handler = handlers[out[i].opcode];
+        }
+        out[n]    = (thread_t){ .handler = handlers[THREAD_END], .opcode = THREAD_END, .weight = 1 };
+        origin[n] = size;
+
+        cache->size    = n;
+        cache->traced  = false;
+        cache->checked = false;
+        cache->origin  = origin;
+        cache->rise    = rise;
+        cache->source  = NULL;
+        *removed       = original - (n - placeholder);
+        free(leader);
+        free(map);
+        return cache;
+}
@@ -0,0 +1,496 @@
+/***
+ *
+ * @file: pool.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the work-stealing job scheduler of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _DEFAULT_SOURCE // sysconf, clock_gettime
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "batch.h"
+#include "pool.h"
+
+#define POOL_CACHE_LINE         64              // Keeps the ends of a deque and the statistics apart
+#define POOL_EMPTY              ((pool_job_t *)NULL)
+
+/**
+ * @brief Worker thread of the scheduler
+ * @note The deque is a Chase-Lev work-stealing deque over a fixed ring: the owner pushes and takes
+ *       at `bottom`, thieves take at `top` with a compare-and-swap. The owner only pushes what fits,
+ *       the rest stays in the submission queue, so the ring never grows.
+ */
+typedef struct pool_worker
+{
+        struct pool *pool;                                      // Owning scheduler
+        uint32_t index;                                         // Index of the worker
+        uint64_t seed;                                          // State of the victim generator
+        pthread_t thread;                                       // Worker thread
+        stackvm_t *vm;                                          // Context reused by every job of the worker
+        alignas(POOL_CACHE_LINE) int64_t top;                   // Steal end of the deque
+        alignas(POOL_CACHE_LINE) int64_t bottom;                // Owner end of the deque
+        pool_job_t *jobs[POOL_DEQUE_SIZE];                      // Ring of the deque
+        alignas(POOL_CACHE_LINE) pool_stats_t stats;            // Written by the worker only
+} pool_worker_t;
+
+struct pool
+{
+        pool_worker_t *workers;                                 // Worker threads
+        uint32_t count;                                         // Number of workers
+        pthread_mutex_t lock;                                   // Guards the submission queue and the sleeps
+        pthread_cond_t work;                                    // Signalled when jobs are submitted or the pool stops
+        pthread_cond_t finished;                                // Signalled when jobs finish and someone waits
+        pool_job_t *head;                                       // Submission queue, oldest job first
+        pool_job_t *tail;                                       // Last submitted job
+        size_t queued;                                          // Jobs in the submission queue
+        size_t available;                                       // Jobs submitted and not picked up by a worker yet
+        size_t outstanding;                                     // Jobs submitted and not finished yet
+        uint32_t sleepers;                                      // Workers waiting for work
+        uint32_t waiters;                                       // Threads waiting for jobs to finish
+        bool stop;                                              // Workers exit once the pool is drained
+};
+
+/**
+ * @brief Returns the monotonic time in nanoseconds
+ * @return Nanoseconds since an arbitrary point
+ */
+static uint64_t pool_now(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Adds to a statistics counter
+ * @param counter Counter written by its worker only
+ * @param value Amount to add
+ * @return void
+ * @note A relaxed atomic store, so `pool_stats` may read it from another thread at any time.
+ */
+static inline void pool_count(uint64_t *counter, uint64_t value)
+{
+        __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Pushes a job at the owner end of a deque
+ * @param worker Owner of the deque
+ * @param job Job to push
+ * @return void
+ * @note Only the owner pushes, and only after checking there is room.
+ */
+static void deque_push(pool_worker_t *worker, pool_job_t *job)
+{
+        int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+        __atomic_store_n(&worker->jobs[bottom & (POOL_DEQUE_SIZE - 1)], job, __ATOMIC_RELAXED);
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+        return;
+}
+
+/**
+ * @brief Takes the newest job at the owner end of a deque
+ * @param worker Owner of the deque
+ * @return Job, POOL_EMPTY if the deque is empty
+ */
+static pool_job_t *deque_take(pool_worker_t *worker)
+{
+        int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+        __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+        if (top > bottom)
+        {
+                __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED); // Empty
+                return POOL_EMPTY;
+        }
+
+        pool_job_t *job = __atomic_load_n(&worker->jobs[bottom & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+        if (top == bottom)
+        {
+                // Last job, race the thieves for it
+                if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                {
+                        job = POOL_EMPTY;
+                }
+                __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+        return job;
+}
+
+/**
+ * @brief Steals the oldest job at the steal end of a deque
+ * @param victim Owner of the deque
+ * @return Job, POOL_EMPTY if the deque is empty or another thread won the job
+ */
+static pool_job_t *deque_steal(pool_worker_t *victim)
+{
+        int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+        if (top >= bottom)
+        {
+                return POOL_EMPTY;
+        }
+        pool_job_t *job = __atomic_load_n(&victim->jobs[top & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+                return POOL_EMPTY;
+        }
+        return job;
+}
+
+/**
+ * @brief Moves a share of the submission queue into the deque of a worker
+ * @param worker Worker with an empty deque
+ * @return true if jobs were moved
+ * @note Each refill takes the queue divided by the number of workers, so a large submission
+ *       is spread over every worker without the workers coming back for each job.
+ */
+static bool pool_refill(pool_worker_t *worker)
+{
+        pool_t *pool = worker->pool;
+        if (!__atomic_load_n(&pool->queued, __ATOMIC_RELAXED))
+        {
+                return false;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        size_t share = (pool->queued + pool->count - 1) / pool->count;
+        share = (share < POOL_DEQUE_SIZE) ? share : POOL_DEQUE_SIZE;
+        for (size_t i = 0; i < share; i++)
+        {
+                pool_job_t *job = pool->head;
+                pool->head = job->next;
+                deque_push(worker, job);
+        }
+        if (!pool->head)
+        {
+                pool->tail = NULL;
+        }
+        __atomic_store_n(&pool->queued, pool->queued - share, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (share)
+        {
+                pool_count(&worker->stats.refills, 1);
+        }
+        return share != 0;
+}
+
+/**
+ * @brief Finds the next job of a worker
+ * @param worker Pointer to the worker
+ * @return Job, POOL_EMPTY if there is none and the pool stops
+ * @note Tries the own deque, then the submission queue, then the other deques from a random victim on,
+ *       and sleeps when no job is left anywhere.
+ */
+static pool_job_t *pool_next(pool_worker_t *worker)
+{
+        pool_t *pool = worker->pool;
+        for (;;)
+        {
+                pool_job_t *job = deque_take(worker);
+                if (!job && pool_refill(worker))
+                {
+                        job = deque_take(worker);
+                }
+                for (uint32_t i = 0; !job && i < pool->count; i++)
+                {
+                        worker->seed = worker->seed * 6364136223846793005u + 1442695040888963407u;
+                        pool_worker_t *victim = &pool->workers[(uint32_t)(worker->seed >> 33) % pool->count];
+                        if (victim != worker && (job = deque_steal(victim)))
+                        {
+                                pool_count(&worker->stats.stolen, 1);
+                        }
+                }
+                if (job)
+                {
+                        __atomic_fetch_sub(&pool->available, 1, __ATOMIC_RELAXED);
+                        return job;
+                }
+
+                if (__atomic_load_n(&pool->available, __ATOMIC_RELAXED))
+                {
+                        sched_yield(); // A job is on its way between the queue and a deque
+                        continue;
+                }
+                pthread_mutex_lock(&pool->lock);
+                bool parked = false;
+                pool->sleepers++;
+                while (!__atomic_load_n(&pool->available, __ATOMIC_RELAXED) && !pool->stop)
+                {
+                        parked = true;
+                        pthread_cond_wait(&pool->work, &pool->lock);
+                }
+                pool->sleepers--;
+                bool stop = pool->stop && !__atomic_load_n(&pool->available, __ATOMIC_RELAXED);
+                pthread_mutex_unlock(&pool->lock);
+                if (parked)
+                {
+                        pool_count(&worker->stats.parks, 1);
+                }
+                if (stop)
+                {
+                        return POOL_EMPTY;
+                }
+        }
+}
+
+/**
+ * @brief Runs one job on the context of a worker
+ * @param worker Pointer to the worker
+ * @param job Pointer to the job
+ * @return void
+ */
+static void pool_run(pool_worker_t *worker, pool_job_t *job)
+{
+        stackvm_t *vm = worker->vm;
+        job->worker   = worker->index;
+        job->done     = 0;
+        if (!job->program)
+        {
+                job->error = ERROR_NO_PROGRAM;
+        }
+        else if (job->arity > vm->stack_size)
+        {
+                job->error = ERROR_STACK_OVERFLOW; // The input tuples do not fit the stack
+        }
+        else
+        {
+                attach_program(vm, job->program);
+                job->done  = stackvm_run_batch(vm, job->inputs, job->arity, job->count, job->results);
+                job->error = (job->done < job->count) ? vm->error : ERROR_NONE;
+        }
+        pool_count(&worker->stats.tuples, job->done);
+        pool_count(&worker->stats.jobs, 1);
+        return;
+}
+
+/**
+ * @brief Entry point of a worker thread
+ * @param argument Pointer to the worker
+ * @return NULL
+ */
+static void *pool_main(void *argument)
+{
+        pool_worker_t *worker = (pool_worker_t *)argument;
+        pool_t *pool          = worker->pool;
+        pool_job_t *job;
+        while ((job = pool_next(worker)))
+        {
+                uint64_t start = pool_now();
+                pool_run(worker, job);
+                pool_count(&worker->stats.busy_ns, pool_now() - start);
+
+                __atomic_store_n(&job->finished, 1, __ATOMIC_SEQ_CST);
+                if (__atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST) == 0 || __atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST))
+                {
+                        pthread_mutex_lock(&pool->lock);
+                        pthread_cond_broadcast(&pool->finished); // Wake the threads in pool_await and pool_wait
+                        pthread_mutex_unlock(&pool->lock);
+                }
+        }
+        return NULL;
+}
+
+pool_t *pool_create(const pool_config_t *config)
+{
+        pool_config_t defaults = { 0 };
+        config = config ? config : &defaults;
+        long cpus      = sysconf(_SC_NPROCESSORS_ONLN);
+        uint32_t count = config->workers ? config->workers : (cpus > 0) ? (uint32_t)cpus : 1;
+        count          = (count < POOL_MAX_WORKERS) ? count : POOL_MAX_WORKERS;
+
+        pool_t *pool = (pool_t *)calloc(1, sizeof(pool_t));
+        if (!pool)
+        {
+                return NULL;
+        }
+        pool->workers = (pool_worker_t *)aligned_alloc(POOL_CACHE_LINE, count * sizeof(pool_worker_t));
+        if (!pool->workers)
+        {
+                free(pool);
+                return NULL;
+        }
+        memset(pool->workers, 0, count * sizeof(pool_worker_t));
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->work, NULL);
+        pthread_cond_init(&pool->finished, NULL);
+
+        // Contexts are allocated up front, a failure leaves no thread running
+        for (uint32_t i = 0; i < count; i++)
+        {
+                pool_worker_t *worker = &pool->workers[i];
+                worker->pool  = pool;
+                worker->index = i;
+                worker->seed  = 0x9e3779b97f4a7c15u * (i + 1);
+                worker->vm    = stackvm_create(&config->vm);
+                if (worker->vm && config->metrics && stackvm_metrics(worker->vm, true) != 0)
+                {
+                        stackvm_free(worker->vm);
+                        worker->vm = NULL;
+                }
+                if (!worker->vm)
+                {
+                        for (uint32_t j = 0; j < i; j++)
+                        {
+                                stackvm_free(pool->workers[j].vm);
+                        }
+                        free(pool->workers);
+                        free(pool);
+                        return NULL;
+                }
+                stackvm_set_engine(worker->vm, config->engine);
+        }
+        pool->count = count;                                    // Read by the workers, set before any starts
+        for (uint32_t i = 0; i < count; i++)
+        {
+                if (pthread_create(&pool->workers[i].thread, NULL, pool_main, &pool->workers[i]) != 0)
+                {
+                        pthread_mutex_lock(&pool->lock);
+                        pool->stop = true;                      // Nothing was submitted, the started workers exit at once
+                        pthread_cond_broadcast(&pool->work);
+                        pthread_mutex_unlock(&pool->lock);
+                        for (uint32_t j = 0; j < count; j++)
+                        {
+                                if (j < i)
+                                {
+                                        pthread_join(pool->workers[j].thread, NULL);
+                                }
+                                stackvm_free(pool->workers[j].vm);
+                        }
+                        pthread_mutex_destroy(&pool->lock);
+                        pthread_cond_destroy(&pool->work);
+                        pthread_cond_destroy(&pool->finished);
+                        free(pool->workers);
+                        free(pool);
+                        return NULL;
+                }
+        }
+        return pool;
+}
+
+void pool_free(pool_t *pool)
+{
+        if (!pool)
+        {
+                return;
+        }
+        pool_wait(pool);
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = true;
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+        for (uint32_t i = 0; i < pool->count; i++)
+        {
+                pthread_join(pool->workers[i].thread, NULL);
+                stackvm_free(pool->workers[i].vm);
+        }
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->work);
+        pthread_cond_destroy(&pool->finished);
+        free(pool->workers);
+        free(pool);
+        return;
+}
+
+void pool_submit(pool_t *pool, pool_job_t *jobs, size_t count)
+{
+        if (!count)
+        {
+                return;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+                jobs[i].finished = 0;
+                jobs[i].next     = (i + 1 < count) ? &jobs[i + 1] : NULL;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->tail)
+        {
+                pool->tail->next = &jobs[0];
+        }
+        else
+        {
+                pool->head = &jobs[0];
+        }
+        pool->tail = &jobs[count - 1];
+        __atomic_store_n(&pool->queued, pool->queued + count, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pool->outstanding, count, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&pool->available, count, __ATOMIC_RELAXED);
+        if (pool->sleepers)
+        {
+                if (count == 1)
+                {
+                        pthread_cond_signal(&pool->work);
+                }
+                else
+                {
+                        pthread_cond_broadcast(&pool->work);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return;
+}
+
+vm_error_t pool_await(pool_t *pool, pool_job_t *job)
+{
+        if (!__atomic_load_n(&job->finished, __ATOMIC_ACQUIRE))
+        {
+                pthread_mutex_lock(&pool->lock);
+                __atomic_fetch_add(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+                while (!__atomic_load_n(&job->finished, __ATOMIC_SEQ_CST))
+                {
+                        pthread_cond_wait(&pool->finished, &pool->lock);
+                }
+                __atomic_fetch_sub(&pool->waiters, 1, __ATOMIC_RELAXED);
+                pthread_mutex_unlock(&pool->lock);
+        }
+        return job->error;
+}
+
+void pool_wait(pool_t *pool)
+{
+        pthread_mutex_lock(&pool->lock);
+        while (__atomic_load_n(&pool->outstanding, __ATOMIC_SEQ_CST))
+        {
+                pthread_cond_wait(&pool->finished, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return;
+}
+
+uint32_t pool_workers(const pool_t *pool)
+{
+        return pool->count;
+}
+
+int pool_stats(const pool_t *pool, uint32_t worker, pool_stats_t *stats)
+{
+        if (worker >= pool->count || !stats)
+        {
+                return -1;
+        }
+        const pool_stats_t *counters = &pool->workers[worker].stats;
+        stats->jobs     = __atomic_load_n(&counters->jobs, __ATOMIC_RELAXED);
+        stats->tuples   = __atomic_load_n(&counters->tuples, __ATOMIC_RELAXED);
+        stats->stolen   = __atomic_load_n(&counters->stolen, __ATOMIC_RELAXED);
+        stats->refills  = __atomic_load_n(&counters->refills, __ATOMIC_RELAXED);
+        stats->parks    = __atomic_load_n(&counters->parks, __ATOMIC_RELAXED);
+        stats->busy_ns  = __atomic_load_n(&counters->busy_ns, __ATOMIC_RELAXED);
+        return 0;
+}
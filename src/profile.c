@@ -0,0 +1,207 @@
+/***
+ *
+ * @file: profile.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the implementation of the instruction-level profiler
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <inttypes.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "asm.h"
+#include "profile.h"
+
+#define PROFILE_PUSH            PRIMITIVE_COUNT         // Opcode slot of the push words
+#define PROFILE_UNDEFINED       (PRIMITIVE_COUNT + 1)   // Opcode slot of the undefined words
+#define PROFILE_OPCODES         (PRIMITIVE_COUNT + 2)   // Opcode slots of the flat profile
+
+/**
+ * @brief Returns the opcode slot of a program word
+ * @param instruction Program word
+ * @return Primitive opcode, PROFILE_PUSH or PROFILE_UNDEFINED
+ */
+static uint32_t profile_opcode(uint32_t instruction)
+{
+        switch (GET_TYPE(instruction))
+        {
+        case POSITIVE_INTEGER:
+        case NEGATIVE_INTEGER:
+                return PROFILE_PUSH;
+        case PRIMITIVE_INSTRUCTION:
+                return stackvm_opcode_info(GET_DATA(instruction)) ? GET_DATA(instruction) : PROFILE_UNDEFINED;
+        default:
+                return PROFILE_UNDEFINED;
+        }
+}
+
+profile_t *profile_open(const uint32_t *code, uint32_t size)
+{
+        profile_t *profile = (profile_t *)calloc(1, sizeof(profile_t));
+        if (!profile)
+        {
+                return NULL;
+        }
+        profile->size      = UINT32_MAX;                // Never matches, the first bind sets the counters up
+        profile->branch    = PROFILE_NONE;
+        profile->timed     = PROFILE_NONE;
+        profile->countdown = PROFILE_PERIOD;
+        profile->overhead  = UINT64_MAX;
+        for (int i = 0; i < 64; i++)
+        {
+                uint64_t start = profile_clock();
+                uint64_t ticks = profile_clock() - start;
+                profile->overhead = (ticks < profile->overhead) ? ticks : profile->overhead;
+        }
+        if (profile_bind(profile, code, size) != 0)
+        {
+                free(profile);
+                return NULL;
+        }
+        return profile;
+}
+
+void profile_close(profile_t *profile)
+{
+        if (!profile)
+        {
+                return;
+        }
+        free(profile->counters);
+        free(profile);
+        return;
+}
+
+int profile_bind(profile_t *profile, const uint32_t *code, uint32_t size)
+{
+        if (profile->code == code && profile->size == size)
+        {
+                return 0; // Same program, keep counting
+        }
+
+        profile_counter_t *counters = (profile_counter_t *)calloc(size ? size : 1, sizeof(profile_counter_t));
+        if (!counters)
+        {
+                return -1;
+        }
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                const opcode_info_t *info = (GET_TYPE(code[pc]) == PRIMITIVE_INSTRUCTION) ? stackvm_opcode_info(GET_DATA(code[pc])) : NULL;
+                bool branch = info && info->target && GET_DATA(code[pc]) != CALL;
+                counters[pc].target = (branch && pc + 1 < size) ? code[pc + 1] : PROFILE_NONE;
+        }
+        free(profile->counters);
+        profile->counters = counters;
+        profile->code     = code;
+        profile->size     = size;
+        profile->runs     = 0;
+        profile->branch   = PROFILE_NONE;
+        profile->timed    = PROFILE_NONE;
+        return 0;
+}
+
+void profile_end(profile_t *profile)
+{
+        if (profile->branch != PROFILE_NONE)
+        {
+                profile->counters[profile->branch].taken++; // Left the program through its target
+                profile->branch = PROFILE_NONE;
+        }
+        profile->timed = PROFILE_NONE;                  // The end of the run is not an instruction
+        profile->runs++;
+        return;
+}
+
+void profile_report(FILE *out, const profile_t *profile)
+{
+        uint64_t counts[PROFILE_OPCODES]  = { 0 };
+        uint64_t ticks[PROFILE_OPCODES]   = { 0 };
+        uint64_t samples[PROFILE_OPCODES] = { 0 };
+        uint32_t order[PROFILE_OPCODES];
+        uint64_t total = 0;
+        double estimate[PROFILE_OPCODES];
+        double time = 0.0;
+
+        for (uint32_t pc = 0; pc < profile->size; pc++)
+        {
+                const profile_counter_t *counter = &profile->counters[pc];
+                uint32_t opcode = profile_opcode(profile->code[pc]);
+                counts[opcode]  += counter->hits;
+                ticks[opcode]   += counter->ticks;
+                samples[opcode] += counter->samples;
+                total           += counter->hits;
+        }
+
+        // Order the opcodes by count, the opcodes never executed are left out
+        uint32_t used = 0;
+        for (uint32_t opcode = 0; opcode < PROFILE_OPCODES; opcode++)
+        {
+                estimate[opcode] = samples[opcode] ? (double)ticks[opcode] / (double)samples[opcode] * (double)counts[opcode] : 0.0;
+                time            += estimate[opcode];
+                if (!counts[opcode])
+                {
+                        continue;
+                }
+                uint32_t i = used++;
+                for (; i > 0 && counts[order[i - 1]] < counts[opcode]; i--)
+                {
+                        order[i] = order[i - 1];
+                }
+                order[i] = opcode;
+        }
+
+        fprintf(out, "Flat profile: %" PRIu64 " instructions in %" PRIu64 " runs, 1 in %u timed, ticks are " PROFILE_UNIT "\n",
+                total, profile->runs, PROFILE_PERIOD);
+        fprintf(out, "%14s %7s %10s %14s %7s  %s\n", "count", "%", "ticks/op", "ticks", "%time", "opcode");
+        for (uint32_t i = 0; i < used; i++)
+        {
+                uint32_t opcode  = order[i];
+                const char *name = (opcode == PROFILE_PUSH) ? "push" : (opcode == PROFILE_UNDEFINED) ? "undefined" : stackvm_opcode_name(opcode);
+                fprintf(out, "%14" PRIu64 " %6.2f%% %10.1f %14.0f %6.2f%%  %s\n", counts[opcode],
+                        100.0 * (double)counts[opcode] / (double)total,
+                        samples[opcode] ? (double)ticks[opcode] / (double)samples[opcode] : 0.0, estimate[opcode],
+                        (time > 0.0) ? 100.0 * estimate[opcode] / time : 0.0, name);
+        }
+        return;
+}
+
+void profile_annotate(FILE *out, const profile_t *profile)
+{
+        uint64_t total = 0;
+        for (uint32_t pc = 0; pc < profile->size; pc++)
+        {
+                total += profile->counters[pc].hits;
+        }
+
+        fprintf(out, "%14s %7s %10s %7s  %s\n", "hits", "%", "ticks", "taken", "address: instruction");
+        for (uint32_t pc = 0; pc < profile->size; )
+        {
+                const profile_counter_t *counter = &profile->counters[pc];
+                fprintf(out, "%14" PRIu64 " %6.2f%% ", counter->hits, total ? 100.0 * (double)counter->hits / (double)total : 0.0);
+                if (counter->samples)
+                {
+                        fprintf(out, "%10.1f ", (double)counter->ticks / (double)counter->samples);
+                }
+                else
+                {
+                        fprintf(out, "%10s ", "-");
+                }
+                if (counter->target != PROFILE_NONE && counter->hits)
+                {
+                        fprintf(out, "%6.1f%%  ", 100.0 * (double)counter->taken / (double)counter->hits);
+                }
+                else
+                {
+                        fprintf(out, "%7s  ", "");
+                }
+                fprintf(out, "%7u: ", pc);
+                pc += (uint32_t)asm_print(out, profile->code, profile->size, pc);
+                fputc('\n', out);
+        }
+        return;
+}
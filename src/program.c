@@ -0,0 +1,277 @@
+/***
+ *
+ * @file: program.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the implementation of the read-only program shared by StackVM contexts
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "threaded.h"
+#include "verify.h"
+#include "optimize.h"
+#include "jit.h"
+#include "vector.h"
+
+static uint32_t crc_table[256];         // CRC-32 lookup table, filled at startup
+
+/**
+ * @brief Fills the CRC-32 lookup table
+ * @return void
+ */
+__attribute__((constructor)) static void crc_init(void)
+{
+        for (uint32_t i = 0; i < 256; i++)
+        {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                        crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1; // Reflected IEEE polynomial
+                }
+                crc_table[i] = crc;
+        }
+        return;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size)
+{
+        const uint8_t *bytes = (const uint8_t *)data;
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+                crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+}
+
+/**
+ * @brief Allocates a program without a code segment
+ * @param size Number of instruction words
+ * @return Pointer to the program on success, NULL on failure
+ */
+static program_t *program_alloc(uint32_t size)
+{
+        program_t *program = (program_t *)malloc(sizeof(program_t));
+        if (!program)
+        {
+                return NULL;
+        }
+        program->code           = NULL;
+        program->size           = size;
+        program->constants      = NULL;
+        program->constants_size = 0;
+        program->mapping        = NULL;
+        program->mapped         = 0;
+        program->threaded       = NULL;
+        program->removed        = 0;
+        program->checked        = NULL;
+        program->jit            = NULL;
+        program->jit_counted    = NULL;
+        program->vector         = NULL;
+        program->verified       = false;
+        program->entry_depth    = 0;
+        program->max_depth      = 0;
+        program->max_frames     = 0;
+        program->verify_error   = NULL;
+        program->verify_pc      = 0;
+        return program;
+}
+
+/**
+ * @brief Verifies a program and translates it for the threaded engine
+ * @param program Pointer to the program with its code segment in place
+ * @return The program on success, NULL on failure, the program is freed then
+ */
+static program_t *program_prepare(program_t *program)
+{
+        // Translate once for every context that will run the program on the threaded engine
+        program->checked = thread_compile(program->code, program->size, false, true);
+        if (program_verify(program))
+        {
+#if STACKVM_OPTIMIZE
+                program->threaded = thread_optimize(program, &program->removed);
+#else
+                program->threaded = thread_compile(program->code, program->size, false, false);
+#endif
+        }
+        if (!program->checked || (program->verified && !program->threaded))
+        {
+                program_free(program);
+                return NULL;
+        }
+        return program;
+}
+
+program_t *program_create(const uint32_t *code, size_t size)
+{
+        if ((!code && size) || size >= UINT32_MAX)
+        {
+                return NULL; // Invalid program
+        }
+
+        program_t *program = program_alloc((uint32_t)size);
+        if (!program)
+        {
+                return NULL;
+        }
+
+        if (size)
+        {
+                size_t bytes = size * sizeof(uint32_t);
+                void *segment = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (segment == MAP_FAILED)
+                {
+                        free(program);
+                        return NULL;
+                }
+                memcpy(segment, code, bytes);
+                mprotect(segment, bytes, PROT_READ); // Code segment is read-only from now on
+                program->code    = (const uint32_t *)segment;
+                program->mapping = segment;
+                program->mapped  = bytes;
+        }
+        return program_prepare(program);
+}
+
+/**
+ * @brief Checks that a section lies inside the file
+ * @param offset Offset of the section in bytes
+ * @param words Size of the section in words
+ * @param file Size of the file in bytes
+ * @return true if the section is aligned and inside the file
+ */
+static bool section_valid(uint32_t offset, uint32_t words, size_t file)
+{
+        return (offset % sizeof(uint32_t)) == 0 &&
+               offset >= sizeof(program_header_t) &&
+               (uint64_t)offset + (uint64_t)words * sizeof(uint32_t) <= file;
+}
+
+program_t *program_open(const char *path)
+{
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+                fprintf(stderr, "Error: Failed to open program file '%s'\n", path);
+                return NULL;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(program_header_t))
+        {
+                fprintf(stderr, "Error: '%s' is not a StackVM program\n", path);
+                close(fd);
+                return NULL;
+        }
+        size_t file = (size_t)info.st_size;
+        void *mapping = mmap(NULL, file, PROT_READ, MAP_SHARED, fd, 0); // Page cache shared by every process
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+                fprintf(stderr, "Error: Failed to map program file '%s'\n", path);
+                return NULL;
+        }
+
+        const program_header_t *header = (const program_header_t *)mapping;
+        bool constants = header->constants_size != 0;
+        if (header->magic != PROGRAM_MAGIC || header->version != PROGRAM_VERSION ||
+            header->code_size == 0 || header->code_size == UINT32_MAX ||
+            !section_valid(header->code_offset, header->code_size, file) ||
+            (constants && !section_valid(header->constants_offset, header->constants_size, file)))
+        {
+                fprintf(stderr, "Error: '%s' is not a StackVM program of version %d\n", path, PROGRAM_VERSION);
+                munmap(mapping, file);
+                return NULL;
+        }
+
+        const uint8_t *bytes = (const uint8_t *)mapping;
+        uint32_t checksum = crc32_update(0, bytes + header->code_offset, header->code_size * sizeof(uint32_t));
+        if (constants)
+        {
+                checksum = crc32_update(checksum, bytes + header->constants_offset, header->constants_size * sizeof(uint32_t));
+        }
+        if (checksum != header->checksum)
+        {
+                fprintf(stderr, "Error: Checksum mismatch in program file '%s'\n", path);
+                munmap(mapping, file);
+                return NULL;
+        }
+
+        program_t *program = program_alloc(header->code_size);
+        if (!program)
+        {
+                munmap(mapping, file);
+                return NULL;
+        }
+        program->code           = (const uint32_t *)(bytes + header->code_offset);
+        program->constants      = constants ? (const uint32_t *)(bytes + header->constants_offset) : NULL;
+        program->constants_size = header->constants_size;
+        program->mapping        = mapping;
+        program->mapped         = file;
+        return program_prepare(program);
+}
+
+int program_save(const char *path, const uint32_t *code, size_t size, const uint32_t *constants, size_t count)
+{
+        if (!path || !code || size == 0 || size >= UINT32_MAX || (count && !constants) || count >= UINT32_MAX)
+        {
+                return -1;
+        }
+        program_header_t header =
+        {
+                .magic            = PROGRAM_MAGIC,
+                .version          = PROGRAM_VERSION,
+                .flags            = 0,
+                .code_offset      = sizeof(program_header_t),
+                .code_size        = (uint32_t)size,
+                .constants_offset = count ? (uint32_t)(sizeof(program_header_t) + size * sizeof(uint32_t)) : 0,
+                .constants_size   = (uint32_t)count,
+                .checksum         = crc32_update(0, code, size * sizeof(uint32_t)),
+                .reserved         = 0,
+        };
+        if (count)
+        {
+                header.checksum = crc32_update(header.checksum, constants, count * sizeof(uint32_t));
+        }
+
+        FILE *out = fopen(path, "wb");
+        if (!out)
+        {
+                return -1;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                       fwrite(code, sizeof(uint32_t), size, out) == size &&
+                       (!count || fwrite(constants, sizeof(uint32_t), count, out) == count);
+        return (fclose(out) == 0 && written) ? 0 : -1;
+}
+
+void program_free(program_t *program)
+{
+        if (!program)
+        {
+                return;
+        }
+        thread_cache_free(program->threaded);
+        thread_cache_free(program->checked);
+        jit_free(program->jit);
+        jit_free(program->jit_counted);
+        vector_program_free(program->vector);
+        if (program->mapped)
+        {
+                munmap((void *)program->mapping, program->mapped);
+        }
+        free(program);
+        return;
+}
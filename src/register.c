@@ -0,0 +1,456 @@
+/***
+ *
+ * @file: register.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the register-caching execution engine of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "register.h"
+#include "channel.h"
+#include "native.h"
+
+// `top` points to the slot of the top of stack, whose value lives in `tos`.
+// The empty stack points `top` to the guard word below the stack, so a push can always spill.
+#define REGISTER_TYPES          PRIMITIVE_COUNT                         // First handler of the other word types, indexed by GET_TYPE
+#define REGISTER_HANDLER_COUNT  (PRIMITIVE_COUNT + 4)                   // Handlers of the primitives and of the four word types
+#define INDEX(instr)            ((((instr) ^ 0x40000000) < PRIMITIVE_COUNT) ? ((instr) ^ 0x40000000) : REGISTER_TYPES + GET_TYPE(instr)) // Handler of a word
+#define DISPATCH()              do { if (slow) goto fetch; instruction = code[pc]; goto *table[INDEX(instruction)]; } while (0)
+#define NEXT()                  do { pc++; DISPATCH(); } while (0)      // Dispatch the next word
+#define DEPTH()                 ((uint32_t)(top - base + 1))            // Number of values on the stack
+#define SYNC()                  do { vm->pc = pc; vm->sp = (uint32_t)(top - base); *top = tos; vm->flags = cell_flags(flag_op, flag_a, flag_b); \
+                                     vm->fp = fp; vm->calls = calls; RETIRED(); } while (0)
+#if STACKVM_METRICS
+#define RETIRED()               do { vm->retired = retired; vm->peak = peak; } while (0) // Write the counts back to the context
+#else
+#define RETIRED()               ((void)0)
+#endif
+#define FAULT(reason)           do { SYNC(); stackvm_fault(vm, (reason)); return; } while (0)
+#define NEED(count)             do { if (DEPTH() < (count)) FAULT(ERROR_STACK_UNDERFLOW); } while (0)
+#define SLOT()                  ((int64_t)fp + (int32_t)code[pc + 1]) // Stack cell of the local slot of the instruction
+#define TARGET()                ((pc + 1 < size) ? code[pc + 1] : size) // A missing target word leaves the program
+#define FLAGS(op, a, b)         do { flag_op = (op); flag_a = (a); flag_b = (b); } while (0) // Remember the flag-setting instruction
+#define BINARY(op)              do { tos = *--top op tos; NEXT(); } while (0)
+#define ARITHMETIC(fn, opcode)  do { cell_t nos = *--top; FLAGS(opcode, nos, tos); tos = fn(nos, tos); NEXT(); } while (0)
+#define COMPARE(op)             do { cell_t nos = *--top; FLAGS(SUB, nos, tos); tos = (nos op tos) ? 1 : 0; NEXT(); } while (0)
+#define BRANCH(taken)           do { bool result = (tos != 0) == (taken); tos = *--top; pc = result ? TARGET() : pc + 2; DISPATCH(); } while (0) // Pop the condition, skip the target word when not taken
+#define FLAG_BRANCH(opcode)     do { pc = flag_taken((opcode), cell_flags(flag_op, flag_a, flag_b)) ? TARGET() : pc + 2; DISPATCH(); } while (0)
+
+/**
+ * @brief Dispatch loop of the register-caching engine
+ * @param vm Pointer to the StackVM context
+ * @param checked Check the stack bounds and the program counter of every instruction
+ * @param traced Call the trace hook before every instruction
+ * @param counted Count the instructions retired and the peak stack depth
+ * @param budgeted Pause once `budget` instructions ran
+ * @param budget Instruction budget of a budgeted run
+ * @return void
+ * @note Every word is dispatched through a table of handler addresses indexed by its opcode or, for pushes
+ *       and undefined words, by its type. Like on the threaded engine every checked handler verifies the
+ *       stack bounds and then falls through into the unchecked handler of the same instruction. Budgeted,
+ *       traced, counted and checked runs fetch every word through the slow path, the others jump straight
+ *       to the handler.
+ *       Flag-setting instructions only remember their opcode and operands, the flag register is
+ *       computed by the flag branches and whenever the context is written back.
+ */
+static void register_dispatch(stackvm_t *vm, bool checked, bool traced, bool counted, bool budgeted, uint64_t budget)
+{
+        static const void *const handlers[REGISTER_HANDLER_COUNT] =
+        {
+                [HALT]                          = &&op_halt,
+                [ADD]                           = &&op_add,
+                [SUB]                           = &&op_sub,
+                [MUL]                           = &&op_mul,
+                [DIV]                           = &&op_div,
+                [AND]                           = &&op_and,
+                [OR]                            = &&op_or,
+                [NOT]                           = &&op_not,
+                [XOR]                           = &&op_xor,
+                [LT]                            = &&op_lt,
+                [GT]                            = &&op_gt,
+                [LE]                            = &&op_le,
+                [GE]                            = &&op_ge,
+                [EQ]                            = &&op_eq,
+                [NE]                            = &&op_ne,
+                [BR]                            = &&op_br,
+                [BRT]                           = &&op_brt,
+                [BRF]                           = &&op_brf,
+                [RET]                           = &&op_ret,
+                [LIT]                           = &&op_lit,
+                [CALL]                          = &&op_call,
+                [LOAD_LOCAL]                    = &&op_load_local,
+                [STORE_LOCAL]                   = &&op_store_local,
+                [IN]                            = &&op_in,
+                [OUT]                           = &&op_out,
+                [CALL_NATIVE]                   = &&op_call_native,
+                [CMP]                           = &&op_cmp,
+                [BRZ]                           = &&op_brz,
+                [BRNZ]                          = &&op_brnz,
+                [BRLT]                          = &&op_brlt,
+                [BRGE]                          = &&op_brge,
+                [BRGT]                          = &&op_brgt,
+                [BRLE]                          = &&op_brle,
+                [REGISTER_TYPES + POSITIVE_INTEGER]      = &&op_push,
+                [REGISTER_TYPES + PRIMITIVE_INSTRUCTION] = &&op_undefined_primitive,
+                [REGISTER_TYPES + NEGATIVE_INTEGER]      = &&op_push,
+                [REGISTER_TYPES + 3]                     = &&op_undefined_instruction,
+        };
+        static const void *const checked_handlers[REGISTER_HANDLER_COUNT] =
+        {
+                [HALT]                          = &&op_halt,
+                [ADD]                           = &&chk_add,
+                [SUB]                           = &&chk_sub,
+                [MUL]                           = &&chk_mul,
+                [DIV]                           = &&chk_div,
+                [AND]                           = &&chk_and,
+                [OR]                            = &&chk_or,
+                [NOT]                           = &&chk_not,
+                [XOR]                           = &&chk_xor,
+                [LT]                            = &&chk_lt,
+                [GT]                            = &&chk_gt,
+                [LE]                            = &&chk_le,
+                [GE]                            = &&chk_ge,
+                [EQ]                            = &&chk_eq,
+                [NE]                            = &&chk_ne,
+                [BR]                            = &&op_br,
+                [BRT]                           = &&chk_brt,
+                [BRF]                           = &&chk_brf,
+                [RET]                           = &&chk_ret,
+                [LIT]                           = &&chk_lit,
+                [CALL]                          = &&chk_call,
+                [LOAD_LOCAL]                    = &&chk_load_local,
+                [STORE_LOCAL]                   = &&chk_store_local,
+                [IN]                            = &&chk_in,
+                [OUT]                           = &&chk_out,
+                [CALL_NATIVE]                   = &&chk_call_native,
+                [CMP]                           = &&chk_cmp,
+                [BRZ]                           = &&op_brz,
+                [BRNZ]                          = &&op_brnz,
+                [BRLT]                          = &&op_brlt,
+                [BRGE]                          = &&op_brge,
+                [BRGT]                          = &&op_brgt,
+                [BRLE]                          = &&op_brle,
+                [REGISTER_TYPES + POSITIVE_INTEGER]      = &&chk_push,
+                [REGISTER_TYPES + PRIMITIVE_INSTRUCTION] = &&op_undefined_primitive,
+                [REGISTER_TYPES + NEGATIVE_INTEGER]      = &&chk_push,
+                [REGISTER_TYPES + 3]                     = &&op_undefined_instruction,
+        };
+
+        const void *const *table = checked ? checked_handlers : handlers; // Handlers of the run
+        const bool slow          = checked || traced || counted || budgeted; // Fetch every word through the slow path
+        const uint32_t *code     = vm->code;                            // Code segment
+        uint32_t size            = vm->size;                            // Number of program words
+        uint32_t pc              = vm->pc;                              // Program counter
+        uint32_t instruction;                                           // Word being executed
+        cell_t *base             = vm->stack;                           // Bottom of the operand stack
+        cell_t *limit            = base + vm->stack_size - 1;           // Highest slot of the operand stack
+        cell_t *top              = base - 1 + (uint32_t)(vm->sp + 1);   // Slot of the top of stack, the guard cell when empty
+        cell_t tos               = *top;                                // Top of stack
+        uint32_t flag_op         = HALT;                                // Last flag-setting instruction, HALT keeps the flags of the context
+        cell_t flag_a            = vm->flags;                           // Its left operand
+        cell_t flag_b            = 0;                                   // Its right operand
+        frame_t *frames          = vm->frames;                          // Call stack
+        uint32_t calls           = vm->calls;                           // Frames on the call stack
+        uint32_t fp              = vm->fp;                              // Frame pointer
+        const native_t *native;                                         // Native function of the last CALL_NATIVE
+#if STACKVM_METRICS
+        uint64_t retired         = 0;                                   // Instructions dispatched by a counted run
+        uint32_t peak            = vm->peak;                            // Deepest stack a counted run dispatched with
+#else
+        (void)counted;
+#endif
+
+        vm->state = STATE_RUN;
+        DISPATCH();
+
+fetch:
+        if (budgeted && budget-- == 0)
+        {
+                SYNC();                                                 // Resumable at the next instruction
+                vm->state = STATE_PAUSED;
+                return;
+        }
+#if STACKVM_METRICS
+        if (counted)
+        {
+                retired++;                                              // Retires like it consumes the budget, faults included
+                peak = (DEPTH() > peak) ? DEPTH() : peak;
+        }
+#endif
+        if (checked && pc >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);
+        }
+        instruction = code[pc];
+#if STACKVM_TRACE
+        if (traced)
+        {
+                SYNC();                                                 // The trace hook reads the context
+                stackvm_hook(vm, code, size, pc, base, vm->sp);
+        }
+#endif
+        goto *table[INDEX(instruction)];
+
+chk_push:
+        if (top >= limit)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_push:
+        *top++ = tos;                                                   // Spill the old top of stack
+        tos    = GET_IMMEDIATE(instruction);
+        NEXT();
+op_undefined_primitive:
+        FAULT(ERROR_UNDEFINED_PRIMITIVE);
+op_undefined_instruction:
+        FAULT(ERROR_UNDEFINED_INSTRUCTION);
+op_halt:
+        SYNC();
+        vm->state = STATE_HALT;
+        return;
+
+chk_add: NEED(2);
+op_add:  ARITHMETIC(cell_add, ADD);
+chk_sub: NEED(2);
+op_sub:  ARITHMETIC(cell_sub, SUB);
+chk_mul: NEED(2);
+op_mul:  ARITHMETIC(cell_mul, MUL);
+chk_div: NEED(2);
+op_div:
+        if (tos == 0)
+        {
+                FAULT(ERROR_DIVISION_BY_ZERO);
+        }
+        FLAGS(DIV, top[-1], tos);
+        tos = cell_div(*--top, tos);
+        NEXT();
+chk_and: NEED(2);
+op_and:  BINARY(&);
+chk_or:  NEED(2);
+op_or:   BINARY(|);
+chk_not: NEED(1);
+op_not:
+        tos = ~tos;
+        NEXT();
+chk_xor: NEED(2);
+op_xor:  BINARY(^);
+chk_lt:  NEED(2);
+op_lt:   COMPARE(<);
+chk_gt:  NEED(2);
+op_gt:   COMPARE(>);
+chk_le:  NEED(2);
+op_le:   COMPARE(<=);
+chk_ge:  NEED(2);
+op_ge:   COMPARE(>=);
+chk_eq:  NEED(2);
+op_eq:   COMPARE(==);
+chk_ne:  NEED(2);
+op_ne:   COMPARE(!=);
+
+op_br:
+        pc = TARGET();
+        DISPATCH();
+chk_brt: NEED(1);
+op_brt:  BRANCH(true);
+chk_brf: NEED(1);
+op_brf:  BRANCH(false);
+chk_cmp: NEED(2);
+op_cmp:
+        FLAGS(CMP, top[-1], tos);
+        top -= 2;
+        tos  = *top;                                                    // Pop both operands
+        NEXT();
+op_brz:  FLAG_BRANCH(BRZ);
+op_brnz: FLAG_BRANCH(BRNZ);
+op_brlt: FLAG_BRANCH(BRLT);
+op_brge: FLAG_BRANCH(BRGE);
+op_brgt: FLAG_BRANCH(BRGT);
+op_brle: FLAG_BRANCH(BRLE);
+
+chk_ret:
+        if (calls == 0)
+        {
+                FAULT(ERROR_CALL_UNDERFLOW);
+        }
+op_ret:
+        calls--;
+        fp = frames[calls].fp;
+        pc = frames[calls].ret;                                         // Out of range addresses fault on the next fetch
+        DISPATCH();
+chk_call:
+        if (calls >= vm->call_size)
+        {
+                FAULT(ERROR_CALL_OVERFLOW);
+        }
+op_call:
+        frames[calls++] = (frame_t){ .ret = pc + 2, .fp = fp };
+        fp = DEPTH();
+        pc = TARGET();
+        DISPATCH();
+
+chk_load_local:
+        if (pc + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        if (SLOT() < 0 || SLOT() >= DEPTH())
+        {
+                FAULT(ERROR_INVALID_LOCAL);
+        }
+        if (top >= limit)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_load_local:
+        *top++ = tos;                                                   // Spill first, the slot may be the old top of stack
+        tos    = base[SLOT()];
+        pc    += 2;
+        DISPATCH();
+chk_store_local:
+        NEED(1);
+        if (pc + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        if (SLOT() < 0 || SLOT() >= DEPTH() - 1)
+        {
+                FAULT(ERROR_INVALID_LOCAL);
+        }
+op_store_local:
+        base[SLOT()] = tos;
+        tos = *--top;
+        pc += 2;
+        DISPATCH();
+chk_lit:
+        if (pc + 2 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand words
+        }
+        if (top >= limit)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_lit:
+        *top++ = tos;
+        tos    = GET_WIDE(code[pc + 1], code[pc + 2]);
+        pc    += 3;
+        DISPATCH();
+
+chk_in:
+        if (top >= limit)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_in:
+{
+        if (!vm->in)
+        {
+                FAULT(ERROR_NO_CHANNEL);
+        }
+        cell_t value;
+        channel_status_t status = channel_get(vm->in, &value);
+        if (status != CHANNEL_OK)
+        {
+                SYNC();                                                 // Waits on the IN, or the stream ended the program
+                vm->state = (status == CHANNEL_BLOCKED) ? STATE_PAUSED : STATE_HALT;
+                return;
+        }
+        *top++ = tos;
+        tos    = value;
+        NEXT();
+}
+chk_out: NEED(1);
+op_out:
+        if (!vm->out)
+        {
+                FAULT(ERROR_NO_CHANNEL);
+        }
+        if (channel_put(vm->out, tos) != CHANNEL_OK)
+        {
+                SYNC();                                                 // Waits on the OUT
+                vm->state = STATE_PAUSED;
+                return;
+        }
+        tos = *--top;
+        NEXT();
+
+chk_call_native:
+        if (pc + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        native = native_get(code[pc + 1]);
+        if (!native)
+        {
+                FAULT(ERROR_UNDEFINED_NATIVE);
+        }
+        NEED(native->arity);
+        if ((uint64_t)DEPTH() - native->arity + native->results > vm->stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+        goto call_native;
+op_call_native:
+        native = &native_table[code[pc + 1]];                           // Verified programs only call registered functions
+call_native:
+{
+        *top = tos;                                                     // The arguments are read in place
+        cell_t *args = top + 1 - native->arity;
+        if (!native->fn(args, native->data))
+        {
+                FAULT(ERROR_NATIVE_FAILED);
+        }
+        top = args - 1 + native->results;
+        tos = *top;
+        pc += 2;
+        DISPATCH();
+}
+}
+
+void stackvm_run_register(stackvm_t *vm)
+{
+        const program_t *program = vm->program;
+        if (!program)
+        {
+                stackvm_fault(vm, ERROR_NO_PROGRAM);
+                return;
+        }
+
+#if STACKVM_TRACE
+        if (stackvm_hooked(vm))
+        {
+                register_dispatch(vm, true, true, stackvm_counted(vm), false, 0); // Trace level is chosen once per run
+                return;
+        }
+#endif
+        // Same entry conditions as the unchecked threaded code, counting is chosen once per run
+        register_dispatch(vm, !stackvm_unchecked(vm), false, stackvm_counted(vm), false, 0);
+        return;
+}
+
+void stackvm_run_register_for(stackvm_t *vm, uint64_t budget)
+{
+        if (!vm->program)
+        {
+                stackvm_fault(vm, ERROR_NO_PROGRAM);
+                return;
+        }
+
+#if STACKVM_TRACE
+        if (stackvm_hooked(vm))
+        {
+                register_dispatch(vm, true, true, stackvm_counted(vm), true, budget);
+                return;
+        }
+#endif
+        // A resumed slice enters mid-program and runs checked
+        register_dispatch(vm, !stackvm_unchecked(vm), false, stackvm_counted(vm), true, budget);
+        return;
+}
@@ -0,0 +1,168 @@
+/***
+ *
+ * @file: slab.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the slab allocator that recycles StackVM contexts
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <pthread.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "slab.h"
+
+#define SLAB_CACHE_LINE         64              // Contexts never share a cache line
+#define SLAB_ROUND(size)        (((size) + SLAB_CACHE_LINE - 1) & ~(size_t)(SLAB_CACHE_LINE - 1))
+
+/**
+ * @brief Arena of a slab
+ * @note One allocation holding the header followed by `count` slots. A slot is the context,
+ *       its guard cell, stack and data segments and its call stack, each on fresh cache lines.
+ */
+typedef struct slab_arena
+{
+        struct slab_arena *next;           // Arena allocated before this one
+        void *block;                       // Allocation holding the arena
+} slab_arena_t;
+
+struct slab
+{
+        stackvm_config_t config;           // Resolved segment sizes of every context
+        uint32_t count;                    // Contexts per arena
+        size_t cells;                      // Bytes of the stack and data segments of a slot
+        size_t slot;                       // Bytes of a slot
+        pthread_mutex_t lock;              // Guards the free list and the arenas
+        slab_arena_t *arenas;              // Arenas, newest first
+        stackvm_t **idle;                  // Free list, the most recently released context last
+        uint32_t idles;                    // Contexts on the free list
+        slab_stats_t stats;                // Counters
+};
+
+/**
+ * @brief Carves a new arena into contexts and puts them on the free list
+ * @param slab Pointer to the slab, locked by the caller
+ * @return 0 on success, -1 on failure
+ * @note The arena is allocated zeroed and the segments are never written before a context is
+ *       handed out, so the pages of a large stack are only faulted in as far as runs reach.
+ */
+static int slab_grow(slab_t *slab)
+{
+        uint32_t contexts = slab->stats.contexts + slab->count;
+        stackvm_t **idle  = (stackvm_t **)realloc(slab->idle, contexts * sizeof(stackvm_t *));
+        if (!idle)
+        {
+                return -1;
+        }
+        slab->idle = idle;
+
+        size_t header = SLAB_ROUND(sizeof(slab_arena_t));
+        void *block   = calloc(1, header + slab->count * slab->slot + SLAB_CACHE_LINE);
+        if (!block)
+        {
+                return -1;
+        }
+        uint8_t *base        = (uint8_t *)SLAB_ROUND((uintptr_t)block);
+        slab_arena_t *arena  = (slab_arena_t *)base;
+        arena->next          = slab->arenas;
+        arena->block         = block;
+        slab->arenas         = arena;
+
+        // Hand out the first slot first, so the arena is walked in address order
+        for (uint32_t i = slab->count; i-- > 0; )
+        {
+                uint8_t *slot   = base + header + i * slab->slot;
+                stackvm_t *vm   = (stackvm_t *)slot;
+                void *memory    = slot + SLAB_ROUND(sizeof(stackvm_t));
+                frame_t *frames = (frame_t *)((uint8_t *)memory + slab->cells);
+                stackvm_place(vm, &slab->config, memory, frames);
+                vm->slab = slab;
+                slab->idle[slab->idles++] = vm;
+        }
+        slab->stats.contexts = contexts;
+        slab->stats.arenas++;
+        return 0;
+}
+
+slab_t *slab_create(const stackvm_config_t *config, uint32_t count)
+{
+        slab_t *slab = (slab_t *)calloc(1, sizeof(slab_t));
+        if (!slab)
+        {
+                return NULL;
+        }
+        slab->config = stackvm_config(config);
+        slab->count  = count ? count : SLAB_DEFAULT_COUNT;
+        slab->cells  = SLAB_ROUND((STACK_GUARD + (size_t)slab->config.stack_size + slab->config.data_size) * sizeof(cell_t));
+        slab->slot   = SLAB_ROUND(sizeof(stackvm_t)) + slab->cells + SLAB_ROUND(slab->config.call_size * sizeof(frame_t));
+        if (pthread_mutex_init(&slab->lock, NULL) != 0)
+        {
+                free(slab);
+                return NULL;
+        }
+        if (slab_grow(slab) != 0)
+        {
+                fprintf(stderr, "Error: Failed to allocate the contexts of the slab\n");
+                slab_free(slab);
+                return NULL;
+        }
+        return slab;
+}
+
+void slab_free(slab_t *slab)
+{
+        if (!slab)
+        {
+                return;
+        }
+        while (slab->arenas)
+        {
+                slab_arena_t *arena = slab->arenas;
+                slab->arenas = arena->next;
+                free(arena->block);
+        }
+        free(slab->idle);
+        pthread_mutex_destroy(&slab->lock);
+        free(slab);
+        return;
+}
+
+stackvm_t *slab_acquire(slab_t *slab)
+{
+        pthread_mutex_lock(&slab->lock);
+        if (slab->idles == 0 && slab_grow(slab) != 0)
+        {
+                pthread_mutex_unlock(&slab->lock);
+                fprintf(stderr, "Error: Failed to grow the slab\n");
+                return NULL;
+        }
+        stackvm_t *vm = slab->idle[--slab->idles];
+        slab->stats.acquired++;
+        pthread_mutex_unlock(&slab->lock);
+        return vm;
+}
+
+void slab_release(slab_t *slab, stackvm_t *vm)
+{
+        stackvm_reset(vm);                                      // Clears the stack below the high-water mark
+        stackvm_place(vm, &slab->config, vm->memory, vm->frames); // Registers of a fresh context
+        vm->slab = slab;
+
+        pthread_mutex_lock(&slab->lock);
+        slab->idle[slab->idles++] = vm;                         // Never overflows, the list holds every context
+        pthread_mutex_unlock(&slab->lock);
+        return;
+}
+
+void slab_stats(slab_t *slab, slab_stats_t *stats)
+{
+        pthread_mutex_lock(&slab->lock);
+        *stats      = slab->stats;
+        stats->idle = slab->idles;
+        pthread_mutex_unlock(&slab->lock);
+        return;
+}
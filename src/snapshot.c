@@ -0,0 +1,319 @@
+/***
+ *
+ * @file: snapshot.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the snapshots that save and restore the state of a StackVM context
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _GNU_SOURCE // memfd_create, pread, pwrite
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "snapshot.h"
+
+/**
+ * @brief Writes a whole block at an offset of a file
+ * @param fd File descriptor
+ * @param data Pointer to the block
+ * @param size Size of the block in bytes
+ * @param offset Offset in the file
+ * @return 0 on success, -1 on failure
+ */
+static int write_at(int fd, const void *data, size_t size, uint64_t offset)
+{
+        const uint8_t *bytes = (const uint8_t *)data;
+        while (size)
+        {
+                ssize_t written = pwrite(fd, bytes, size, (off_t)offset);
+                if (written <= 0)
+                {
+                        return -1;
+                }
+                bytes  += written;
+                size   -= (size_t)written;
+                offset += (uint64_t)written;
+        }
+        return 0;
+}
+
+/**
+ * @brief Reads a whole block at an offset of a file
+ * @param fd File descriptor
+ * @param data Receives the block
+ * @param size Size of the block in bytes
+ * @param offset Offset in the file
+ * @return 0 on success, -1 on failure
+ */
+static int read_at(int fd, void *data, size_t size, uint64_t offset)
+{
+        uint8_t *bytes = (uint8_t *)data;
+        while (size)
+        {
+                ssize_t got = pread(fd, bytes, size, (off_t)offset);
+                if (got <= 0)
+                {
+                        return -1;
+                }
+                bytes  += got;
+                size   -= (size_t)got;
+                offset += (uint64_t)got;
+        }
+        return 0;
+}
+
+/**
+ * @brief Computes the checksum of a snapshot
+ * @param header Header, its checksum field is ignored
+ * @param code Pointer to the code section
+ * @param frames Pointer to the call stack section
+ * @return CRC-32 of the header with a zero checksum, the code and the call stack
+ */
+static uint32_t snapshot_checksum(const snapshot_header_t *header, const uint32_t *code, const frame_t *frames)
+{
+        snapshot_header_t copy = *header;
+        copy.checksum = 0;
+        uint32_t crc = crc32_update(0, &copy, sizeof(copy));
+        crc = crc32_update(crc, code, header->program_size * sizeof(uint32_t));
+        return crc32_update(crc, frames, header->calls * sizeof(frame_t));
+}
+
+/**
+ * @brief Writes a snapshot of a context into a file
+ * @param fd File descriptor of an empty file
+ * @param vm Pointer to the StackVM context
+ * @param header Receives the header of the snapshot
+ * @return 0 on success, -1 on failure
+ * @note The file is sized to the whole memory image first, so the cells that are not written stay holes.
+ */
+static int snapshot_write(int fd, const stackvm_t *vm, snapshot_header_t *header)
+{
+        uint32_t live = vm->sp + 1;                             // Cells above the stack pointer are never read
+        uint32_t data = vm->data_size;
+        while (data > 0 && vm->data_segment[data - 1] == 0)
+        {
+                data--;                                         // Trailing zero cells stay holes
+        }
+
+        memset(header, 0, sizeof(*header));
+        header->magic          = SNAPSHOT_MAGIC;
+        header->version        = SNAPSHOT_VERSION;
+        header->state          = (uint8_t)vm->state;
+        header->flags          = vm->flags;
+        header->pc             = vm->pc;
+        header->sp             = vm->sp;
+        header->fp             = vm->fp;
+        header->calls          = vm->calls;
+        header->engine         = vm->engine;
+        header->code_size      = vm->code_size;
+        header->stack_size     = vm->stack_size;
+        header->data_size      = vm->data_size;
+        header->call_size      = vm->call_size;
+        header->program_offset = sizeof(snapshot_header_t);
+        header->program_size   = vm->size;
+        header->frames_offset  = header->program_offset + vm->size * sizeof(uint32_t);
+        header->memory_offset  = ((uint64_t)header->frames_offset + vm->calls * sizeof(frame_t) + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+        header->memory_size    = (STACK_GUARD + (uint64_t)vm->stack_size + vm->data_size) * sizeof(cell_t);
+        header->checksum       = snapshot_checksum(header, vm->code, vm->frames);
+
+        uint64_t stack_offset = header->memory_offset + STACK_GUARD * sizeof(cell_t);
+        uint64_t data_offset  = stack_offset + (uint64_t)vm->stack_size * sizeof(cell_t);
+        if (ftruncate(fd, (off_t)(header->memory_offset + header->memory_size)) != 0 ||
+            write_at(fd, header, sizeof(*header), 0) != 0 ||
+            write_at(fd, vm->code, vm->size * sizeof(uint32_t), header->program_offset) != 0 ||
+            write_at(fd, vm->frames, vm->calls * sizeof(frame_t), header->frames_offset) != 0 ||
+            write_at(fd, vm->stack, live * sizeof(cell_t), stack_offset) != 0 ||
+            write_at(fd, vm->data_segment, data * sizeof(cell_t), data_offset) != 0)
+        {
+                return -1;
+        }
+        return 0;
+}
+
+/**
+ * @brief Tells whether a context can be saved
+ * @param vm Pointer to the StackVM context
+ * @return true if a program is attached and the registers lie inside the segments
+ */
+static bool snapshot_valid(const stackvm_t *vm)
+{
+        return vm && vm->program && vm->memory && vm->sp + 1 <= vm->stack_size && vm->calls <= vm->call_size;
+}
+
+snapshot_t *snapshot_take(const stackvm_t *vm)
+{
+        if (!snapshot_valid(vm))
+        {
+                fprintf(stderr, "Error: Invalid VM context for a snapshot\n");
+                return NULL;
+        }
+        snapshot_t *snapshot = (snapshot_t *)calloc(1, sizeof(snapshot_t));
+        frame_t *frames      = (frame_t *)malloc((vm->calls ? vm->calls : 1) * sizeof(frame_t));
+        int fd               = memfd_create("stackvm-snapshot", MFD_CLOEXEC);
+        if (!snapshot || !frames || fd < 0 || snapshot_write(fd, vm, &snapshot->header) != 0)
+        {
+                fprintf(stderr, "Error: Failed to take the snapshot\n");
+                if (fd >= 0)
+                {
+                        close(fd);
+                }
+                free(frames);
+                free(snapshot);
+                return NULL;
+        }
+        memcpy(frames, vm->frames, vm->calls * sizeof(frame_t));
+        snapshot->fd           = fd;
+        snapshot->program      = vm->program;
+        snapshot->frames       = frames;
+        snapshot->owns_program = false;
+        return snapshot;
+}
+
+int snapshot_save(const stackvm_t *vm, const char *path)
+{
+        if (!snapshot_valid(vm) || !path)
+        {
+                return -1;
+        }
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+                return -1;
+        }
+        snapshot_header_t header;
+        int status = snapshot_write(fd, vm, &header);
+        return (close(fd) == 0) ? status : -1;
+}
+
+snapshot_t *snapshot_open(const char *path)
+{
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+                fprintf(stderr, "Error: Failed to open snapshot file '%s'\n", path);
+                return NULL;
+        }
+        struct stat info;
+        snapshot_header_t header;
+        if (fstat(fd, &info) != 0 || read_at(fd, &header, sizeof(header), 0) != 0)
+        {
+                fprintf(stderr, "Error: '%s' is not a StackVM snapshot\n", path);
+                close(fd);
+                return NULL;
+        }
+
+        uint64_t file = (uint64_t)info.st_size;
+        uint64_t code = (uint64_t)header.program_size * sizeof(uint32_t);
+        if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+            header.state > STATE_PAUSED || header.engine >= ENGINE_COUNT ||
+            header.program_size == 0 || header.program_size > header.code_size ||
+            header.sp + 1 > header.stack_size || header.calls > header.call_size ||
+            header.program_offset < sizeof(header) || header.frames_offset != header.program_offset + code ||
+            (uint64_t)header.frames_offset + header.calls * sizeof(frame_t) > header.memory_offset ||
+            header.memory_offset % SNAPSHOT_ALIGN != 0 ||
+            header.memory_size != (STACK_GUARD + (uint64_t)header.stack_size + header.data_size) * sizeof(cell_t) ||
+            header.memory_offset + header.memory_size > file)
+        {
+                fprintf(stderr, "Error: '%s' is not a StackVM snapshot of version %d\n", path, SNAPSHOT_VERSION);
+                close(fd);
+                return NULL;
+        }
+
+        snapshot_t *snapshot = (snapshot_t *)calloc(1, sizeof(snapshot_t));
+        uint32_t *words      = (uint32_t *)malloc(code);
+        frame_t *frames      = (frame_t *)malloc((header.calls ? header.calls : 1) * sizeof(frame_t));
+        if (!snapshot || !words || !frames ||
+            read_at(fd, words, code, header.program_offset) != 0 ||
+            read_at(fd, frames, header.calls * sizeof(frame_t), header.frames_offset) != 0 ||
+            snapshot_checksum(&header, words, frames) != header.checksum)
+        {
+                fprintf(stderr, "Error: Failed to read snapshot file '%s'\n", path);
+                close(fd);
+                free(frames);
+                free(words);
+                free(snapshot);
+                return NULL;
+        }
+
+        snapshot->program = program_create(words, header.program_size); // Verified once for every restore
+        free(words);
+        if (!snapshot->program)
+        {
+                fprintf(stderr, "Error: Failed to load the program of snapshot file '%s'\n", path);
+                close(fd);
+                free(frames);
+                free(snapshot);
+                return NULL;
+        }
+        snapshot->header       = header;
+        snapshot->fd           = fd;
+        snapshot->frames       = frames;
+        snapshot->owns_program = true;
+        return snapshot;
+}
+
+void snapshot_close(snapshot_t *snapshot)
+{
+        if (!snapshot)
+        {
+                return;
+        }
+        if (snapshot->owns_program)
+        {
+                program_free(snapshot->program);
+        }
+        close(snapshot->fd);                                    // Mappings of restored contexts stay valid
+        free(snapshot->frames);
+        free(snapshot);
+        return;
+}
+
+stackvm_t *snapshot_restore(const snapshot_t *snapshot)
+{
+        const snapshot_header_t *header = &snapshot->header;
+        stackvm_t *vm   = (stackvm_t *)malloc(sizeof(stackvm_t));
+        frame_t *frames = (frame_t *)calloc(header->call_size, sizeof(frame_t));
+        void *memory    = mmap(NULL, header->memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, snapshot->fd, (off_t)header->memory_offset);
+        if (!vm || !frames || memory == MAP_FAILED)
+        {
+                fprintf(stderr, "Error: Failed to restore the snapshot\n");
+                if (memory != MAP_FAILED)
+                {
+                        munmap(memory, header->memory_size);
+                }
+                free(frames);
+                free(vm);
+                return NULL;
+        }
+
+        stackvm_config_t config =
+        {
+                .code_size  = header->code_size,
+                .stack_size = header->stack_size,
+                .data_size  = header->data_size,
+                .call_size  = header->call_size,
+        };
+        stackvm_place(vm, &config, memory, frames);
+        vm->mapping = header->memory_size;                      // Unmapped by stackvm_free
+        attach_program(vm, snapshot->program);
+        memcpy(frames, snapshot->frames, header->calls * sizeof(frame_t));
+        vm->pc     = header->pc;
+        vm->sp     = header->sp;
+        vm->fp     = header->fp;
+        vm->calls  = header->calls;
+        vm->flags  = header->flags;
+        vm->state  = (state_t)header->state;
+        vm->engine = (engine_t)header->engine;
+        vm->high   = header->sp + 1;                            // The image holds nothing above the stack pointer
+        return vm;
+}
@@ -10,111 +10,601 @@
  * 
  */
 
+#include <sys/mman.h>
+
 #include "defs.h"
 #include "stackvm.h"
+#include "threaded.h"
+#include "vector.h"
+#include "register.h"
+#include "jit.h"
+#include "slab.h"
+#include "channel.h"
+#include "native.h"
+#include "metrics.h"
 
-static stackvm_t *vm;
-
-static int instruction_stage_counter = 0;
-static const stage_t instruction_stage[] =
+static const stage_t base_instruction_stage[] =
 {
         fetch_instruction,   // Fetch stage
         decode_instruction,  // Decode stage
         execute_instruction, // Execute stage
 };
 
+#if STACKVM_TRACE
+static void execute_traced(stackvm_t *vm);
+
+static const stage_t traced_instruction_stage[] =
+{
+        fetch_instruction,   // Fetch stage
+        decode_instruction,  // Decode stage
+        execute_traced,      // Trace and execute stage
+};
+#endif
+
+static void stackvm_run_staged(stackvm_t *vm);
+static void stackvm_run_staged_for(stackvm_t *vm, uint64_t budget);
+
+static const struct
+{
+        const char *name;                                       // Name of the engine
+        void (*run)(stackvm_t *vm);                             // Entry point of the engine
+        void (*run_for)(stackvm_t *vm, uint64_t budget);        // Entry point of budgeted runs
+} engines[ENGINE_COUNT] =
+{
+        [ENGINE_STAGED]   = { "staged",   stackvm_run_staged,   stackvm_run_staged_for   },
+        [ENGINE_THREADED] = { "threaded", stackvm_run_threaded, stackvm_run_register_for },
+        [ENGINE_VECTOR]   = { "vector",   stackvm_run_threaded, stackvm_run_register_for }, // Vectorized for batches only
+        [ENGINE_REGISTER] = { "register", stackvm_run_register, stackvm_run_register_for },
+        [ENGINE_JIT]      = { "jit",      stackvm_run_jit,      stackvm_run_register_for },
+};
+
 stackvm_t *stackvm_ctxt()
 {
+        return stackvm_create(NULL); // Context with the default segment sizes
+}
+
+stackvm_t *stackvm_create(const stackvm_config_t *config)
+{
+        stackvm_t *vm = (stackvm_t *)malloc(sizeof(stackvm_t)); // Allocate memory for the VM context
         if (!vm)
         {
-                vm = (stackvm_t *)malloc(sizeof(stackvm_t));    // Allocate memory for the VM context
-                if (!vm)
-                {
-                        return NULL;                            // Return NULL if memory allocation fails
-                }
-                stackvm_init(vm);                               // Initialize the VM context
+                return NULL;                                    // Return NULL if memory allocation fails
+        }
+        stackvm_init(vm, config);                               // Initialize the VM context
+        if (!vm->memory || !vm->frames)
+        {
+                free(vm->memory);
+                free(vm->frames);
+                free(vm);                                       // Return NULL if the VM memory could not be allocated
+                return NULL;
         }
         return vm; // Return the VM context
 }
 
-void stackvm_init(stackvm_t *vm)
+void stackvm_init(stackvm_t *vm, const stackvm_config_t *config)
+{
+        stackvm_config_t sizes = stackvm_config(config);
+        void *memory    = calloc(STACK_GUARD + (size_t)sizes.stack_size + sizes.data_size, sizeof(cell_t)); // Allocate the stack and data segments
+        frame_t *frames = (frame_t *)calloc(sizes.call_size, sizeof(frame_t));   // Allocate the call stack
+        stackvm_place(vm, &sizes, memory, frames);
+        return;
+}
+
+stackvm_config_t stackvm_config(const stackvm_config_t *config)
+{
+        return (stackvm_config_t)
+        {
+                .code_size  = (config && config->code_size)  ? config->code_size  : CODE_MEMORY_SIZE,
+                .stack_size = (config && config->stack_size) ? config->stack_size : STACK_MEMORY_SIZE,
+                .data_size  = (config && config->data_size)  ? config->data_size  : DATA_MEMORY_SIZE,
+                .call_size  = (config && config->call_size)  ? config->call_size  : CALL_STACK_SIZE,
+        };
+}
+
+void stackvm_place(stackvm_t *vm, const stackvm_config_t *config, void *memory, frame_t *frames)
 {
+        vm->code_size  = config->code_size;
+        vm->stack_size = config->stack_size;
+        vm->data_size  = config->data_size;
+        vm->call_size  = config->call_size;
+
         vm->pc     = 0;                                                     // Initialize program counter
         vm->sp     = -1;                                                    // Initialize stack pointer
-        vm->memory = (void *)malloc(STACK_MEMORY_SIZE * sizeof(uint32_t));  // Allocate memory
+        vm->memory = memory;                                                // Stack and data segments
+        vm->mapping = 0;                                                    // Allocated, not mapped
+        vm->stack  = vm->memory ? (cell_t *)(vm->memory) + STACK_GUARD : NULL;   // Operand stack segment
+        vm->data_segment = vm->memory ? vm->stack + vm->stack_size : NULL;  // Data segment follows the stack
+        vm->frames = frames;                                                // Call stack
+        vm->calls  = 0;                                                     // No frames yet
+        vm->fp     = 0;                                                     // Locals start at the bottom of the stack
+        vm->high   = 0;                                                     // Nothing written yet
         vm->type   = 0;                                                     // Instruction data type
         vm->data   = 0;                                                     // Instruction data register
         vm->state  = STATE_RESET;                                           // Set initial state
+        vm->error  = ERROR_NONE;                                            // No error yet
+        vm->flags  = 0;                                                     // Clear the flag register
         vm->stage  = NULL;                                                  // Set initial stage to STATE_RESET
+        vm->code   = NULL;                                                  // No program loaded yet
+        vm->size   = 0;
+        vm->program = NULL;
+        vm->owns_program = false;
+        vm->engine = ENGINE_STAGED;                                         // Default execution engine
+        vm->threaded = NULL;                                                // No threaded code yet
+        vm->counted = NULL;
+        vm->lanes  = NULL;                                                  // No batch vectorized yet
+        vm->lane_slots = 0;
+        vm->trace  = NULL;                                                  // Tracing is off
+        vm->profile = NULL;                                                 // Profiling is off
+        vm->metrics = NULL;                                                 // Runs are not counted
+        vm->retired = 0;                                                    // Nothing ran yet
+        vm->peak   = 0;
+        vm->slab   = NULL;                                                  // Not recycled
+        vm->in     = NULL;                                                  // No channels attached
+        vm->out    = NULL;
         return;
 }
 
 void stackvm_free(stackvm_t *vm)
 {
-        if (vm->memory)
+        if (!vm)
         {
-                free(vm->memory);                                           // Free allocated memory
-                vm->memory = NULL;                                          // Set pointer to NULL after freeing
+                return;                                                     // Nothing to free
         }
-        if (vm)
+        threaded_free(vm);                                                  // Free the threaded code
+        vector_free(vm);                                                    // Free the lane stack
+        if (vm->owns_program)
         {
-                free(vm);                                                  // Free the VM context
-                vm = NULL;                                                 // Set pointer to NULL after freeing
+                program_free(vm->program);                                  // Free the program loaded by load_program
         }
+        trace_close(vm->trace);                                             // Flush and free the trace sink
+        vm->trace = NULL;
+        profile_close(vm->profile);                                         // Free the instruction profile
+        vm->profile = NULL;
+        free(vm->metrics);                                                  // Free the runtime counters
+        vm->metrics = NULL;
+        if (vm->slab)
+        {
+                slab_release(vm->slab, vm);                                 // Recycle the context, its segments belong to the slab
+                return;
+        }
+        if (vm->mapping)
+        {
+                munmap(vm->memory, vm->mapping);                            // Drop the private pages of the snapshot mapping
+                vm->memory = NULL;
+        }
+        else if (vm->memory)
+        {
+                free(vm->memory);                                           // Free allocated memory
+                vm->memory = NULL;                                          // Set pointer to NULL after freeing
+        }
+        free(vm->frames);                                                   // Free the call stack
+        vm->frames = NULL;
+        free(vm);                                                           // Free the VM context
         return;
 }
 
 void stackvm_reset(stackvm_t *vm)
 {
         vm->pc     = 0;                                                 // Reset program counter
-        vm->sp     = -1;                                                // Reset stack pointer
         vm->type   = 0;                                                 // Reset instruction type
         vm->data   = 0;                                                 // Reset data register
         vm->state  = STATE_RESET;                                       // Reset state function pointer to START
+        vm->error  = ERROR_NONE;                                        // Reset error
+        vm->flags  = 0;                                                 // Reset flag register
+        vm->calls  = 0;                                                 // Drop every frame
+        vm->fp     = 0;                                                 // Reset frame pointer
         vm->stage  = NULL;                                              // Reset stage to STATE_RESET
-        memset(vm->memory, 0, STACK_MEMORY_SIZE * sizeof(uint32_t));    // Clear memory
+        uint32_t used = (vm->sp + 1 > vm->high) ? vm->sp + 1 : vm->high; // The host may have pushed without running
+        memset(vm->memory, 0, (STACK_GUARD + (size_t)used) * sizeof(cell_t)); // Clear the guard and the used stack cells
+        vm->sp     = -1;                                                // Reset stack pointer
+        vm->high   = 0;                                                 // Every cell is clear again
+        return;
+}
+
+void stackvm_set_engine(stackvm_t *vm, engine_t engine)
+{
+        vm->engine = (engine < ENGINE_COUNT) ? engine : ENGINE_STAGED;
+        return;
+}
+
+const char *stackvm_engine_name(engine_t engine)
+{
+        return (engine < ENGINE_COUNT) ? engines[engine].name : NULL;
+}
+
+int stackvm_trace(stackvm_t *vm, trace_level_t level, FILE *out)
+{
+#if STACKVM_TRACE
+        trace_close(vm->trace);                                         // Flush and drop the previous trace sink
+        vm->trace = trace_open(level, out);
+        if (level != TRACE_OFF && !vm->trace)
+        {
+                fprintf(stderr, "Error: Failed to open the trace\n");
+                return -1;
+        }
+        threaded_free(vm);                                              // Threaded code is specialized for the trace level
+        return 0;
+#else
+        if (level != TRACE_OFF)
+        {
+                fprintf(stderr, "Error: Tracing is disabled at compile time\n");
+                return -1;
+        }
+        return 0;
+#endif
+}
+
+int stackvm_profile(stackvm_t *vm, bool enable)
+{
+#if STACKVM_TRACE
+        profile_close(vm->profile);                                     // Drop the previous profile
+        vm->profile = enable ? profile_open(vm->code, vm->size) : NULL;
+        if (enable && !vm->profile)
+        {
+                fprintf(stderr, "Error: Failed to open the profile\n");
+                return -1;
+        }
+        return 0;
+#else
+        if (enable)
+        {
+                fprintf(stderr, "Error: Profiling is disabled at compile time\n");
+                return -1;
+        }
+        return 0;
+#endif
+}
+
+int stackvm_metrics(stackvm_t *vm, bool enable)
+{
+#if STACKVM_METRICS
+        free(vm->metrics);                                              // Drop the previous counters
+        vm->metrics = enable ? calloc(1, sizeof(metrics_t)) : NULL;
+        if (enable && !vm->metrics)
+        {
+                fprintf(stderr, "Error: Failed to allocate the metrics\n");
+                return -1;
+        }
+        return 0;
+#else
+        if (enable)
+        {
+                fprintf(stderr, "Error: Metrics are disabled at compile time\n");
+                return -1;
+        }
+        return 0;
+#endif
+}
+
+void stackvm_channels(stackvm_t *vm, struct channel *in, struct channel *out)
+{
+        vm->in  = in;
+        vm->out = out;
+        return;
+}
+
+static const opcode_info_t opcodes[] =
+{
+        //        name    pops pushes target operands
+        [HALT] = { "halt", 0,   0,     false, 0 },
+        [ADD]  = { "add",  2,   1,     false, 0 },
+        [SUB]  = { "sub",  2,   1,     false, 0 },
+        [MUL]  = { "mul",  2,   1,     false, 0 },
+        [DIV]  = { "div",  2,   1,     false, 0 },
+        [AND]  = { "and",  2,   1,     false, 0 },
+        [OR]   = { "or",   2,   1,     false, 0 },
+        [NOT]  = { "not",  1,   1,     false, 0 },
+        [XOR]  = { "xor",  2,   1,     false, 0 },
+        [LT]   = { "lt",   2,   1,     false, 0 },
+        [GT]   = { "gt",   2,   1,     false, 0 },
+        [LE]   = { "le",   2,   1,     false, 0 },
+        [GE]   = { "ge",   2,   1,     false, 0 },
+        [EQ]   = { "eq",   2,   1,     false, 0 },
+        [NE]   = { "ne",   2,   1,     false, 0 },
+        [BR]   = { "br",   0,   0,     true,  1 },
+        [BRT]  = { "brt",  1,   0,     true,  1 },
+        [BRF]  = { "brf",  1,   0,     true,  1 },
+        [RET]  = { "ret",  0,   0,     false, 0 },
+        [LIT]  = { "lit",  0,   1,     false, 2 },
+        [CMP]  = { "cmp",  2,   0,     false, 0 },
+        [BRZ]  = { "brz",  0,   0,     true,  1 },
+        [BRNZ] = { "brnz", 0,   0,     true,  1 },
+        [BRLT] = { "brlt", 0,   0,     true,  1 },
+        [BRGE] = { "brge", 0,   0,     true,  1 },
+        [BRGT] = { "brgt", 0,   0,     true,  1 },
+        [BRLE] = { "brle", 0,   0,     true,  1 },
+        [CALL] = { "call", 0,   0,     true,  1 },
+        [LOAD_LOCAL]  = { "load_local",  0, 1, false, 1 },
+        [STORE_LOCAL] = { "store_local", 1, 0, false, 1 },
+        [IN]   = { "in",   0,   1,     false, 0 },
+        [OUT]  = { "out",  1,   0,     false, 0 },
+        [CALL_NATIVE] = { "call_native", 0, 0, false, 1 },     // The stack effect is the one of the native function
+};
+
+const opcode_info_t *stackvm_opcode_info(uint32_t opcode)
+{
+        return (opcode < sizeof(opcodes) / sizeof(opcodes[0])) ? &opcodes[opcode] : NULL;
+}
+
+const char *stackvm_opcode_name(uint32_t opcode)
+{
+        const opcode_info_t *info = stackvm_opcode_info(opcode);
+        return info ? info->name : NULL;
+}
+
+const char *stackvm_error_message(vm_error_t error)
+{
+        static const char *const messages[ERROR_COUNT] =
+        {
+                [ERROR_NONE]                    = "No error",
+                [ERROR_DIVISION_BY_ZERO]        = "Division by zero",
+                [ERROR_UNDEFINED_PRIMITIVE]     = "Undefined primitive instruction encountered",
+                [ERROR_UNDEFINED_INSTRUCTION]   = "Undefined instruction encountered",
+                [ERROR_STACK_UNDERFLOW]         = "Stack underflow",
+                [ERROR_STACK_OVERFLOW]          = "Stack overflow",
+                [ERROR_INVALID_ADDRESS]         = "Program counter out of bounds",
+                [ERROR_INVALID_STAGE]           = "Invalid stage function pointer",
+                [ERROR_NO_PROGRAM]              = "No program loaded",
+                [ERROR_CALL_OVERFLOW]           = "Call stack overflow",
+                [ERROR_CALL_UNDERFLOW]          = "Return without a call",
+                [ERROR_INVALID_LOCAL]           = "Local slot outside the stack",
+                [ERROR_NO_CHANNEL]              = "No channel attached",
+                [ERROR_UNDEFINED_NATIVE]        = "Undefined native function",
+                [ERROR_NATIVE_FAILED]           = "Native function failed",
+                [ERROR_OUT_OF_MEMORY]           = "Out of memory",
+        };
+        return (error < ERROR_COUNT) ? messages[error] : "Unknown error";
+}
+
+void stackvm_fault(stackvm_t *vm, vm_error_t error)
+{
+        fprintf(stderr, "Error: %s\n", stackvm_error_message(error));
+        vm->error = error;                                              // Remember why the VM halted
+        vm->state = STATE_HALT;                                         // Set state to HALT on every error
+        return;
+}
+
+/**
+ * @brief Raises the stack high-water mark to the deepest stack a run can reach
+ * @param vm Pointer to the StackVM context
+ * @return void
+ * @note Verified programs entered like an unchecked run stay within the depth recorded by the verifier
+ *       on every engine, a resumed run within the mark of the run it continues, and any other run
+ *       may fill the whole stack. Only the counted engine variants track the stack depth.
+ */
+static void stackvm_mark(stackvm_t *vm)
+{
+        uint32_t high = vm->stack_size;
+        if (vm->state == STATE_PAUSED)
+        {
+                high = vm->sp + 1;
+        }
+        else if (vm->program && stackvm_unchecked(vm))
+        {
+                high = vm->sp + 1 + vm->program->max_depth;
+        }
+        vm->high = (high > vm->high) ? high : vm->high;
         return;
 }
 
 void stackvm_run(stackvm_t *vm)
 {
+        vm->error   = ERROR_NONE;                                       // Forget the error of the previous run
+        vm->retired = 0;
+        vm->peak    = vm->sp + 1;                                       // Stack depth on entry
+        stackvm_mark(vm);                                               // Cells the run may write
+#if STACKVM_METRICS
+        uint64_t start = vm->metrics ? metrics_begin() : 0;
+#endif
+        engines[vm->engine].run(vm);                                    // Run the program on the selected engine
+#if STACKVM_METRICS
+        if (vm->metrics)
+        {
+                metrics_end(vm, start);                                 // Count the run in the context and the process
+        }
+#endif
+#if STACKVM_TRACE
+        if (vm->trace)
+        {
+                trace_flush(vm->trace);                                 // Write the buffered trace records
+        }
+        if (vm->profile && vm->state != STATE_PAUSED)
+        {
+                profile_end(vm->profile);                               // Count the branch that ended the run, a waiting run has not ended
+        }
+#endif
+        return;
+}
+
+run_status_t stackvm_run_for(stackvm_t *vm, uint64_t max_instructions)
+{
+        vm->error   = ERROR_NONE;                                       // Forget the error of the previous run
+        vm->retired = 0;
+        vm->peak    = vm->sp + 1;                                       // Stack depth on entry
+        stackvm_mark(vm);                                               // Cells the run may write
+#if STACKVM_METRICS
+        uint64_t start = vm->metrics ? metrics_begin() : 0;
+#endif
+        engines[vm->engine].run_for(vm, max_instructions);              // Run a slice on the selected engine
+#if STACKVM_METRICS
+        if (vm->metrics)
+        {
+                metrics_end(vm, start);                                 // Count the run in the context and the process
+        }
+#endif
+#if STACKVM_TRACE
+        if (vm->trace)
+        {
+                trace_flush(vm->trace);                                 // Write the buffered trace records
+        }
+        if (vm->profile && vm->state != STATE_PAUSED)
+        {
+                profile_end(vm->profile);                               // A paused run has not ended, its last branch is counted on resume
+        }
+#endif
+        if (vm->state == STATE_PAUSED)
+        {
+                return RUN_PAUSED;
+        }
+        return (vm->error == ERROR_NONE) ? RUN_HALTED : RUN_FAULTED;
+}
+
+static void stackvm_run_staged(stackvm_t *vm)
+{
+        stackvm_run_staged_for(vm, UINT64_MAX);                         // Never runs out
+        return;
+}
+
+#if STACKVM_METRICS
+/**
+ * @brief Staged loop of the counted runs
+ * @param vm Pointer to the StackVM context
+ * @param budget Instructions the run may fetch
+ * @return void
+ * @note Same loop as `stackvm_run_staged_for`, every fetch also retires an instruction and raises
+ *       the peak stack depth to the depth the instruction starts with.
+ */
+static void stackvm_run_staged_counted(stackvm_t *vm, uint64_t budget)
+{
+        const stage_t *instruction_stage = base_instruction_stage;     // Stages of the quiet fast path
+#if STACKVM_TRACE
+        if (stackvm_hooked(vm))
+        {
+                instruction_stage = traced_instruction_stage;           // Trace level is chosen once per run
+        }
+#endif
+        size_t instruction_stage_counter = 0;                          // Stage counter of this run
+        uint64_t retired = 0;                                           // Instructions fetched by this run
+        uint32_t peak    = vm->sp + 1;                                  // Deepest stack fetched with
         vm->pc--;                                                       // Decrement program counter to start from the first instruction
         vm->state = STATE_RUN;                                          // Set the VM state to RUN
         vm->stage = instruction_stage[instruction_stage_counter++];     // Set the initial stage to fetch
-        while (vm->state != STATE_HALT)
+        while (vm->state == STATE_RUN)
         {
+                if (vm->stage == fetch_instruction)
+                {
+                        if (budget-- == 0)
+                        {
+                                vm->pc++;                               // Resumable at the next instruction
+                                vm->state = STATE_PAUSED;
+                                break;
+                        }
+                        retired++;
+                        peak = (vm->sp + 1 > peak) ? vm->sp + 1 : peak;
+                }
+                if (vm->stage)
+                {
+                        vm->stage(vm);
+                        vm->stage = instruction_stage[
+                                instruction_stage_counter++
+                                % (sizeof(base_instruction_stage) / sizeof(base_instruction_stage[0]))
+                        ]; // Move to the next stage
+                }
+                else
+                {
+                        stackvm_fault(vm, ERROR_INVALID_STAGE); // Set state to HALT if stage function pointer is invalid
+                        break; // Exit the loop if stage function pointer is invalid
+                }
+        }
+        vm->retired = retired;
+        vm->peak    = peak;
+        return;
+}
+#endif
+
+static void stackvm_run_staged_for(stackvm_t *vm, uint64_t budget)
+{
+#if STACKVM_METRICS
+        if (stackvm_counted(vm))
+        {
+                stackvm_run_staged_counted(vm, budget);                 // Counting is chosen once per run
+                return;
+        }
+#endif
+        const stage_t *instruction_stage = base_instruction_stage;     // Stages of the quiet fast path
+#if STACKVM_TRACE
+        if (stackvm_hooked(vm))
+        {
+                instruction_stage = traced_instruction_stage;           // Trace level is chosen once per run
+        }
+#endif
+        size_t instruction_stage_counter = 0;                          // Stage counter of this run
+        vm->pc--;                                                       // Decrement program counter to start from the first instruction
+        vm->state = STATE_RUN;                                          // Set the VM state to RUN
+        vm->stage = instruction_stage[instruction_stage_counter++];     // Set the initial stage to fetch
+        while (vm->state == STATE_RUN)
+        {
+                if (vm->stage == fetch_instruction && budget-- == 0)
+                {
+                        vm->pc++;                                       // Resumable at the next instruction
+                        vm->state = STATE_PAUSED;
+                        break;
+                }
                 if (vm->stage)
                 {
                         vm->stage(vm);
                         vm->stage = instruction_stage[
-                                instruction_stage_counter++ 
-                                % (sizeof(instruction_stage) / sizeof(instruction_stage[0]))
+                                instruction_stage_counter++
+                                % (sizeof(base_instruction_stage) / sizeof(base_instruction_stage[0]))
                         ]; // Move to the next stage
                 }
                 else
                 {
-                        fprintf(stderr, "Error: Invalid stage function pointer\n");
-                        vm->state = STATE_HALT; // Set state to HALT if stage function pointer is invalid
+                        stackvm_fault(vm, ERROR_INVALID_STAGE); // Set state to HALT if stage function pointer is invalid
                         break; // Exit the loop if stage function pointer is invalid
                 }
         }
         return;
 }
 
-void load_program(void *program, size_t size)
+void load_program(stackvm_t *vm, void *program, size_t size)
 {
         if (!program || !vm || !vm->memory)
         {
                 fprintf(stderr, "Error: Invalid program or VM context\n");
                 return; // Return if the program or VM context is invalid
         }
+        if (size > vm->code_size)
+        {
+                fprintf(stderr, "Error: Program of %zu words exceeds the code segment of %u words\n", size, vm->code_size);
+                return; // Return if the program does not fit into the code segment
+        }
+
+        // Load the program into a read-only code segment owned by the context
+        program_t *loaded = program_create((const uint32_t *)program, size);
+        if (!loaded)
+        {
+                fprintf(stderr, "Error: Failed to load the program\n");
+                return;
+        }
+        attach_program(vm, loaded);
+        vm->owns_program = true;
+        fprintf(stdout, "Loaded program of size %zu words...\n", size);
+        if (loaded->removed)
+        {
+                fprintf(stdout, "Optimizer removed %u instructions...\n", loaded->removed);
+        }
+}
 
-        // Load the program into the VM memory
-        for (size_t i = 0; i < size; i++)
+void attach_program(stackvm_t *vm, program_t *program)
+{
+        threaded_free(vm);                                              // Traced code of the previous program is stale
+        if (vm->owns_program && vm->program != program)
+        {
+                program_free(vm->program);                              // Release the program loaded by load_program
+        }
+        vm->program      = program;
+        vm->owns_program = false;
+        vm->code         = program ? program->code : NULL;
+        vm->size         = program ? program->size : 0;
+        vm->pc           = 0;                                           // Start at the first instruction
+        if (vm->profile && profile_bind(vm->profile, vm->code, vm->size) != 0)
         {
-                ((uint32_t *)(vm->memory))[vm->pc + i] = ((uint32_t *)program)[i];
+                fprintf(stderr, "Error: Failed to profile the program, profiling is off\n");
+                profile_close(vm->profile);                             // Counters of another program must not be bumped
+                vm->profile = NULL;
         }
-        fprintf(stdout, "Loaded program of size %zd bytes...\n", size);
+        return;
 }
 
 void fetch_instruction(stackvm_t *vm)
@@ -125,18 +615,66 @@ void fetch_instruction(stackvm_t *vm)
 
 void decode_instruction(stackvm_t *vm)
 {
-        uint32_t instruction = ((uint32_t *)(vm->memory))[vm->pc];               // Fetch the instruction from memory
+        if (vm->pc >= vm->size)
+        {
+                stackvm_fault(vm, vm->program ? ERROR_INVALID_ADDRESS : ERROR_NO_PROGRAM); // The program counter left the program
+                return;
+        }
+        uint32_t instruction = vm->code[vm->pc];                                 // Fetch the instruction from the code segment
         vm->type             = GET_TYPE(instruction);                            // Decode the type of instruction
         vm->data             = GET_DATA(instruction);                            // Decode the data of instruction
         return;
 }
 
+/**
+ * @brief Returns the target address of the branch instruction at the program counter
+ * @param vm Pointer to the StackVM context
+ * @return Target address, or the program size if the target word is missing
+ */
+static uint32_t branch_target(stackvm_t *vm)
+{
+        if (vm->pc + 1 >= vm->size)
+        {
+                return vm->size; // Missing target word, branch out of the program
+        }
+        return vm->code[vm->pc + 1];
+}
+
+#if STACKVM_TRACE
+/**
+ * @brief Records the decoded instruction in the trace and executes it
+ * @param vm Pointer to the StackVM context
+ * @return void
+ */
+static void execute_traced(stackvm_t *vm)
+{
+        stackvm_hook(vm, vm->code, vm->size, vm->pc, vm->stack, vm->sp);
+        execute_instruction(vm);
+        return;
+}
+#endif
+
 void execute_instruction(stackvm_t *vm)
 {
+        // The staged engine is fully checked, stack accesses never leave the stack segment
+        uint32_t depth = vm->sp + 1;
+        if (vm->type == PRIMITIVE_INSTRUCTION && vm->data < sizeof(opcodes) / sizeof(opcodes[0]))
+        {
+                if (depth < opcodes[vm->data].pops)
+                {
+                        stackvm_fault(vm, ERROR_STACK_UNDERFLOW);
+                        return;
+                }
+        }
         if (vm->type == POSITIVE_INTEGER || vm->type == NEGATIVE_INTEGER)
         {
+                if (depth >= vm->stack_size)
+                {
+                        stackvm_fault(vm, ERROR_STACK_OVERFLOW);
+                        return;
+                }
                 vm->sp++; // Increment stack pointer after pushing data
-                ((uint32_t *)(vm->memory))[vm->sp] = vm->data; // Push data onto the stack
+                vm->stack[vm->sp] = GET_IMMEDIATE(vm->code[vm->pc]); // Push the sign-extended data onto the stack
                 
         }
         else if (vm->type == PRIMITIVE_INSTRUCTION)
@@ -144,185 +682,334 @@ void execute_instruction(stackvm_t *vm)
                 switch (vm->data)
                 {
                 case HALT:
-                        fprintf(stdout, "Halting the VM\n");
                         vm->state = STATE_HALT; // Set state to HALT
                         break;
                 case ADD:
-                        fprintf(stdout, "add %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] += ((uint32_t *)(vm->memory))[vm->sp];
+                        vm->flags = cell_flags(ADD, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        vm->stack[vm->sp - 1] = cell_add(vm->stack[vm->sp - 1], vm->stack[vm->sp]);
                         vm->sp--; // Pop the stack after operation
                         break;
                 case SUB:
-                        fprintf(stdout, "sub %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp - 1) -= *(uint32_t *)(vm->memory + vm->sp);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] -= ((uint32_t *)(vm->memory))[vm->sp];
+                        vm->flags = cell_flags(SUB, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        // vm->stack[vm->sp - 1] -= vm->stack[vm->sp];
+                        vm->stack[vm->sp - 1] = cell_sub(vm->stack[vm->sp - 1], vm->stack[vm->sp]);
                         vm->sp--; // Pop the stack after operation
                         break;
                 case MUL:
-                        fprintf(stdout, "mul %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp - 1) *= *(uint32_t *)(vm->memory + vm->sp);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] *= ((uint32_t *)(vm->memory))[vm->sp];
+                        vm->flags = cell_flags(MUL, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        // vm->stack[vm->sp - 1] *= vm->stack[vm->sp];
+                        vm->stack[vm->sp - 1] = cell_mul(vm->stack[vm->sp - 1], vm->stack[vm->sp]);
                         vm->sp--; // Pop the stack after operation
                         break;
                 case DIV:
-                        fprintf(stdout, "div %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp] != 0)
+                        if (vm->stack[vm->sp] != 0)
                         {
-                                // *(uint32_t *)(vm->memory + vm->sp - 1) /= *(uint32_t *)(vm->memory + vm->sp);
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] /= ((uint32_t *)(vm->memory))[vm->sp];
+                                // vm->stack[vm->sp - 1] /= vm->stack[vm->sp];
+                                vm->flags = cell_flags(DIV, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                                vm->stack[vm->sp - 1] = cell_div(vm->stack[vm->sp - 1], vm->stack[vm->sp]);
                                 vm->sp--; // Pop the stack after operation
                         }
                         else
                         {                                // Handle division by zero
-                                fprintf(stderr, "Error: Division by zero\n");
-                                vm->state = STATE_HALT; // Set state to HALT if division by zero occurs
+                                stackvm_fault(vm, ERROR_DIVISION_BY_ZERO); // Set state to HALT if division by zero occurs
                         }
                         break;
                 case AND:
-                        fprintf(stdout, "and %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp - 1) &= *(uint32_t *)(vm->memory + vm->sp);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] &= ((uint32_t *)(vm->memory))[vm->sp];
+                        // vm->stack[vm->sp - 1] &= vm->stack[vm->sp];
+                        vm->stack[vm->sp - 1] &= vm->stack[vm->sp];
                         vm->sp--; // Pop the stack after operation
                         break;
                 case OR:
-                        fprintf(stdout, "or %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp - 1) |= *(uint32_t *)(vm->memory + vm->sp);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] |= ((uint32_t *)(vm->memory))[vm->sp];
+                        // vm->stack[vm->sp - 1] |= vm->stack[vm->sp];
+                        vm->stack[vm->sp - 1] |= vm->stack[vm->sp];
                         vm->sp--; // Pop the stack after operation
                         break;
                 case NOT:
-                        fprintf(stdout, "not %d\n", ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp) = ~(*(uint32_t *)(vm->memory + vm->sp));
-                        ((uint32_t *)(vm->memory))[vm->sp] = ~((uint32_t *)(vm->memory))[vm->sp];
+                        // vm->stack[vm->sp] = ~(vm->stack[vm->sp]);
+                        vm->stack[vm->sp] = ~vm->stack[vm->sp];
                         break;
                 case XOR:
-                        fprintf(stdout, "xor %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        // *(uint32_t *)(vm->memory + vm->sp - 1) ^= *(uint32_t *)(vm->memory + vm->sp);
-                        ((uint32_t *)(vm->memory))[vm->sp - 1] ^= ((uint32_t *)(vm->memory))[vm->sp];
+                        // vm->stack[vm->sp - 1] ^= vm->stack[vm->sp];
+                        vm->stack[vm->sp - 1] ^= vm->stack[vm->sp];
                         vm->sp--; // Pop the stack after operation
                         break;
                 case LT:
-                        fprintf(stdout, "lt %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
                         // Compare the top two elements of the stack for less than
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] <
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(LT, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] <
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
                 
                 case LE:
-                        fprintf(stdout, "le %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] <=
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(LE, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] <=
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
-                        {                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                        {                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
                 case GT:
-                        fprintf(stdout, "gt %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] >
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(GT, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] >
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
                 case GE:
-                        fprintf(stdout, "ge %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] >=
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(GE, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] >=
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
                 case EQ:
-                        fprintf(stdout, "eq %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] ==
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(EQ, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] ==
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
                 case NE:
-                        fprintf(stdout, "ne %d, %d\n", ((uint32_t *)(vm->memory))[vm->sp - 1], ((uint32_t *)(vm->memory))[vm->sp]);
-                        if (((uint32_t *)(vm->memory))[vm->sp - 1] !=
-                            ((uint32_t *)(vm->memory))[vm->sp])
+                        vm->flags = cell_flags(NE, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the operands
+                        if (vm->stack[vm->sp - 1] !=
+                            vm->stack[vm->sp])
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 1; // Set to true
+                                vm->stack[vm->sp - 1] = 1; // Set to true
                         }
                         else
                         {
-                                ((uint32_t *)(vm->memory))[vm->sp - 1] = 0; // Set to false
+                                vm->stack[vm->sp - 1] = 0; // Set to false
                         }
                         vm->sp--; // Pop the stack after operation
                         break;
+                case CMP:
+                        vm->flags = cell_flags(CMP, vm->stack[vm->sp - 1], vm->stack[vm->sp]); // Set the flags from the difference
+                        vm->sp -= 2; // Pop both operands
+                        break;
+                case BRZ:
+                case BRNZ:
+                case BRLT:
+                case BRGE:
+                case BRGT:
+                case BRLE:
+                        // Flag branch logic, the stack is left alone
+                        if (flag_taken(vm->data, vm->flags))
+                        {
+                                vm->pc = branch_target(vm) - 1; // Set program counter before the target address if taken
+                        }
+                        else
+                        {
+                                vm->pc++; // Skip the branch target word
+                        }
+                        break;
                 case BR:
-                        fprintf(stdout, "br %d\n", vm->data);
                         // Branch instruction logic, modifies the program counter
-                        vm->pc = vm->data; // Set program counter to the target address
+                        vm->pc = branch_target(vm) - 1; // Set program counter before the target address
                         break;
                 case BRT:
-                        fprintf(stdout, "brt %d\n", vm->data);
                         // Branch if true logic, checks the top of the stack
-                        if (((uint32_t *)(vm->memory))[vm->sp] != 0)
+                        if (vm->stack[vm->sp] != 0)
+                        {
+                                vm->pc = branch_target(vm) - 1; // Set program counter before the target address if true
+                        }
+                        else
                         {
-                                vm->pc = vm->data; // Set program counter to the target address if true
+                                vm->pc++; // Skip the branch target word
                         }
                         vm->sp--; // Pop the stack after checking
                         break;
                 case BRF:
-                        fprintf(stdout, "brf %d\n", vm->data);
                         // Branch if false logic, checks the top of the stack
-                        if (((uint32_t *)(vm->memory))[vm->sp] == 0)
+                        if (vm->stack[vm->sp] == 0)
                         {
-                                vm->pc = vm->data; // Set program counter to the target address if false
+                                vm->pc = branch_target(vm) - 1; // Set program counter before the target address if false
+                        }
+                        else
+                        {
+                                vm->pc++; // Skip the branch target word
                         }
                         vm->sp--; // Pop the stack after checking
                         break;
                 case RET:
-                        fprintf(stdout, "ret\n");
-                        // Return instruction logic, pops the return address from the stack
-                        if (vm->sp > 0)
+                        // Return instruction logic, pops the frame pushed by CALL
+                        if (vm->calls == 0)
+                        {
+                                stackvm_fault(vm, ERROR_CALL_UNDERFLOW);
+                                return;
+                        }
+                        vm->calls--;
+                        vm->pc = vm->frames[vm->calls].ret - 1; // Set program counter before the return address
+                        vm->fp = vm->frames[vm->calls].fp;      // Restore the frame of the caller
+                        break;
+                case CALL:
+                        // Call instruction logic, pushes a frame and starts the locals at the top of stack
+                        if (vm->calls >= vm->call_size)
+                        {
+                                stackvm_fault(vm, ERROR_CALL_OVERFLOW);
+                                return;
+                        }
+                        vm->frames[vm->calls++] = (frame_t){ .ret = vm->pc + 2, .fp = vm->fp };
+                        vm->fp = depth;                         // Local slot 0 is the first value pushed by the callee
+                        vm->pc = branch_target(vm) - 1;         // Set program counter before the target address
+                        break;
+                case LOAD_LOCAL:
+                case STORE_LOCAL:
+                {
+                        // Local slot logic, the slot must lie below the top of stack
+                        if (vm->pc + 1 >= vm->size)
+                        {
+                                stackvm_fault(vm, ERROR_INVALID_ADDRESS); // Missing operand word
+                                return;
+                        }
+                        int64_t slot = (int64_t)vm->fp + (int32_t)vm->code[vm->pc + 1];
+                        if (slot < 0 || slot >= (int64_t)depth - (vm->data == STORE_LOCAL))
+                        {
+                                stackvm_fault(vm, ERROR_INVALID_LOCAL);
+                                return;
+                        }
+                        if (vm->data == LOAD_LOCAL)
+                        {
+                                if (depth >= vm->stack_size)
+                                {
+                                        stackvm_fault(vm, ERROR_STACK_OVERFLOW);
+                                        return;
+                                }
+                                vm->sp++;
+                                vm->stack[vm->sp] = vm->stack[slot];
+                        }
+                        else
+                        {
+                                vm->stack[slot] = vm->stack[vm->sp];
+                                vm->sp--; // Pop the stored value
+                        }
+                        vm->pc++; // Skip the operand word
+                        break;
+                }
+                case LIT:
+                        if (vm->pc + 2 >= vm->size)
+                        {
+                                stackvm_fault(vm, ERROR_INVALID_ADDRESS); // Missing operand words
+                                return;
+                        }
+                        if (depth >= vm->stack_size)
+                        {
+                                stackvm_fault(vm, ERROR_STACK_OVERFLOW);
+                                return;
+                        }
+                        vm->sp++;
+                        vm->stack[vm->sp] = GET_WIDE(vm->code[vm->pc + 1], vm->code[vm->pc + 2]);
+                        vm->pc += 2; // Skip the operand words
+                        break;
+                case IN:
+                {
+                        if (depth >= vm->stack_size)
+                        {
+                                stackvm_fault(vm, ERROR_STACK_OVERFLOW);
+                                return;
+                        }
+                        if (!vm->in)
+                        {
+                                stackvm_fault(vm, ERROR_NO_CHANNEL);
+                                return;
+                        }
+                        channel_status_t status = channel_get(vm->in, &vm->stack[vm->sp + 1]);
+                        if (status == CHANNEL_OK)
+                        {
+                                vm->sp++;
+                        }
+                        else
+                        {
+                                // Wait on the IN for the host to refill the channel, or end the program with the stream
+                                vm->state = (status == CHANNEL_BLOCKED) ? STATE_PAUSED : STATE_HALT;
+                        }
+                        break;
+                }
+                case OUT:
+                        if (!vm->out)
+                        {
+                                stackvm_fault(vm, ERROR_NO_CHANNEL);
+                                return;
+                        }
+                        if (channel_put(vm->out, vm->stack[vm->sp]) == CHANNEL_OK)
                         {
-                                vm->pc = *((uint32_t *)(vm->memory + vm->sp)); // Set program counter to the return address
-                                vm->sp--; // Pop the return address from the stack
+                                vm->sp--; // Pop the written value
                         }
+                        else
+                        {
+                                vm->state = STATE_PAUSED; // Wait on the OUT for the host to drain the channel
+                        }
+                        break;
+                case CALL_NATIVE:
+                {
+                        // Native call logic, the function replaces its arguments with its results in place
+                        if (vm->pc + 1 >= vm->size)
+                        {
+                                stackvm_fault(vm, ERROR_INVALID_ADDRESS); // Missing operand word
+                                return;
+                        }
+                        const native_t *native = native_get(vm->code[vm->pc + 1]);
+                        if (!native)
+                        {
+                                stackvm_fault(vm, ERROR_UNDEFINED_NATIVE);
+                                return;
+                        }
+                        if (depth < native->arity)
+                        {
+                                stackvm_fault(vm, ERROR_STACK_UNDERFLOW);
+                                return;
+                        }
+                        if ((uint64_t)depth - native->arity + native->results > vm->stack_size)
+                        {
+                                stackvm_fault(vm, ERROR_STACK_OVERFLOW);
+                                return;
+                        }
+                        if (!native->fn(&vm->stack[depth - native->arity], native->data))
+                        {
+                                stackvm_fault(vm, ERROR_NATIVE_FAILED);
+                                return;
+                        }
+                        vm->sp += (uint32_t)native->results - native->arity;
+                        vm->pc++; // Skip the operand word
                         break;
+                }
                 default:
                         // Handle undefined instruction
-                        vm->state = STATE_HALT; // Set state to HALT if an undefined instruction is encountered
-                        fprintf(stderr, "Error: Undefined primitive instruction encountered\n");
+                        stackvm_fault(vm, ERROR_UNDEFINED_PRIMITIVE); // Set state to HALT if an undefined instruction is encountered
                         return;
                 }
         }
         else if (vm->type == UNDEFINED_INSTRUCTION)
         {
-                fprintf(stderr, "Error: Undefined instruction encountered\n");
-                vm->state = STATE_HALT; // Set state to HALT if an undefined instruction is encountered
+                stackvm_fault(vm, ERROR_UNDEFINED_INSTRUCTION); // Set state to HALT if an undefined instruction is encountered
         }
-        fprintf(stdout, "TOP OF STACK: %d\n", ((uint32_t *)(vm->memory))[vm->sp]); // Debug output
 }
@@ -0,0 +1,731 @@
+/***
+ *
+ * @file: threaded.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the direct-threaded execution engine of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "threaded.h"
+#include "channel.h"
+#include "native.h"
+
+static void threaded_dispatch(stackvm_t *vm, const void *const **handler_table, const void *const **checked_table);
+
+const void *const *thread_handlers(bool checked)
+{
+        const void *const *unchecked;
+        const void *const *handlers;
+        threaded_dispatch(NULL, &unchecked, &handlers);
+        return checked ? handlers : unchecked;
+}
+
+struct thread_cache *thread_compile(const uint32_t *program, uint32_t size, bool traced, bool checked)
+{
+        const void *const *handlers = thread_handlers(checked);        // Fetch the handler addresses of the engine
+        const void *trace = traced ? handlers[THREAD_TRACE] : NULL;
+        if (traced && (!trace || !checked))
+        {
+                return NULL;                                            // Tracing is compiled out, traced code is always checked
+        }
+
+        struct thread_cache *cache = malloc(sizeof(*cache) + ((size_t)size + 2) * sizeof(thread_t));
+        if (!cache)
+        {
+                return NULL;
+        }
+        cache->size    = size;
+        cache->traced  = traced;
+        cache->checked = checked;
+        cache->origin  = NULL;                                         // Entries match program words
+        cache->rise    = NULL;
+        cache->source  = NULL;
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+                uint32_t instruction = program[i];
+                uint32_t data        = GET_DATA(instruction);
+                thread_t *entry      = &cache->code[i];
+
+                entry->operand = 0;
+                entry->weight  = 1;
+                switch (GET_TYPE(instruction))
+                {
+                case POSITIVE_INTEGER:
+                case NEGATIVE_INTEGER:
+                        entry->opcode  = THREAD_PUSH;
+                        entry->operand = (uint32_t)GET_IMMEDIATE(instruction);
+                        break;
+                case PRIMITIVE_INSTRUCTION:
+                        if (data >= PRIMITIVE_COUNT)
+                        {
+                                entry->opcode = THREAD_UNDEFINED_PRIMITIVE;
+                                break;
+                        }
+                        entry->opcode = data;
+                        if (stackvm_opcode_info(data)->target)
+                        {
+                                // Targets outside the program resolve to the trailing THREAD_END entry
+                                entry->operand = (i + 1 < size && program[i + 1] < size) ? program[i + 1] : size;
+                        }
+                        if ((data == LOAD_LOCAL || data == STORE_LOCAL || data == CALL_NATIVE) && i + 1 < size)
+                        {
+                                entry->operand = program[i + 1];                // Signed local slot or native index, checked handlers fault when it is missing
+                        }
+                        if (data == LIT)
+                        {
+                                // The operand words are read from the code segment, a LIT missing them leaves the program
+                                entry->opcode  = (i + 2 < size) ? LIT : THREAD_END;
+                                entry->operand = i + 1;
+                        }
+                        break;
+                default:
+                        entry->opcode = THREAD_UNDEFINED_INSTRUCTION;
+                        break;
+                }
+                entry->handler = trace ? trace : handlers[entry->opcode];
+        }
+        // Leaving the program is never traced, a branch in the last word that is not taken skips to the second entry
+        for (uint32_t i = size; i < size + 2; i++)
+        {
+                cache->code[i].handler = handlers[THREAD_END];
+                cache->code[i].operand = 0;
+                cache->code[i].opcode  = THREAD_END;
+                cache->code[i].weight  = 1;                             // The fetch past the end retires like a fault
+        }
+        return cache;
+}
+
+#if STACKVM_METRICS
+/**
+ * @brief Copies threaded code into code counting every entry it dispatches
+ * @param cache Pointer to the threaded code
+ * @return Pointer to the counting copy on success, NULL on failure
+ * @note Every entry of the copy, the trailing THREAD_END entries included, dispatches to the THREAD_COUNT
+ *       handler, which dispatches it again through the handler table of `cache`.
+ */
+static struct thread_cache *thread_count(const struct thread_cache *cache)
+{
+        size_t entries = (size_t)cache->size + 2;                      // Optimized code only has one THREAD_END entry
+        struct thread_cache *copy = malloc(sizeof(*copy) + entries * sizeof(thread_t));
+        uint32_t *origin = cache->origin ? malloc(((size_t)cache->size + 1) * sizeof(uint32_t)) : NULL;
+        uint16_t *rise   = cache->rise ? malloc(((size_t)cache->size + 1) * sizeof(uint16_t)) : NULL;
+        if (!copy || (cache->origin && !origin) || (cache->rise && !rise))
+        {
+                free(copy);
+                free(origin);
+                free(rise);
+                return NULL;
+        }
+        memcpy(copy, cache, sizeof(*copy) + (entries - 1) * sizeof(thread_t));
+        copy->code[entries - 1] = copy->code[entries - 2];
+        if (origin)
+        {
+                memcpy(origin, cache->origin, ((size_t)cache->size + 1) * sizeof(uint32_t));
+        }
+        if (rise)
+        {
+                memcpy(rise, cache->rise, ((size_t)cache->size + 1) * sizeof(uint16_t));
+        }
+        copy->origin = origin;
+        copy->rise   = rise;
+        copy->source = cache;
+        const void *count = thread_handlers(true)[THREAD_COUNT];
+        for (size_t i = 0; i < entries; i++)
+        {
+                copy->code[i].handler = count;
+        }
+        return copy;
+}
+#endif
+
+void thread_cache_free(struct thread_cache *cache)
+{
+        if (cache)
+        {
+                free(cache->origin);
+                free(cache->rise);
+        }
+        free(cache);
+        return;
+}
+
+void threaded_free(stackvm_t *vm)
+{
+        if (vm->threaded)
+        {
+                thread_cache_free(vm->threaded);
+                vm->threaded = NULL;
+        }
+        thread_cache_free(vm->counted);
+        vm->counted = NULL;
+        return;
+}
+
+void stackvm_run_threaded(stackvm_t *vm)
+{
+        threaded_dispatch(vm, NULL, NULL);
+        return;
+}
+
+#define DISPATCH()              goto *ip->handler               // Dispatch the current entry
+#define NEXT()                  do { ip++; DISPATCH(); } while (0) // Dispatch the next entry
+#define JUMP(target)            do { ip = code + (target); DISPATCH(); } while (0)
+#define OPERAND()               ((cell_t)(int32_t)ip->operand)  // Sign-extended operand of a push or an immediate
+#define FLAGS(op, a, b)         do { flag_op = (op); flag_a = (a); flag_b = (b); } while (0) // Remember the flag-setting instruction
+#define BINARY(op)              do { stack[sp - 1] = stack[sp - 1] op stack[sp]; sp--; NEXT(); } while (0)
+#define ARITHMETIC(fn, opcode)  do { FLAGS(opcode, stack[sp - 1], stack[sp]); stack[sp - 1] = fn(stack[sp - 1], stack[sp]); sp--; NEXT(); } while (0)
+#define COMPARE(op)             do { FLAGS(SUB, stack[sp - 1], stack[sp]); stack[sp - 1] = (stack[sp - 1] op stack[sp]) ? 1 : 0; sp--; NEXT(); } while (0)
+#define IMMEDIATE(op)           do { stack[sp] = stack[sp] op OPERAND(); NEXT(); } while (0)
+#define ARITHMETIC_IMMEDIATE(fn, opcode) \
+        do { FLAGS(opcode, stack[sp], OPERAND()); stack[sp] = fn(stack[sp], OPERAND()); NEXT(); } while (0)
+#define COMPARE_IMMEDIATE(op)   do { FLAGS(SUB, stack[sp], OPERAND()); stack[sp] = (stack[sp] op OPERAND()) ? 1 : 0; NEXT(); } while (0)
+#define COMPARE_BRANCH(op, taken) \
+        do { FLAGS(SUB, stack[sp - 1], stack[sp]); bool result = (stack[sp - 1] op stack[sp]); sp -= 2; if (result == (taken)) JUMP(ip->operand); ip++; NEXT(); } while (0)
+#define FLAG_BRANCH(opcode)     do { if (flag_taken((opcode), cell_flags(flag_op, flag_a, flag_b))) JUMP(ip->operand); ip++; NEXT(); } while (0)
+#define FAULT(reason)           do { error = (reason); goto fault; } while (0)
+#define NEED(count)             do { if (sp + 1 < (count)) FAULT(ERROR_STACK_UNDERFLOW); } while (0)
+#define PROGRAM_COUNTER()       (cache->origin ? cache->origin[ip - code] : (uint32_t)(ip - code))
+#define SYNC()                  do { vm->pc = PROGRAM_COUNTER(); vm->sp = sp; vm->flags = cell_flags(flag_op, flag_a, flag_b); RETIRED(); \
+                                     vm->fp = fp; vm->calls = calls; for (uint32_t i = 0; cache->origin && i < calls; i++) \
+                                     frames[i].ret = cache->origin[frames[i].ret]; } while (0) // Write the registers back to the context
+#define SLOT()                  ((int64_t)fp + (int32_t)ip->operand) // Stack cell of the local slot of the entry
+#if STACKVM_METRICS
+#define RETIRED()               do { vm->retired = retired; vm->peak = peak; } while (0) // Write the counts back to the context
+#define DEPTH()                 (sp + 1 + (cache->rise ? cache->rise[ip - code] : 0u)) // Deepest stack of the entry and the pushes it replaced
+#define COUNT()                 do { retired += ip->weight; peak = (DEPTH() > peak) ? DEPTH() : peak; } while (0) // Count the entry
+#else
+#define RETIRED()               ((void)0)
+#endif
+
+/**
+ * @brief Dispatch loop of the threaded engine
+ * @param vm Pointer to the StackVM context, NULL when only the handler tables are requested
+ * @param handler_table Receives the unchecked handler table when not NULL, nothing is executed then
+ * @param checked_table Receives the checked handler table when not NULL
+ * @return void
+ * @note Every checked handler verifies the stack bounds and then falls through into the
+ *       unchecked handler of the same instruction.
+ *       Flag-setting handlers only remember their opcode and operands, the flags are computed
+ *       by the flag branches and written back to the context when the run ends.
+ */
+static void threaded_dispatch(stackvm_t *vm, const void *const **handler_table, const void *const **checked_table)
+{
+        static const void *const handlers[THREAD_HANDLER_COUNT] =
+        {
+                [HALT]                          = &&op_halt,
+                [ADD]                           = &&op_add,
+                [SUB]                           = &&op_sub,
+                [MUL]                           = &&op_mul,
+                [DIV]                           = &&op_div,
+                [AND]                           = &&op_and,
+                [OR]                            = &&op_or,
+                [NOT]                           = &&op_not,
+                [XOR]                           = &&op_xor,
+                [LT]                            = &&op_lt,
+                [GT]                            = &&op_gt,
+                [LE]                            = &&op_le,
+                [GE]                            = &&op_ge,
+                [EQ]                            = &&op_eq,
+                [NE]                            = &&op_ne,
+                [BR]                            = &&op_br,
+                [BRT]                           = &&op_brt,
+                [BRF]                           = &&op_brf,
+                [RET]                           = &&op_ret,
+                [LIT]                           = &&op_lit,
+                [CALL]                          = &&op_call,
+                [LOAD_LOCAL]                    = &&op_load_local,
+                [STORE_LOCAL]                   = &&op_store_local,
+                [IN]                            = &&op_in,
+                [OUT]                           = &&op_out,
+                [CALL_NATIVE]                   = &&op_call_native,
+                [CMP]                           = &&op_cmp,
+                [BRZ]                           = &&op_brz,
+                [BRNZ]                          = &&op_brnz,
+                [BRLT]                          = &&op_brlt,
+                [BRGE]                          = &&op_brge,
+                [BRGT]                          = &&op_brgt,
+                [BRLE]                          = &&op_brle,
+                [THREAD_PUSH]                   = &&op_push,
+                [THREAD_UNDEFINED_PRIMITIVE]    = &&op_undefined_primitive,
+                [THREAD_UNDEFINED_INSTRUCTION]  = &&op_undefined_instruction,
+                [THREAD_END]                    = &&op_end,
+                [THREAD_PUSH_ADD]               = &&op_push_add,
+                [THREAD_PUSH_SUB]               = &&op_push_sub,
+                [THREAD_PUSH_MUL]               = &&op_push_mul,
+                [THREAD_PUSH_DIV]               = &&op_push_div,
+                [THREAD_PUSH_AND]               = &&op_push_and,
+                [THREAD_PUSH_OR]                = &&op_push_or,
+                [THREAD_PUSH_XOR]               = &&op_push_xor,
+                [THREAD_PUSH_LT]                = &&op_push_lt,
+                [THREAD_PUSH_GT]                = &&op_push_gt,
+                [THREAD_PUSH_LE]                = &&op_push_le,
+                [THREAD_PUSH_GE]                = &&op_push_ge,
+                [THREAD_PUSH_EQ]                = &&op_push_eq,
+                [THREAD_PUSH_NE]                = &&op_push_ne,
+                [THREAD_PUSH_CMP]               = &&op_push_cmp,
+                [THREAD_LT_BRF]                 = &&op_lt_brf,
+                [THREAD_GT_BRF]                 = &&op_gt_brf,
+                [THREAD_LE_BRF]                 = &&op_le_brf,
+                [THREAD_GE_BRF]                 = &&op_ge_brf,
+                [THREAD_EQ_BRF]                 = &&op_eq_brf,
+                [THREAD_NE_BRF]                 = &&op_ne_brf,
+                [THREAD_LT_BRT]                 = &&op_lt_brt,
+                [THREAD_GT_BRT]                 = &&op_gt_brt,
+                [THREAD_LE_BRT]                 = &&op_le_brt,
+                [THREAD_GE_BRT]                 = &&op_ge_brt,
+                [THREAD_EQ_BRT]                 = &&op_eq_brt,
+                [THREAD_NE_BRT]                 = &&op_ne_brt,
+        };
+        static const void *const checked[THREAD_HANDLER_COUNT] =
+        {
+                [HALT]                          = &&op_halt,
+                [ADD]                           = &&chk_add,
+                [SUB]                           = &&chk_sub,
+                [MUL]                           = &&chk_mul,
+                [DIV]                           = &&chk_div,
+                [AND]                           = &&chk_and,
+                [OR]                            = &&chk_or,
+                [NOT]                           = &&chk_not,
+                [XOR]                           = &&chk_xor,
+                [LT]                            = &&chk_lt,
+                [GT]                            = &&chk_gt,
+                [LE]                            = &&chk_le,
+                [GE]                            = &&chk_ge,
+                [EQ]                            = &&chk_eq,
+                [NE]                            = &&chk_ne,
+                [BR]                            = &&op_br,
+                [BRT]                           = &&chk_brt,
+                [BRF]                           = &&chk_brf,
+                [RET]                           = &&chk_ret,
+                [LIT]                           = &&chk_lit,
+                [CALL]                          = &&chk_call,
+                [LOAD_LOCAL]                    = &&chk_load_local,
+                [STORE_LOCAL]                   = &&chk_store_local,
+                [IN]                            = &&chk_in,
+                [OUT]                           = &&chk_out,
+                [CALL_NATIVE]                   = &&chk_call_native,
+                [CMP]                           = &&chk_cmp,
+                [BRZ]                           = &&op_brz,
+                [BRNZ]                          = &&op_brnz,
+                [BRLT]                          = &&op_brlt,
+                [BRGE]                          = &&op_brge,
+                [BRGT]                          = &&op_brgt,
+                [BRLE]                          = &&op_brle,
+                [THREAD_PUSH]                   = &&chk_push,
+                [THREAD_UNDEFINED_PRIMITIVE]    = &&op_undefined_primitive,
+                [THREAD_UNDEFINED_INSTRUCTION]  = &&op_undefined_instruction,
+                [THREAD_END]                    = &&op_end,
+#if STACKVM_TRACE
+                [THREAD_TRACE]                  = &&op_trace,
+#endif
+#if STACKVM_METRICS
+                [THREAD_COUNT]                  = &&op_count,
+#endif
+        };
+
+        if (handler_table)
+        {
+                *handler_table = handlers;
+                *checked_table = checked;
+                return;
+        }
+
+        const program_t *program = vm->program;
+        if (!program)
+        {
+                stackvm_fault(vm, ERROR_NO_PROGRAM);
+                return;
+        }
+
+        // Verified programs entered at their first instruction outside any call with enough values
+        // below and enough room above the stack pointer run unchecked, everything else runs checked
+        const struct thread_cache *cache = program->checked;
+        if (stackvm_unchecked(vm))
+        {
+                cache = program->threaded;
+        }
+#if STACKVM_TRACE
+        if (stackvm_hooked(vm))
+        {
+                // Traced and profiled runs use a private translation
+                if (!vm->threaded && !(vm->threaded = thread_compile(vm->code, vm->size, true, true)))
+                {
+                        stackvm_fault(vm, ERROR_OUT_OF_MEMORY); // The translation could not be allocated
+                        return;
+                }
+                cache = vm->threaded; // Trace level is chosen once per run
+        }
+#endif
+#if STACKVM_METRICS
+        bool counted = stackvm_counted(vm);
+        if (counted && !cache->traced)
+        {
+                // Counted runs dispatch a private copy through the counter, traced runs count in the trace handler
+                if (vm->counted && vm->counted->source != cache)
+                {
+                        thread_cache_free(vm->counted);
+                        vm->counted = NULL;
+                }
+                if (!vm->counted && !(vm->counted = thread_count(cache)))
+                {
+                        stackvm_fault(vm, ERROR_OUT_OF_MEMORY); // The copy could not be allocated
+                        return;
+                }
+                cache = vm->counted; // Counting is chosen once per run
+        }
+#endif
+
+        const thread_t *code    = cache->code;                         // Threaded code base
+        const thread_t *ip      = code + (vm->pc < cache->size ? vm->pc : cache->size); // Current entry
+        const uint32_t *words   = vm->code;                            // Program words holding the LIT operands
+        cell_t *stack           = vm->stack;                           // Operand stack
+        uint32_t sp             = vm->sp;                              // Stack pointer
+        uint32_t size           = cache->size;                         // Number of program words
+        uint32_t stack_size     = vm->stack_size;                      // Number of stack cells
+        vm_error_t error        = ERROR_NONE;                          // Reason of the fault
+        channel_status_t channel;                                      // Outcome of the last channel transfer
+        const native_t *native;                                        // Native function of the last CALL_NATIVE
+        uint32_t flag_op        = HALT;                                // Last flag-setting instruction, HALT keeps the flags of the context
+        cell_t flag_a           = vm->flags;                           // Its left operand
+        cell_t flag_b           = 0;                                   // Its right operand
+        frame_t *frames         = vm->frames;                          // Call stack, return addresses are entry indices
+        uint32_t calls          = vm->calls;                           // Frames on the call stack
+        uint32_t fp             = vm->fp;                              // Frame pointer
+#if STACKVM_METRICS
+        const void *const *table = cache->checked ? checked : handlers; // Handlers the counter dispatches to
+        uint64_t retired        = 0;                                   // Program instructions dispatched by a counted run
+        uint32_t peak           = vm->peak;                            // Deepest stack a counted run dispatched with
+#endif
+
+        vm->state = STATE_RUN;
+        DISPATCH();
+
+#if STACKVM_TRACE
+op_trace:
+        {
+                uint32_t pc = (uint32_t)(ip - code);
+                stackvm_hook(vm, words, size, pc, stack, sp);
+#if STACKVM_METRICS
+                if (counted)
+                {
+                        COUNT();
+                }
+#endif
+                goto *checked[ip->opcode];
+        }
+#endif
+#if STACKVM_METRICS
+op_count:
+        COUNT();
+        goto *table[ip->opcode];
+#endif
+
+chk_push:
+        if (sp + 1 >= stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_push:
+        stack[++sp] = OPERAND();
+        NEXT();
+chk_lit:
+        if (sp + 1 >= stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_lit:
+        stack[++sp] = GET_WIDE(words[ip->operand], words[ip->operand + 1]);
+        ip += 2; // Skip the operand words
+        NEXT();
+chk_add:
+        NEED(2);
+op_add:
+        ARITHMETIC(cell_add, ADD);
+chk_sub:
+        NEED(2);
+op_sub:
+        ARITHMETIC(cell_sub, SUB);
+chk_mul:
+        NEED(2);
+op_mul:
+        ARITHMETIC(cell_mul, MUL);
+chk_div:
+        NEED(2);
+op_div:
+        if (stack[sp] == 0)
+        {
+                FAULT(ERROR_DIVISION_BY_ZERO);
+        }
+        ARITHMETIC(cell_div, DIV);
+chk_and:
+        NEED(2);
+op_and:
+        BINARY(&);
+chk_or:
+        NEED(2);
+op_or:
+        BINARY(|);
+chk_not:
+        NEED(1);
+op_not:
+        stack[sp] = ~stack[sp];
+        NEXT();
+chk_xor:
+        NEED(2);
+op_xor:
+        BINARY(^);
+chk_lt:
+        NEED(2);
+op_lt:
+        COMPARE(<);
+chk_gt:
+        NEED(2);
+op_gt:
+        COMPARE(>);
+chk_le:
+        NEED(2);
+op_le:
+        COMPARE(<=);
+chk_ge:
+        NEED(2);
+op_ge:
+        COMPARE(>=);
+chk_eq:
+        NEED(2);
+op_eq:
+        COMPARE(==);
+chk_ne:
+        NEED(2);
+op_ne:
+        COMPARE(!=);
+chk_cmp:
+        NEED(2);
+op_cmp:
+        FLAGS(CMP, stack[sp - 1], stack[sp]);
+        sp -= 2;
+        NEXT();
+op_br:
+        JUMP(ip->operand);
+op_brz:
+        FLAG_BRANCH(BRZ);
+op_brnz:
+        FLAG_BRANCH(BRNZ);
+op_brlt:
+        FLAG_BRANCH(BRLT);
+op_brge:
+        FLAG_BRANCH(BRGE);
+op_brgt:
+        FLAG_BRANCH(BRGT);
+op_brle:
+        FLAG_BRANCH(BRLE);
+chk_brt:
+        NEED(1);
+op_brt:
+        if (stack[sp--] != 0)
+        {
+                JUMP(ip->operand);
+        }
+        ip++; // Skip the branch target word
+        NEXT();
+chk_brf:
+        NEED(1);
+op_brf:
+        if (stack[sp--] == 0)
+        {
+                JUMP(ip->operand);
+        }
+        ip++; // Skip the branch target word
+        NEXT();
+chk_ret:
+        if (calls == 0)
+        {
+                FAULT(ERROR_CALL_UNDERFLOW);
+        }
+        calls--;
+        fp = frames[calls].fp;
+        JUMP((frames[calls].ret < size) ? frames[calls].ret : size); // Frames of earlier runs may return anywhere
+op_ret:
+        calls--;
+        fp = frames[calls].fp;
+        JUMP(frames[calls].ret);
+chk_call:
+        if (calls >= vm->call_size)
+        {
+                FAULT(ERROR_CALL_OVERFLOW);
+        }
+op_call:
+        frames[calls++] = (frame_t){ .ret = (uint32_t)(ip - code) + 2, .fp = fp }; // Return past the target entry
+        fp = sp + 1;
+        JUMP(ip->operand);
+chk_load_local:
+        if ((uint32_t)(ip - code) + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        if (SLOT() < 0 || SLOT() >= (int64_t)(uint32_t)(sp + 1))
+        {
+                FAULT(ERROR_INVALID_LOCAL);
+        }
+        if (sp + 1 >= stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_load_local:
+        stack[sp + 1] = stack[SLOT()];
+        sp++;
+        ip++; // Skip the operand word
+        NEXT();
+chk_store_local:
+        NEED(1);
+        if ((uint32_t)(ip - code) + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        if (SLOT() < 0 || SLOT() >= (int64_t)sp)
+        {
+                FAULT(ERROR_INVALID_LOCAL);
+        }
+op_store_local:
+        stack[SLOT()] = stack[sp--];
+        ip++; // Skip the operand word
+        NEXT();
+chk_in:
+        if (sp + 1 >= stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_in:
+        if (!vm->in)
+        {
+                FAULT(ERROR_NO_CHANNEL);
+        }
+        channel = channel_get(vm->in, &stack[sp + 1]);
+        if (channel != CHANNEL_OK)
+        {
+                SYNC();                                                 // Waits on the IN, or the stream ended the program
+                vm->state = (channel == CHANNEL_BLOCKED) ? STATE_PAUSED : STATE_HALT;
+                return;
+        }
+        sp++;
+        NEXT();
+chk_out:
+        NEED(1);
+op_out:
+        if (!vm->out)
+        {
+                FAULT(ERROR_NO_CHANNEL);
+        }
+        if (channel_put(vm->out, stack[sp]) != CHANNEL_OK)
+        {
+                SYNC();                                                 // Waits on the OUT
+                vm->state = STATE_PAUSED;
+                return;
+        }
+        sp--;
+        NEXT();
+chk_call_native:
+        if ((uint32_t)(ip - code) + 1 >= size)
+        {
+                FAULT(ERROR_INVALID_ADDRESS);                           // Missing operand word
+        }
+        if (!(native = native_get(ip->operand)))
+        {
+                FAULT(ERROR_UNDEFINED_NATIVE);
+        }
+        NEED(native->arity);
+        if ((uint64_t)(uint32_t)(sp + 1) - native->arity + native->results > stack_size)
+        {
+                FAULT(ERROR_STACK_OVERFLOW);
+        }
+op_call_native:
+        native = &native_table[ip->operand];                            // Verified programs only call registered functions
+        if (!native->fn(&stack[(uint32_t)(sp + 1) - native->arity], native->data))
+        {
+                FAULT(ERROR_NATIVE_FAILED);
+        }
+        sp += (uint32_t)native->results - native->arity;
+        ip++; // Skip the operand word
+        NEXT();
+op_push_add:
+        ARITHMETIC_IMMEDIATE(cell_add, ADD);
+op_push_sub:
+        ARITHMETIC_IMMEDIATE(cell_sub, SUB);
+op_push_mul:
+        ARITHMETIC_IMMEDIATE(cell_mul, MUL);
+op_push_div:
+        ARITHMETIC_IMMEDIATE(cell_div, DIV);                            // The optimizer never fuses a zero divisor
+op_push_and:
+        IMMEDIATE(&);
+op_push_or:
+        IMMEDIATE(|);
+op_push_xor:
+        IMMEDIATE(^);
+op_push_lt:
+        COMPARE_IMMEDIATE(<);
+op_push_gt:
+        COMPARE_IMMEDIATE(>);
+op_push_le:
+        COMPARE_IMMEDIATE(<=);
+op_push_ge:
+        COMPARE_IMMEDIATE(>=);
+op_push_eq:
+        COMPARE_IMMEDIATE(==);
+op_push_ne:
+        COMPARE_IMMEDIATE(!=);
+op_push_cmp:
+        FLAGS(CMP, stack[sp], OPERAND());
+        sp--;
+        NEXT();
+op_lt_brf:
+        COMPARE_BRANCH(<, false);
+op_gt_brf:
+        COMPARE_BRANCH(>, false);
+op_le_brf:
+        COMPARE_BRANCH(<=, false);
+op_ge_brf:
+        COMPARE_BRANCH(>=, false);
+op_eq_brf:
+        COMPARE_BRANCH(==, false);
+op_ne_brf:
+        COMPARE_BRANCH(!=, false);
+op_lt_brt:
+        COMPARE_BRANCH(<, true);
+op_gt_brt:
+        COMPARE_BRANCH(>, true);
+op_le_brt:
+        COMPARE_BRANCH(<=, true);
+op_ge_brt:
+        COMPARE_BRANCH(>=, true);
+op_eq_brt:
+        COMPARE_BRANCH(==, true);
+op_ne_brt:
+        COMPARE_BRANCH(!=, true);
+op_undefined_primitive:
+        FAULT(ERROR_UNDEFINED_PRIMITIVE);
+op_undefined_instruction:
+        FAULT(ERROR_UNDEFINED_INSTRUCTION);
+op_end:
+#if STACKVM_METRICS
+        if (counted && cache->traced)
+        {
+                COUNT();                                                // Leaving the program is never traced, its fetch still counts
+        }
+#endif
+        FAULT(ERROR_INVALID_ADDRESS);
+op_halt:
+        SYNC();
+        vm->state = STATE_HALT;
+        return;
+fault:
+        SYNC();
+        stackvm_fault(vm, error);
+        return;
+}
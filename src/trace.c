@@ -0,0 +1,165 @@
+/***
+ *
+ * @file: trace.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the implementation of the instruction tracing subsystem
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <inttypes.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "trace.h"
+
+trace_t *trace_open(trace_level_t level, FILE *out)
+{
+        if (level == TRACE_OFF || !out)
+        {
+                return NULL; // Nothing to trace
+        }
+
+        trace_t *trace = (trace_t *)malloc(sizeof(trace_t));
+        if (!trace)
+        {
+                return NULL;
+        }
+        trace->level = level;
+        trace->out   = out;
+        trace->count = 0;
+
+        if (level == TRACE_FULL)
+        {
+                trace_header_t header =
+                {
+                        .magic       = TRACE_MAGIC,
+                        .version     = TRACE_VERSION,
+                        .record_size = sizeof(trace_record_t),
+                };
+                fwrite(&header, sizeof(header), 1, out);
+        }
+        return trace;
+}
+
+void trace_close(trace_t *trace)
+{
+        if (trace)
+        {
+                trace_flush(trace);
+                free(trace);
+        }
+        return;
+}
+
+void trace_step(trace_t *trace, const uint32_t *code, uint32_t size, uint32_t pc, const int64_t *stack, uint32_t sp)
+{
+        uint32_t instruction = code[pc];
+        trace_record_t record =
+        {
+                .pc          = pc,
+                .instruction = instruction,
+                .sp          = sp,
+                .target      = (pc + 1 < size) ? code[pc + 1] : size,
+                .tos         = (sp != (uint32_t)-1) ? stack[sp] : 0,
+                .nos         = (sp != (uint32_t)-1 && sp > 0) ? stack[sp - 1] : 0,
+                .immediate   = 0,
+        };
+        if (GET_TYPE(instruction) == POSITIVE_INTEGER || GET_TYPE(instruction) == NEGATIVE_INTEGER)
+        {
+                record.immediate = GET_IMMEDIATE(instruction);
+        }
+        else if (instruction == GET_OPCODE(LIT) && pc + 2 < size)
+        {
+                record.immediate = GET_WIDE(code[pc + 1], code[pc + 2]);
+        }
+
+        if (trace->level == TRACE_FULL)
+        {
+                trace->buffer[trace->count++] = record;
+                if (trace->count == TRACE_BUFFER_SIZE)
+                {
+                        trace_flush(trace); // Write a full buffer in one go
+                }
+                return;
+        }
+        trace_print(trace->out, &record);
+        fputc('\n', trace->out);
+        return;
+}
+
+void trace_flush(trace_t *trace)
+{
+        if (trace->level == TRACE_FULL && trace->count)
+        {
+                fwrite(trace->buffer, sizeof(trace_record_t), trace->count, trace->out);
+                trace->count = 0;
+        }
+        fflush(trace->out);
+        return;
+}
+
+void trace_print(FILE *out, const trace_record_t *record)
+{
+        uint32_t data = GET_DATA(record->instruction);
+
+        switch (GET_TYPE(record->instruction))
+        {
+        case POSITIVE_INTEGER:
+        case NEGATIVE_INTEGER:
+                fprintf(out, "push %" PRId64, record->immediate);
+                return;
+        case PRIMITIVE_INSTRUCTION:
+                break;
+        default:
+                fprintf(out, "undefined 0x%08x", record->instruction);
+                return;
+        }
+
+        const char *name = stackvm_opcode_name(data);
+        if (!name)
+        {
+                fprintf(out, "undefined 0x%08x", record->instruction);
+                return;
+        }
+
+        switch (data)
+        {
+        case HALT:
+        case RET:
+        case IN:
+                fprintf(out, "%s", name);
+                break;
+        case NOT:
+        case OUT:
+                fprintf(out, "%s %" PRId64, name, record->tos);
+                break;
+        case BR:
+        case BRT:
+        case BRF:
+        case BRZ:
+        case BRNZ:
+        case BRLT:
+        case BRGE:
+        case BRGT:
+        case BRLE:
+        case CALL:
+        case CALL_NATIVE:
+                fprintf(out, "%s %u", name, record->target);
+                break;
+        case LOAD_LOCAL:
+        case STORE_LOCAL:
+                fprintf(out, "%s %" PRId32, name, (int32_t)record->target);
+                break;
+        case LIT:
+                fprintf(out, "%s %" PRId64, name, record->immediate);
+                break;
+        default:
+                fprintf(out, "%s %" PRId64 ", %" PRId64, name, record->nos, record->tos);
+                break;
+        }
+        return;
+}
@@ -0,0 +1,419 @@
+/***
+ *
+ * @file: vector.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the SIMD vectorized batch interpreter of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "vector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECTOR_X86              1
+#else
+#define VECTOR_X86              0
+#endif
+
+#define VECTOR_LANES            8               // Lanes of the portable scalar kernel
+#define VECTOR_REGISTERS        4               // SIMD registers per lane stack slot of the SSE2 and AVX2 kernels
+#define VECTOR_PUSH             PRIMITIVE_COUNT // Push the operand into every lane
+#define VECTOR_SLOT_BYTES       (VECTOR_REGISTERS * 32) // Bytes of the widest lane stack slot, the 32-byte AVX2 registers, also its alignment
+
+/**
+ * @brief Instruction of a vectorized program
+ */
+typedef struct vector_op
+{
+        uint32_t opcode;                // Primitive instruction or VECTOR_PUSH
+        cell_t operand;                 // Pushed value
+} vector_op_t;
+
+/**
+ * @brief Straight-line program prepared for the vectorized kernels
+ * @note The depths are relative to the input tuple, so one preparation serves batches of any arity.
+ */
+struct vector_program
+{
+        vector_op_t *ops;               // Instructions up to the terminating HALT
+        uint32_t count;                 // Number of instructions
+        uint32_t entry;                 // Inputs the program pops below the tuple, smaller tuples underflow
+        uint32_t rise;                  // Maximum stack depth above the tuple in slots
+        int32_t end;                    // Stack depth at HALT relative to the tuple, the result is slot `arity + end - 1`
+};
+
+typedef struct vector_program vector_program_t;
+
+static vector_program_t vector_unsupported;     // Cached for programs that cannot be vectorized
+
+/**
+ * @brief Checks that a program can be vectorized and prepares it
+ * @param program Pointer to the program
+ * @return Pointer to the prepared program, NULL if the program is not vectorizable or on allocation failure
+ */
+static vector_program_t *vector_compile(const program_t *program)
+{
+        int64_t depth         = 0;                                      // Stack depth relative to the tuple
+        vector_program_t *vp  = malloc(sizeof(*vp));
+        vector_op_t *ops      = malloc(((size_t)program->size + 1) * sizeof(vector_op_t));
+        if (!vp || !ops)
+        {
+                free(vp);
+                free(ops);
+                return NULL;
+        }
+        *vp = (vector_program_t){ .ops = ops };
+
+        for (uint32_t pc = 0; pc < program->size; pc++)
+        {
+                uint32_t instruction = program->code[pc];
+                uint32_t data        = GET_DATA(instruction);
+                uint32_t need        = 0;                               // Operands the instruction pops
+
+                switch (GET_TYPE(instruction))
+                {
+                case POSITIVE_INTEGER:
+                case NEGATIVE_INTEGER:
+                        vp->ops[vp->count++] = (vector_op_t){ VECTOR_PUSH, GET_IMMEDIATE(instruction) };
+                        depth++;
+                        break;
+                case PRIMITIVE_INSTRUCTION:
+                        switch (data)
+                        {
+                        case HALT:
+                                vp->end = (int32_t)depth;
+                                return vp;
+                        case LIT:
+                                if (pc + 2 >= program->size)
+                                {
+                                        goto scalar; // Missing operand words are left to the scalar engines
+                                }
+                                vp->ops[vp->count++] = (vector_op_t){ VECTOR_PUSH, GET_WIDE(program->code[pc + 1], program->code[pc + 2]) };
+                                depth++;
+                                pc += 2;
+                                goto next;
+                        case NOT:
+                                need = 1;
+                                break;
+                        case ADD: case SUB: case MUL: case AND: case OR: case XOR:
+                        case LT: case GT: case LE: case GE: case EQ: case NE:
+                                need = 2;
+                                break;
+                        default:
+                                goto scalar; // DIV may trap, branches, flags and calls are not straight-line
+                        }
+                        if (need - depth > (int64_t)vp->entry)
+                        {
+                                vp->entry = (uint32_t)(need - depth); // Tuples with fewer inputs underflow here
+                        }
+                        depth += 1 - (int64_t)need;
+                        vp->ops[vp->count++] = (vector_op_t){ data, 0 };
+                        break;
+                default:
+                        goto scalar;
+                }
+next:
+                if (depth > (int64_t)vp->rise)
+                {
+                        vp->rise = (uint32_t)depth;
+                }
+        }
+
+scalar:
+        free(ops);
+        free(vp);
+        return NULL;
+}
+
+/**
+ * @brief Returns the vectorized form of a program, preparing it on first use
+ * @param program Pointer to the program
+ * @return Pointer to the prepared program, NULL if the program cannot be vectorized
+ * @note Contexts on several threads may race to prepare the same program,
+ *       the first published preparation wins and the others are freed.
+ */
+static const vector_program_t *vector_lookup(program_t *program)
+{
+        vector_program_t *vp = __atomic_load_n(&program->vector, __ATOMIC_ACQUIRE);
+        if (!vp)
+        {
+                vector_program_t *expected = NULL;
+                vp = vector_compile(program);
+                vp = vp ? vp : &vector_unsupported;
+                if (!__atomic_compare_exchange_n(&program->vector, &expected, vp, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                {
+                        vector_program_free(vp);
+                        vp = expected;
+                }
+        }
+        return (vp != &vector_unsupported) ? vp : NULL;
+}
+
+/**
+ * Lane-parallel primitives of the portable scalar kernel
+ */
+typedef struct { cell_t lane[VECTOR_LANES]; } scalar_t;
+
+#define SCALAR_MAP(expr) \
+        scalar_t r; for (int l = 0; l < VECTOR_LANES; l++) { cell_t x = a.lane[l], y = b.lane[l]; (void)y; r.lane[l] = (expr); } return r
+
+static inline scalar_t scalar_load(const cell_t *p)          { scalar_t r; memcpy(r.lane, p, sizeof(r.lane)); return r; }
+static inline void     scalar_store(cell_t *p, scalar_t a)   { memcpy(p, a.lane, sizeof(a.lane)); }
+static inline scalar_t scalar_set1(cell_t v)                 { scalar_t r; for (int l = 0; l < VECTOR_LANES; l++) r.lane[l] = v; return r; }
+static inline scalar_t scalar_add(scalar_t a, scalar_t b)    { SCALAR_MAP(cell_add(x, y)); }
+static inline scalar_t scalar_sub(scalar_t a, scalar_t b)    { SCALAR_MAP(cell_sub(x, y)); }
+static inline scalar_t scalar_mul(scalar_t a, scalar_t b)    { SCALAR_MAP(cell_mul(x, y)); }
+static inline scalar_t scalar_and(scalar_t a, scalar_t b)    { SCALAR_MAP(x & y); }
+static inline scalar_t scalar_or(scalar_t a, scalar_t b)     { SCALAR_MAP(x | y); }
+static inline scalar_t scalar_xor(scalar_t a, scalar_t b)    { SCALAR_MAP(x ^ y); }
+static inline scalar_t scalar_not(scalar_t a)                { scalar_t b = a; SCALAR_MAP(~x); }
+static inline scalar_t scalar_lt(scalar_t a, scalar_t b)     { SCALAR_MAP(x < y); }
+static inline scalar_t scalar_gt(scalar_t a, scalar_t b)     { SCALAR_MAP(x > y); }
+static inline scalar_t scalar_le(scalar_t a, scalar_t b)     { SCALAR_MAP(x <= y); }
+static inline scalar_t scalar_ge(scalar_t a, scalar_t b)     { SCALAR_MAP(x >= y); }
+static inline scalar_t scalar_eq(scalar_t a, scalar_t b)     { SCALAR_MAP(x == y); }
+static inline scalar_t scalar_ne(scalar_t a, scalar_t b)     { SCALAR_MAP(x != y); }
+
+#if VECTOR_X86
+/**
+ * Lane-parallel primitives of the SSE2 kernel, SSE2 has no 64-bit multiply and no 64-bit compares,
+ * both are built from their 32-bit halves
+ */
+#define SSE2_BIAS       _mm_set_epi32(0, (int)0x80000000, 0, (int)0x80000000)
+#define SSE2_ONE        _mm_set1_epi64x(1)
+
+static inline __m128i sse2_load(const cell_t *p)         { return _mm_loadu_si128((const __m128i *)p); }
+static inline void    sse2_store(cell_t *p, __m128i a)   { _mm_storeu_si128((__m128i *)p, a); }
+static inline __m128i sse2_set1(cell_t v)                { return _mm_set1_epi64x(v); }
+static inline __m128i sse2_add(__m128i a, __m128i b)     { return _mm_add_epi64(a, b); }
+static inline __m128i sse2_sub(__m128i a, __m128i b)     { return _mm_sub_epi64(a, b); }
+static inline __m128i sse2_and(__m128i a, __m128i b)     { return _mm_and_si128(a, b); }
+static inline __m128i sse2_or(__m128i a, __m128i b)      { return _mm_or_si128(a, b); }
+static inline __m128i sse2_xor(__m128i a, __m128i b)     { return _mm_xor_si128(a, b); }
+static inline __m128i sse2_not(__m128i a)                { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+static inline __m128i sse2_mul(__m128i a, __m128i b)
+{
+        // lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32), the high halves of the cross products wrap away
+        __m128i low   = _mm_mul_epu32(a, b);
+        __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+        return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+}
+static inline __m128i sse2_eqm(__m128i a, __m128i b)
+{
+        __m128i eq = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+static inline __m128i sse2_gtm(__m128i a, __m128i b)
+{
+        // The bias turns the low halves into unsigned compares and leaves the high halves signed
+        __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(a, SSE2_BIAS), _mm_xor_si128(b, SSE2_BIAS));
+        __m128i eq = _mm_cmpeq_epi32(a, b);
+        __m128i r  = _mm_or_si128(gt, _mm_and_si128(eq, _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0))));
+        return _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
+}
+static inline __m128i sse2_lt(__m128i a, __m128i b)      { return _mm_and_si128(sse2_gtm(b, a), SSE2_ONE); }
+static inline __m128i sse2_gt(__m128i a, __m128i b)      { return _mm_and_si128(sse2_gtm(a, b), SSE2_ONE); }
+static inline __m128i sse2_le(__m128i a, __m128i b)      { return _mm_andnot_si128(sse2_gtm(a, b), SSE2_ONE); }
+static inline __m128i sse2_ge(__m128i a, __m128i b)      { return _mm_andnot_si128(sse2_gtm(b, a), SSE2_ONE); }
+static inline __m128i sse2_eq(__m128i a, __m128i b)      { return _mm_and_si128(sse2_eqm(a, b), SSE2_ONE); }
+static inline __m128i sse2_ne(__m128i a, __m128i b)      { return _mm_andnot_si128(sse2_eqm(a, b), SSE2_ONE); }
+
+/**
+ * Lane-parallel primitives of the AVX2 kernel, AVX2 has no 64-bit low multiply either
+ */
+#define AVX2            __attribute__((target("avx2")))
+#define AVX2_ONE        _mm256_set1_epi64x(1)
+
+AVX2 static inline __m256i avx2_load(const cell_t *p)         { return _mm256_loadu_si256((const __m256i *)p); }
+AVX2 static inline void    avx2_store(cell_t *p, __m256i a)   { _mm256_storeu_si256((__m256i *)p, a); }
+AVX2 static inline __m256i avx2_set1(cell_t v)                { return _mm256_set1_epi64x(v); }
+AVX2 static inline __m256i avx2_add(__m256i a, __m256i b)     { return _mm256_add_epi64(a, b); }
+AVX2 static inline __m256i avx2_sub(__m256i a, __m256i b)     { return _mm256_sub_epi64(a, b); }
+AVX2 static inline __m256i avx2_mul(__m256i a, __m256i b)
+{
+        __m256i low   = _mm256_mul_epu32(a, b);
+        __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+        return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+AVX2 static inline __m256i avx2_and(__m256i a, __m256i b)     { return _mm256_and_si256(a, b); }
+AVX2 static inline __m256i avx2_or(__m256i a, __m256i b)      { return _mm256_or_si256(a, b); }
+AVX2 static inline __m256i avx2_xor(__m256i a, __m256i b)     { return _mm256_xor_si256(a, b); }
+AVX2 static inline __m256i avx2_not(__m256i a)                { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+AVX2 static inline __m256i avx2_lt(__m256i a, __m256i b)      { return _mm256_and_si256(_mm256_cmpgt_epi64(b, a), AVX2_ONE); }
+AVX2 static inline __m256i avx2_gt(__m256i a, __m256i b)      { return _mm256_and_si256(_mm256_cmpgt_epi64(a, b), AVX2_ONE); }
+AVX2 static inline __m256i avx2_le(__m256i a, __m256i b)      { return _mm256_andnot_si256(_mm256_cmpgt_epi64(a, b), AVX2_ONE); }
+AVX2 static inline __m256i avx2_ge(__m256i a, __m256i b)      { return _mm256_andnot_si256(_mm256_cmpgt_epi64(b, a), AVX2_ONE); }
+AVX2 static inline __m256i avx2_eq(__m256i a, __m256i b)      { return _mm256_and_si256(_mm256_cmpeq_epi64(a, b), AVX2_ONE); }
+AVX2 static inline __m256i avx2_ne(__m256i a, __m256i b)      { return _mm256_andnot_si256(_mm256_cmpeq_epi64(a, b), AVX2_ONE); }
+#endif
+
+/**
+ * Slots of the SIMD kernels made of VECTOR_REGISTERS registers, so every dispatched instruction is
+ * shared by 8 lanes with SSE2 and 16 with AVX2 and the registers of a slot run independently.
+ * The loop over the registers must be unrolled, a rolled loop copies every slot through memory.
+ */
+#define WIDE_EACH               _Pragma("GCC unroll 4") for (int k = 0; k < VECTOR_REGISTERS; k++)
+#define WIDE_MAP(isa, expr)     isa##_wide_t r; WIDE_EACH { r.v[k] = (expr); } return r
+#define WIDE_BINARY(isa, attr, name) \
+        attr static inline isa##_wide_t isa##_wide_##name(isa##_wide_t a, isa##_wide_t b) { WIDE_MAP(isa, isa##_##name(a.v[k], b.v[k])); }
+#define VECTOR_WIDE(isa, attr, vec_t)                                                                           \
+        typedef struct { vec_t v[VECTOR_REGISTERS]; } isa##_wide_t;                                             \
+        enum { isa##_cells = sizeof(vec_t) / sizeof(cell_t) };                                                  \
+        attr static inline isa##_wide_t isa##_wide_load(const cell_t *p)    { WIDE_MAP(isa, isa##_load(p + k * isa##_cells)); } \
+        attr static inline void isa##_wide_store(cell_t *p, isa##_wide_t a) { WIDE_EACH { isa##_store(p + k * isa##_cells, a.v[k]); } } \
+        attr static inline isa##_wide_t isa##_wide_set1(cell_t v)           { WIDE_MAP(isa, isa##_set1(v)); }    \
+        attr static inline isa##_wide_t isa##_wide_not(isa##_wide_t a)      { WIDE_MAP(isa, isa##_not(a.v[k])); } \
+        WIDE_BINARY(isa, attr, add) WIDE_BINARY(isa, attr, sub) WIDE_BINARY(isa, attr, mul)                     \
+        WIDE_BINARY(isa, attr, and) WIDE_BINARY(isa, attr, or)  WIDE_BINARY(isa, attr, xor)                     \
+        WIDE_BINARY(isa, attr, lt)  WIDE_BINARY(isa, attr, gt)  WIDE_BINARY(isa, attr, le)                      \
+        WIDE_BINARY(isa, attr, ge)  WIDE_BINARY(isa, attr, eq)  WIDE_BINARY(isa, attr, ne)
+
+#if VECTOR_X86
+VECTOR_WIDE(sse2, , __m128i)
+VECTOR_WIDE(avx2, AVX2, __m256i)
+#endif
+
+/**
+ * Kernel body shared by every instruction set. Tuples are processed in blocks of `lanes`,
+ * the last block is padded with zero lanes whose results are dropped. The lane stack `slots`
+ * holds `arity + vp->rise + 1` slots of VECTOR_SLOT_BYTES.
+ */
+#define VECTOR_KERNEL(isa, attr, vec_t, lanes)                                                          \
+attr static void kernel_##isa(const vector_program_t *vp, const cell_t *inputs, uint32_t arity,        \
+                              size_t count, cell_t *results, void *slots)                               \
+{                                                                                                       \
+        vec_t *stack    = slots;                                                                        \
+        uint32_t result = arity + vp->end;                                                              \
+        cell_t column[lanes];                                                                           \
+        for (size_t i = 0; i < count; i += lanes)                                                       \
+        {                                                                                               \
+                size_t valid = (count - i < lanes) ? count - i : lanes;                                 \
+                for (uint32_t j = 0; j < arity; j++)                                                    \
+                {                                                                                       \
+                        for (size_t l = 0; l < lanes; l++)                                              \
+                        {                                                                               \
+                                column[l] = (l < valid) ? inputs[(i + l) * arity + j] : 0;              \
+                        }                                                                               \
+                        stack[j] = isa##_load(column);                                                  \
+                }                                                                                       \
+                uint32_t sp = arity;                                                                    \
+                for (const vector_op_t *op = vp->ops; op < vp->ops + vp->count; op++)                  \
+                {                                                                                       \
+                        switch (op->opcode)                                                             \
+                        {                                                                               \
+                        case VECTOR_PUSH: stack[sp++] = isa##_set1(op->operand); break;                 \
+                        case ADD: sp--; stack[sp - 1] = isa##_add(stack[sp - 1], stack[sp]); break;     \
+                        case SUB: sp--; stack[sp - 1] = isa##_sub(stack[sp - 1], stack[sp]); break;     \
+                        case MUL: sp--; stack[sp - 1] = isa##_mul(stack[sp - 1], stack[sp]); break;     \
+                        case AND: sp--; stack[sp - 1] = isa##_and(stack[sp - 1], stack[sp]); break;     \
+                        case OR:  sp--; stack[sp - 1] = isa##_or(stack[sp - 1], stack[sp]);  break;     \
+                        case XOR: sp--; stack[sp - 1] = isa##_xor(stack[sp - 1], stack[sp]); break;     \
+                        case NOT: stack[sp - 1] = isa##_not(stack[sp - 1]); break;                      \
+                        case LT:  sp--; stack[sp - 1] = isa##_lt(stack[sp - 1], stack[sp]);  break;     \
+                        case GT:  sp--; stack[sp - 1] = isa##_gt(stack[sp - 1], stack[sp]);  break;     \
+                        case LE:  sp--; stack[sp - 1] = isa##_le(stack[sp - 1], stack[sp]);  break;     \
+                        case GE:  sp--; stack[sp - 1] = isa##_ge(stack[sp - 1], stack[sp]);  break;     \
+                        case EQ:  sp--; stack[sp - 1] = isa##_eq(stack[sp - 1], stack[sp]);  break;     \
+                        case NE:  sp--; stack[sp - 1] = isa##_ne(stack[sp - 1], stack[sp]);  break;     \
+                        }                                                                               \
+                }                                                                                       \
+                if (result)                                                                             \
+                {                                                                                       \
+                        isa##_store(column, stack[result - 1]);                                         \
+                }                                                                                       \
+                else                                                                                    \
+                {                                                                                       \
+                        memset(column, 0, sizeof(column));                                              \
+                }                                                                                       \
+                memcpy(results + i, column, valid * sizeof(cell_t));                                    \
+        }                                                                                               \
+}
+
+VECTOR_KERNEL(scalar, , scalar_t, VECTOR_LANES)
+#if VECTOR_X86
+VECTOR_KERNEL(sse2_wide, , sse2_wide_t, 2 * VECTOR_REGISTERS)
+VECTOR_KERNEL(avx2_wide, AVX2, avx2_wide_t, 4 * VECTOR_REGISTERS)
+#endif
+
+typedef void (*kernel_t)(const vector_program_t *vp, const cell_t *inputs, uint32_t arity, size_t count, cell_t *results, void *slots);
+
+static kernel_t kernel          = kernel_scalar;        // Kernel selected at startup
+static const char *kernel_isa   = "scalar";             // Instruction set of the selected kernel
+
+/**
+ * @brief Selects the widest kernel supported by the CPU
+ * @return void
+ * @note Runs once before main, so the choice is never revisited on the execution path.
+ */
+__attribute__((constructor)) static void vector_select(void)
+{
+#if VECTOR_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+                kernel     = kernel_avx2_wide;
+                kernel_isa = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+                kernel     = kernel_sse2_wide;
+                kernel_isa = "sse2";
+        }
+#endif
+        return;
+}
+
+const char *vector_isa(void)
+{
+        return kernel_isa;
+}
+
+bool vector_run_batch(stackvm_t *vm, const cell_t *inputs, uint32_t arity, size_t count, cell_t *results)
+{
+        const vector_program_t *vp = vector_lookup(vm->program);
+        if (!vp || arity < vp->entry || (uint64_t)arity + vp->rise > vm->stack_size)
+        {
+                return false; // Stack underflow and overflow are left to the scalar engines
+        }
+
+        // The depth is only bounded by the stack segment of the context, too deep for the C stack
+        uint32_t slots = arity + vp->rise + 1;
+        if (slots > vm->lane_slots)
+        {
+                void *lanes = aligned_alloc(VECTOR_SLOT_BYTES, (size_t)slots * VECTOR_SLOT_BYTES);
+                if (!lanes)
+                {
+                        return false;
+                }
+                free(vm->lanes);
+                vm->lanes      = lanes;
+                vm->lane_slots = slots;
+        }
+        kernel(vp, inputs, arity, count, results, vm->lanes); // The registers and the stack of the context are left untouched
+        return true;
+}
+
+void vector_free(stackvm_t *vm)
+{
+        free(vm->lanes);
+        vm->lanes      = NULL;
+        vm->lane_slots = 0;
+        return;
+}
+
+void vector_program_free(struct vector_program *vp)
+{
+        if (vp && vp != &vector_unsupported)
+        {
+                free(vp->ops);
+                free(vp);
+        }
+        return;
+}
@@ -0,0 +1,346 @@
+/***
+ *
+ * @file: verify.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the load-time bytecode verifier of the StackVM
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "verify.h"
+#include "native.h"
+
+#define DEPTH_UNKNOWN   INT64_MIN                               // Instruction not reached yet
+
+/**
+ * @brief Records why a program failed verification
+ * @param program Pointer to the program
+ * @param pc Address of the offending instruction
+ * @param error Description of the problem
+ * @return false
+ */
+static bool reject(program_t *program, uint32_t pc, const char *error)
+{
+        program->verified     = false;
+        program->verify_error = error;
+        program->verify_pc    = pc;
+        return false;
+}
+
+/**
+ * @brief Merges the stack depth of a path into an instruction
+ * @param depth Stack depth of every instruction, relative to the entry
+ * @param worklist Instructions reached so far, each queued once
+ * @param queued Number of instructions in the worklist
+ * @param target Address of the instruction
+ * @param value Stack depth of the path reaching the instruction
+ * @return true if the depths agree, false otherwise
+ */
+static bool merge(int64_t *depth, uint32_t *worklist, uint32_t *queued, uint32_t target, int64_t value)
+{
+        if (depth[target] == DEPTH_UNKNOWN)
+        {
+                depth[target]           = value;
+                worklist[(*queued)++]   = target;               // Every instruction is queued at most once
+                return true;
+        }
+        return depth[target] == value;
+}
+
+/**
+ * @brief Stack effect of a function, the code reached from the program entry or a CALL target
+ */
+typedef struct summary
+{
+        uint8_t state;                  // SUMMARY_NONE, SUMMARY_ACTIVE or SUMMARY_DONE
+        int64_t lowest;                 // Lowest depth reached, relative to the entry, including local slots
+        int64_t highest;                // Highest depth reached, relative to the entry
+        int64_t effect;                 // Depth at every RET, DEPTH_UNKNOWN if the function never returns
+        uint32_t frames;                // Deepest nesting of frames pushed by the calls it makes
+} summary_t;
+
+enum
+{
+        SUMMARY_NONE,                   // Not analysed
+        SUMMARY_ACTIVE,                 // Waiting for the functions it calls
+        SUMMARY_DONE,                   // Analysed
+};
+
+/**
+ * @brief Scratch state of the verifier
+ */
+typedef struct verifier
+{
+        program_t *program;             // Program being verified
+        const bool *start;              // Word is the first word of an instruction
+        int64_t *depth;                 // Stack depth on entry to every instruction of the current function
+        uint32_t *worklist;             // Instructions of the current function reached so far
+        summary_t *summary;             // Summary of every function, indexed by its entry address
+} verifier_t;
+
+/**
+ * @brief Analyses one function
+ * @param v Verifier state
+ * @param entry Entry address of the function, 0 for the program itself
+ * @param callee Receives the entry of a function that has to be analysed first
+ * @return true when the function was analysed or a callee is needed, false when the program is rejected
+ * @note The program itself addresses its locals from the bottom of the stack, a called function
+ *       from the stack depth it was called with, so negative offsets reach the arguments.
+ */
+static bool analyse(verifier_t *v, uint32_t entry, uint32_t *callee)
+{
+        program_t *program  = v->program;
+        uint32_t size       = program->size;
+        summary_t *self     = &v->summary[entry];
+        bool outermost      = (entry == 0);
+        bool verified       = true;
+        uint32_t queued     = 0;
+        uint32_t head       = 0;
+        int64_t lowest      = 0;
+        int64_t highest     = 0;
+        int64_t effect      = DEPTH_UNKNOWN;
+        uint32_t frames     = 0;
+
+        v->depth[entry]         = 0;
+        v->worklist[queued++]   = entry;
+        *callee                 = size;
+        while (verified && head < queued)
+        {
+                uint32_t pc          = v->worklist[head++];
+                uint32_t instruction = program->code[pc];
+                int64_t current      = v->depth[pc];
+                uint32_t next        = pc + 1;                  // Fall-through successor
+                bool falls           = true;                    // The instruction can continue at `next`
+
+                switch (GET_TYPE(instruction))
+                {
+                case POSITIVE_INTEGER:
+                case NEGATIVE_INTEGER:
+                        current++;
+                        break;
+                case PRIMITIVE_INSTRUCTION:
+                {
+                        uint32_t opcode           = GET_DATA(instruction);
+                        const opcode_info_t *info = stackvm_opcode_info(opcode);
+                        if (!info)
+                        {
+                                verified = reject(program, pc, "undefined primitive instruction");
+                                break;
+                        }
+                        if (pc + info->operands >= size)
+                        {
+                                verified = reject(program, pc, info->target ? "missing branch target" : "missing operand words");
+                                break;
+                        }
+                        int64_t pops   = info->pops;
+                        int64_t pushes = info->pushes;
+                        if (opcode == CALL_NATIVE)
+                        {
+                                // The stack effect of a native call is the one declared by the function
+                                const native_t *native = native_get(program->code[pc + 1]);
+                                if (!native)
+                                {
+                                        verified = reject(program, pc, "undefined native function");
+                                        break;
+                                }
+                                pops   = native->arity;
+                                pushes = native->results;
+                        }
+                        current -= pops;
+                        lowest   = (current < lowest) ? current : lowest;
+                        next     = pc + 1 + info->operands;
+                        if (opcode == LOAD_LOCAL || opcode == STORE_LOCAL)
+                        {
+                                int64_t slot = (int32_t)program->code[pc + 1];
+                                if (outermost ? slot < 0 : slot >= current)
+                                {
+                                        verified = reject(program, pc, "local slot outside the stack");
+                                        break;
+                                }
+                                // The program itself needs an entry depth above its slot, a function needs the slot above its caller's stack bottom
+                                int64_t bound = outermost ? current - 1 - slot : slot;
+                                lowest = (bound < lowest) ? bound : lowest;
+                        }
+                        current += pushes;
+                        if (opcode == HALT)
+                        {
+                                falls = false;
+                        }
+                        if (opcode == RET)
+                        {
+                                if (outermost)
+                                {
+                                        verified = reject(program, pc, "return outside a function");
+                                        break;
+                                }
+                                if (effect != DEPTH_UNKNOWN && effect != current)
+                                {
+                                        verified = reject(program, pc, "inconsistent return depth");
+                                        break;
+                                }
+                                effect = current;
+                                falls  = false;
+                        }
+                        if (info->target)
+                        {
+                                uint32_t target = program->code[pc + 1];
+                                if (target >= size || !v->start[target])
+                                {
+                                        verified = reject(program, pc, "branch target is not an instruction");
+                                        break;
+                                }
+                                if (opcode == CALL)
+                                {
+                                        summary_t *called = &v->summary[target];
+                                        if (called->state == SUMMARY_ACTIVE)
+                                        {
+                                                verified = reject(program, pc, "recursive call");
+                                                break;
+                                        }
+                                        if (called->state == SUMMARY_NONE)
+                                        {
+                                                *callee = target;       // Analyse the callee, then this function again
+                                                break;
+                                        }
+                                        lowest  = (current + called->lowest < lowest) ? current + called->lowest : lowest;
+                                        highest = (current + called->highest > highest) ? current + called->highest : highest;
+                                        frames  = (called->frames + 1 > frames) ? called->frames + 1 : frames;
+                                        falls   = (called->effect != DEPTH_UNKNOWN);
+                                        current += falls ? called->effect : 0;
+                                }
+                                else if (!merge(v->depth, v->worklist, &queued, target, current))
+                                {
+                                        verified = reject(program, target, "inconsistent stack depth");
+                                        break;
+                                }
+                                else
+                                {
+                                        falls = (opcode != BR);
+                                }
+                        }
+                        break;
+                }
+                default:
+                        verified = reject(program, pc, "undefined instruction");
+                        break;
+                }
+                if (!verified || *callee != size)
+                {
+                        break;
+                }
+                if (!falls)
+                {
+                        continue;
+                }
+
+                highest = (current > highest) ? current : highest;
+                if (next >= size)
+                {
+                        verified = reject(program, pc, "execution runs past the end of the program");
+                }
+                else if (!merge(v->depth, v->worklist, &queued, next, current))
+                {
+                        verified = reject(program, next, "inconsistent stack depth");
+                }
+        }
+
+        for (uint32_t i = 0; i < queued; i++)
+        {
+                v->depth[v->worklist[i]] = DEPTH_UNKNOWN;       // Forget the depths for the next function
+        }
+        if (verified && *callee == size)
+        {
+                *self = (summary_t){ SUMMARY_DONE, lowest, highest, effect, frames };
+        }
+        return verified;
+}
+
+bool program_verify(program_t *program)
+{
+        uint32_t size = program->size;
+        if (size == 0)
+        {
+                return reject(program, 0, "empty program");
+        }
+
+        // Linear decode: a branch owns the word holding its target, LIT the two words holding its value
+        bool *start         = calloc(size, sizeof(bool));
+        int64_t *depth      = malloc(size * sizeof(int64_t));
+        uint32_t *worklist  = malloc(size * sizeof(uint32_t));
+        summary_t *summary  = calloc(size, sizeof(summary_t));
+        uint32_t *functions = malloc(size * sizeof(uint32_t)); // Functions waiting for their callees
+        if (!start || !depth || !worklist || !summary || !functions)
+        {
+                free(start);
+                free(depth);
+                free(worklist);
+                free(summary);
+                free(functions);
+                return reject(program, 0, "out of memory");
+        }
+        for (uint32_t pc = 0; pc < size; pc++)
+        {
+                uint32_t instruction = program->code[pc];
+                start[pc] = true;
+                depth[pc] = DEPTH_UNKNOWN;
+                if (GET_TYPE(instruction) == PRIMITIVE_INSTRUCTION)
+                {
+                        const opcode_info_t *info = stackvm_opcode_info(GET_DATA(instruction));
+                        for (uint32_t i = 0; info && i < info->operands && pc + 1 < size; i++)
+                        {
+                                pc++;                           // Skip the operand words
+                                start[pc] = false;
+                                depth[pc] = DEPTH_UNKNOWN;
+                        }
+                }
+        }
+
+        // Callees are analysed before their callers, a caller is analysed again once its callee is done
+        verifier_t v        = { program, start, depth, worklist, summary };
+        bool verified       = true;
+        uint32_t pending    = 0;
+        functions[pending++] = 0;
+        summary[0].state    = SUMMARY_ACTIVE;
+        while (verified && pending)
+        {
+                uint32_t callee;
+                verified = analyse(&v, functions[pending - 1], &callee);
+                if (verified && callee != size)
+                {
+                        summary[callee].state = SUMMARY_ACTIVE;
+                        functions[pending++]  = callee;         // Every function is queued at most once
+                }
+                else if (verified)
+                {
+                        pending--;
+                }
+        }
+
+        summary_t outermost = summary[0];
+        free(start);
+        free(depth);
+        free(worklist);
+        free(summary);
+        free(functions);
+        if (!verified)
+        {
+                return false;
+        }
+        if (-outermost.lowest > (int64_t)UINT32_MAX || outermost.highest > (int64_t)UINT32_MAX)
+        {
+                return reject(program, 0, "stack depth out of range");
+        }
+        program->verified     = true;
+        program->entry_depth  = (uint32_t)-outermost.lowest;
+        program->max_depth    = (uint32_t)outermost.highest;
+        program->max_frames   = outermost.frames;
+        program->verify_error = NULL;
+        program->verify_pc    = 0;
+        return true;
+}
@@ -0,0 +1,60 @@
+/***
+ *
+ * @file: svmasm.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the command line assembler writing StackVM program files
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "asm.h"
+
+int main(int argc, char const *argv[])
+{
+        if (argc != 3)
+        {
+                fprintf(stderr, "Usage: %s <source file | -> <program file>\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "r");
+        if (!in)
+        {
+                fprintf(stderr, "Error: Failed to open source file '%s'\n", argv[1]);
+                return EXIT_FAILURE;
+        }
+
+        asm_error_t error;
+        size_t size;
+        uint32_t *code = asm_assemble(in, &size, &error);
+        if (in != stdin)
+        {
+                fclose(in);
+        }
+        if (!code)
+        {
+                if (error.line)
+                {
+                        fprintf(stderr, "%s:%zu: Error: %s\n", argv[1], error.line, error.message);
+                }
+                else
+                {
+                        fprintf(stderr, "%s: Error: %s\n", argv[1], error.message);
+                }
+                return EXIT_FAILURE;
+        }
+
+        if (program_save(argv[2], code, size, NULL, 0) != 0)
+        {
+                fprintf(stderr, "Error: Failed to write program file '%s'\n", argv[2]);
+                free(code);
+                return EXIT_FAILURE;
+        }
+        free(code);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+/***
+ *
+ * @file: svmdis.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the command line disassembler of StackVM program files
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include "defs.h"
+#include "stackvm.h"
+#include "asm.h"
+
+int main(int argc, char const *argv[])
+{
+        if (argc != 2)
+        {
+                fprintf(stderr, "Usage: %s <program file>\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        program_t *program = program_open(argv[1]);
+        if (!program)
+        {
+                fprintf(stderr, "Error: '%s' is not a valid StackVM program file\n", argv[1]);
+                return EXIT_FAILURE;
+        }
+
+        int status = asm_disassemble(stdout, program->code, program->size);
+        program_free(program);
+        return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
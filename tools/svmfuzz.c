@@ -0,0 +1,804 @@
+/***
+ *
+ * @file: svmfuzz.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the differential fuzzer and throughput guard of the StackVM engines
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#define _DEFAULT_SOURCE // dup, dup2, clock_gettime
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "program.h"
+#include "batch.h"
+#include "channel.h"
+#include "native.h"
+#include "asm.h"
+
+#define FUZZ_PROGRAMS           10000           // Programs generated by default
+#define FUZZ_MAX_WORDS          64              // Largest generated program in words
+#define FUZZ_INPUTS             4               // Values on the stack when most programs start
+#define FUZZ_STACK              48              // Cells of the operand stack, small enough to overflow
+#define FUZZ_CALLS              8               // Frames of the call stack
+#define FUZZ_BUDGET             4096            // Instructions of a budgeted run
+#define FUZZ_VALUES             16              // Values of the input channel, it is closed after them
+#define FUZZ_OUTPUTS            64              // Values the output channel holds before OUT waits
+#define FUZZ_TUPLES             32              // Input tuples of a batch run
+#define FUZZ_MARGIN             10              // Default throughput margin in percent
+#define FUZZ_CORPUS             256             // Programs timed by the throughput guard
+#define FUZZ_REPEAT             5               // Measurements per engine, the fastest one is reported
+#define FUZZ_RUNS               256             // Runs of every program per measurement
+
+#define OP(opcode)              GET_OPCODE(opcode)
+
+/**
+ * @brief Observable state of a finished run
+ * @note A program counter outside the program is recorded as the program size: the staged engine
+ *       stops on the branch target, the other engines on the end of their translation.
+ */
+typedef struct fuzz_outcome
+{
+        state_t state;                     // Final state
+        vm_error_t error;                  // Halt reason
+        uint32_t pc;                       // Program counter
+        uint32_t sp;                       // Stack pointer
+        uint8_t flags;                     // Flag register
+        uint32_t fp;                       // Frame pointer
+        uint32_t calls;                    // Frames on the call stack
+        uint32_t outputs;                  // Values written by OUT
+        uint64_t retired;                  // Instructions retired
+        uint32_t peak;                     // Deepest stack an instruction was dispatched with
+        cell_t stack[FUZZ_STACK];          // Operand stack up to the stack pointer
+        cell_t out[FUZZ_OUTPUTS];          // Values written by OUT
+} fuzz_outcome_t;
+
+/**
+ * @brief Generated program with the values it runs on
+ */
+typedef struct fuzz_case
+{
+        uint32_t code[FUZZ_MAX_WORDS];     // Program words
+        uint32_t size;                     // Number of program words
+        cell_t inputs[FUZZ_INPUTS];        // Values pushed before the run
+        uint32_t arity;                    // Number of inputs pushed, 0 starts on an empty stack
+        cell_t values[FUZZ_VALUES];        // Values of the input channel
+        bool straight;                     // No control flow and no channels, every engine can batch it
+        bool forward;                      // Computes and branches forward only, it halts on any input
+} fuzz_case_t;
+
+static int natives[4];                     // Indices of the native functions called by generated programs
+static FILE *report;                       // Reports, stderr is silenced while the engines fault
+
+/**
+ * @brief Returns the next value of a xorshift64* generator
+ * @param state Generator state, never 0
+ * @return Pseudo-random 64-bit value
+ */
+static uint64_t fuzz_random(uint64_t *state)
+{
+        *state ^= *state >> 12;
+        *state ^= *state << 25;
+        *state ^= *state >> 27;
+        return *state * UINT64_C(2685821657736338717);
+}
+
+/**
+ * @brief Returns a value that is small most of the time and an edge case otherwise
+ * @param state Generator state
+ * @return Cell value
+ */
+static cell_t fuzz_value(uint64_t *state)
+{
+        static const cell_t edges[] = { 0, 1, -1, 2, INT64_MIN, INT64_MAX, IMMEDIATE_MIN, IMMEDIATE_MAX, INT32_MIN, UINT32_MAX };
+        uint64_t r = fuzz_random(state);
+        switch (r % 8)
+        {
+        case 0:
+                return edges[(r >> 8) % (sizeof(edges) / sizeof(edges[0]))];
+        case 1:
+                return (cell_t)fuzz_random(state);
+        default:
+                return (cell_t)((r >> 8) % 9) - 4;
+        }
+}
+
+static bool fuzz_mix(cell_t *args, void *data)
+{
+        (void)data;
+        args[0] = (cell_t)(((uint64_t)args[0] * 31) ^ (uint64_t)args[1]);
+        return true;
+}
+
+static bool fuzz_split(cell_t *args, void *data)
+{
+        (void)data;
+        args[1] = args[0] >> 32;
+        args[0] = (cell_t)(uint32_t)args[0];
+        return true;
+}
+
+static bool fuzz_drop(cell_t *args, void *data)
+{
+        (void)args;
+        (void)data;
+        return true;
+}
+
+static bool fuzz_check(cell_t *args, void *data)
+{
+        (void)data;
+        return args[0] >= 0;                                    // Fails on negative arguments
+}
+
+/**
+ * @brief Generates a random well-formed program
+ * @param state Generator state
+ * @param fc Receives the program and its inputs
+ * @return void
+ * @note Every instruction carries its operand words and every branch targets an instruction, the
+ *       stack depth is tracked so most instructions find their operands. A quarter of the programs
+ *       are straight-line code and a quarter of the others only compute and branch forward, the rest
+ *       mix in branches, calls, locals, channels and natives, so about a fifth of them pass the verifier
+ *       and run unchecked. One program in eight starts on an empty stack.
+ */
+static void fuzz_generate(uint64_t *state, fuzz_case_t *fc)
+{
+        static const uint32_t alu[]      = { ADD, SUB, MUL, DIV, AND, OR, NOT, XOR, LT, GT, LE, GE, EQ, NE, CMP };
+        static const uint32_t branches[] = { BR, BRT, BRF, BRZ, BRNZ, BRLT, BRGE, BRGT, BRLE, CALL };
+        uint32_t starts[FUZZ_MAX_WORDS];                        // First word of every instruction
+        uint32_t count  = 0;
+        uint32_t limit  = 2 + (uint32_t)(fuzz_random(state) % (FUZZ_MAX_WORDS - 4));
+        fc->arity       = (fuzz_random(state) % 8) ? FUZZ_INPUTS : 0;
+        int64_t depth   = fc->arity;
+        fc->straight    = fuzz_random(state) % 4 == 0;
+        fc->forward     = !fc->straight && fuzz_random(state) % 4 == 0;
+        fc->size        = 0;
+
+        while (fc->size + 4 < limit)
+        {
+                uint32_t *word = &fc->code[fc->size];
+                uint32_t kind  = (uint32_t)(fuzz_random(state) % 16);
+                starts[count++] = fc->size;
+                if (fc->straight && kind >= 9)
+                {
+                        kind %= 9;                              // Straight-line code only pushes and computes
+                }
+                if (fc->forward && kind >= 12)
+                {
+                        kind %= 9;                              // No calls, locals, natives, channels or returns
+                }
+                if (depth <= 1 && kind >= 3 && kind < 9 && fuzz_random(state) % 8)
+                {
+                        kind = 0;                               // Push rather than underflow
+                }
+                switch (kind)
+                {
+                case 0: case 1: case 2:
+                {
+                        cell_t value = fuzz_value(state);
+                        if (value >= IMMEDIATE_MIN && value <= IMMEDIATE_MAX)
+                        {
+                                word[0]   = GET_PUSH(value);
+                                fc->size += 1;
+                        }
+                        else
+                        {
+                                word[0]   = OP(LIT);
+                                word[1]   = (uint32_t)value;
+                                word[2]   = (uint32_t)((uint64_t)value >> 32);
+                                fc->size += 3;
+                        }
+                        depth++;
+                        break;
+                }
+                case 3: case 4: case 5: case 6: case 7: case 8:
+                {
+                        uint32_t opcode = alu[fuzz_random(state) % (sizeof(alu) / sizeof(alu[0]))];
+                        const opcode_info_t *info = stackvm_opcode_info(opcode);
+                        word[0]   = OP(opcode);
+                        fc->size += 1;
+                        depth    += info->pushes - info->pops;
+                        break;
+                }
+                case 9: case 10: case 11:
+                        word[0]   = OP(branches[fuzz_random(state) % (sizeof(branches) / sizeof(branches[0]) - fc->forward)]); // CALL is last
+                        word[1]   = (uint32_t)fuzz_random(state);      // Instruction number, resolved below
+                        fc->size += 2;
+                        depth    -= (GET_DATA(word[0]) == BRT || GET_DATA(word[0]) == BRF);
+                        break;
+                case 12:
+                        word[0]   = OP(fuzz_random(state) % 2 ? LOAD_LOCAL : STORE_LOCAL);
+                        word[1]   = (uint32_t)(int32_t)(fuzz_random(state) % 7 - 3);
+                        fc->size += 2;
+                        depth    += (GET_DATA(word[0]) == LOAD_LOCAL) ? 1 : -1;
+                        break;
+                case 13:
+                {
+                        int native = natives[fuzz_random(state) % 4];
+                        word[0]   = OP(CALL_NATIVE);
+                        word[1]   = (fuzz_random(state) % 16) ? (uint32_t)native : NATIVE_MAX; // Now and then an unregistered index
+                        fc->size += 2;
+                        depth    += native_get((uint32_t)native)->results - native_get((uint32_t)native)->arity;
+                        break;
+                }
+                case 14:
+                        word[0]   = OP(fuzz_random(state) % 2 ? IN : OUT);
+                        fc->size += 1;
+                        depth    += (GET_DATA(word[0]) == IN) ? 1 : -1;
+                        break;
+                default:
+                        word[0]   = OP(fuzz_random(state) % 3 ? RET : HALT);
+                        fc->size += 1;
+                        break;
+                }
+                depth = (depth < 0) ? 0 : depth;
+        }
+        starts[count++] = fc->size;
+        fc->code[fc->size++] = OP(HALT);
+
+        for (uint32_t i = 0; i + 1 < count; i++)
+        {
+                const opcode_info_t *info = stackvm_opcode_info(GET_DATA(fc->code[starts[i]]));
+                if (GET_TYPE(fc->code[starts[i]]) == PRIMITIVE_INSTRUCTION && info->target)
+                {
+                        uint32_t first = fc->forward ? i + 1 : 0;       // Forward branches skip ahead, at most to the HALT
+                        fc->code[starts[i] + 1] = starts[first + fc->code[starts[i] + 1] % (count - first)];
+                }
+        }
+        for (uint32_t i = 0; i < FUZZ_INPUTS; i++)
+        {
+                fc->inputs[i] = fuzz_value(state);
+        }
+        for (uint32_t i = 0; i < FUZZ_VALUES; i++)
+        {
+                fc->values[i] = fuzz_value(state);
+        }
+        return;
+}
+
+/**
+ * @brief Creates a context for a generated program
+ * @param program Pointer to the program
+ * @param engine Engine of the context
+ * @return Pointer to the context, NULL on failure
+ */
+static stackvm_t *fuzz_context(program_t *program, engine_t engine)
+{
+        stackvm_config_t config = { .stack_size = FUZZ_STACK, .call_size = FUZZ_CALLS };
+        stackvm_t *vm = stackvm_create(&config);
+        if (vm)
+        {
+                stackvm_set_engine(vm, engine);
+                attach_program(vm, program);
+        }
+        return vm;
+}
+
+/**
+ * @brief Runs a generated program on one engine
+ * @param fc Pointer to the generated program
+ * @param program Pointer to the program created from it
+ * @param engine Engine to run on
+ * @param budget Instruction budget, 0 runs to the end
+ * @param split Instructions of a budgeted slice before an unbounded run resumes it, 0 runs in one piece
+ * @param counted Run the counted engine variants, the other runs leave `retired` and `peak` at 0
+ * @param outcome Receives the state after the run
+ * @return 0 on success, -1 on failure
+ */
+static int fuzz_run(const fuzz_case_t *fc, program_t *program, engine_t engine, uint64_t budget, uint64_t split, bool counted,
+                    fuzz_outcome_t *outcome)
+{
+        stackvm_t *vm  = fuzz_context(program, engine);
+        channel_t *in  = channel_create(FUZZ_VALUES);
+        channel_t *out = channel_create(FUZZ_OUTPUTS);
+        if (!vm || !in || !out)
+        {
+                stackvm_free(vm);
+                channel_free(in);
+                channel_free(out);
+                return -1;
+        }
+        channel_write(in, fc->values, FUZZ_VALUES);
+        channel_close(in);
+        stackvm_channels(vm, in, out);
+        stackvm_metrics(vm, counted);
+        for (uint32_t i = 0; i < fc->arity; i++)
+        {
+                vm->stack[++vm->sp] = fc->inputs[i];
+        }
+        uint64_t retired = 0;                                   // Instructions retired by the slice
+        uint32_t peak    = 0;                                   // Deepest stack of the slice
+        if (budget)
+        {
+                stackvm_run_for(vm, budget);
+        }
+        else if (!split)
+        {
+                stackvm_run(vm);
+        }
+        else if (stackvm_run_for(vm, split) == RUN_PAUSED)
+        {
+                retired = vm->retired;
+                peak    = vm->peak;
+                stackvm_run(vm);                                // Entered in the middle of the program
+        }
+
+        memset(outcome, 0, sizeof(*outcome));
+        outcome->state   = vm->state;
+        outcome->error   = vm->error;
+        outcome->pc      = (vm->pc < vm->size) ? vm->pc : vm->size;
+        outcome->sp      = vm->sp;
+        outcome->flags   = vm->flags;
+        outcome->fp      = vm->fp;
+        outcome->calls   = vm->calls;
+        outcome->outputs = channel_read(out, outcome->out, FUZZ_OUTPUTS);
+        outcome->retired = retired + vm->retired;
+        outcome->peak    = !counted ? 0 : (vm->peak > peak) ? vm->peak : peak;
+        for (uint32_t i = 0; i < vm->sp + 1 && i < FUZZ_STACK; i++)
+        {
+                outcome->stack[i] = vm->stack[i];               // An empty stack has `sp` at UINT32_MAX
+        }
+        stackvm_free(vm);
+        channel_free(in);
+        channel_free(out);
+        return 0;
+}
+
+/**
+ * @brief Runs a program that halts on any input as a batch on one engine
+ * @param fc Pointer to the generated program
+ * @param program Pointer to the program created from it
+ * @param engine Engine to run on
+ * @param fresh Run every tuple as a batch of one on a context of its own, nothing carries over between them
+ * @param results Receives `FUZZ_TUPLES` results, the tuples are rotations of the program inputs
+ * @return Number of tuples evaluated, -1 on failure
+ */
+static long fuzz_batch(const fuzz_case_t *fc, program_t *program, engine_t engine, bool fresh, cell_t *results)
+{
+        cell_t inputs[FUZZ_TUPLES * FUZZ_INPUTS];
+        for (uint32_t i = 0; i < FUZZ_TUPLES * fc->arity; i++)
+        {
+                inputs[i] = fc->inputs[(i + i / fc->arity) % fc->arity] + (cell_t)(i / fc->arity);
+        }
+        memset(results, 0, FUZZ_TUPLES * sizeof(cell_t));
+        long evaluated = 0;
+        for (uint32_t t = 0; t < FUZZ_TUPLES && evaluated == t; t += fresh ? 1 : FUZZ_TUPLES)
+        {
+                stackvm_t *vm = fuzz_context(program, engine);
+                if (!vm)
+                {
+                        return -1;
+                }
+                uint32_t count = fresh ? 1 : FUZZ_TUPLES;
+                evaluated += (long)stackvm_run_batch(vm, inputs + t * fc->arity, fc->arity, count, results + t);
+                stackvm_free(vm);
+        }
+        return evaluated;
+}
+
+/**
+ * @brief Runs a generated program on every engine and compares them with the staged engine
+ * @param fc Pointer to the generated program
+ * @param engine Receives the first engine that disagrees
+ * @param run Receives the kind of run that disagrees, "budgeted", "unbounded", "counted", "resumed" or "batch"
+ * @param expected Receives the outcome of the staged engine, may be NULL
+ * @param got Receives the outcome of the disagreeing engine, may be NULL
+ * @return true if an engine disagrees
+ * @note Every engine runs with the instruction budget first. Programs that halt within it are run
+ *       twice more on every engine without a budget, once quiet and once counted, so the unchecked,
+ *       optimized and compiled paths are compared as well, then paused halfway and resumed to enter
+ *       the engines mid-program, and programs that halt on any input are also run as batches and
+ *       compared with the staged engine running every tuple on a fresh context. The budgeted, counted
+ *       and resumed runs take the counted engine variants and compare the instructions retired and
+ *       the peak depth, the quiet unbounded runs the others.
+ */
+static bool fuzz_differs(const fuzz_case_t *fc, engine_t *engine, const char **run, fuzz_outcome_t *expected, fuzz_outcome_t *got)
+{
+        fuzz_outcome_t reference, outcome;
+        program_t *program = program_create(fc->code, fc->size);
+        if (!program || fuzz_run(fc, program, ENGINE_STAGED, FUZZ_BUDGET, 0, true, &reference) != 0)
+        {
+                program_free(program);
+                return false;
+        }
+
+        bool differs = false;
+        for (engine_t e = 0; e < ENGINE_COUNT && !differs; e++)
+        {
+                differs = fuzz_run(fc, program, e, FUZZ_BUDGET, 0, true, &outcome) == 0 && memcmp(&reference, &outcome, sizeof(outcome)) != 0;
+                *engine = e;
+                *run    = "budgeted";
+        }
+        fuzz_outcome_t uncounted = reference;
+        uncounted.retired        = 0;
+        uncounted.peak           = 0;
+        for (engine_t e = 0; e < ENGINE_COUNT && !differs && reference.state == STATE_HALT; e++)
+        {
+                differs = fuzz_run(fc, program, e, 0, 0, false, &outcome) == 0 && memcmp(&uncounted, &outcome, sizeof(outcome)) != 0;
+                *engine = e;
+                *run    = "unbounded";
+        }
+        for (engine_t e = 0; e < ENGINE_COUNT && !differs && reference.state == STATE_HALT; e++)
+        {
+                differs = fuzz_run(fc, program, e, 0, 0, true, &outcome) == 0 && memcmp(&reference, &outcome, sizeof(outcome)) != 0;
+                *engine = e;
+                *run    = "counted";
+        }
+        for (engine_t e = 0; e < ENGINE_COUNT && !differs && reference.state == STATE_HALT && reference.retired > 1; e++)
+        {
+                differs = fuzz_run(fc, program, e, 0, reference.retired / 2, true, &outcome) == 0 &&
+                          memcmp(&reference, &outcome, sizeof(outcome)) != 0;
+                *engine = e;
+                *run    = "resumed";
+        }
+        if ((fc->straight || fc->forward) && !differs)
+        {
+                cell_t results[FUZZ_TUPLES], batch[FUZZ_TUPLES];
+                long count = fuzz_batch(fc, program, ENGINE_STAGED, true, results);
+                for (engine_t e = 0; e < ENGINE_COUNT && !differs; e++)
+                {
+                        differs = fuzz_batch(fc, program, e, false, batch) != count || memcmp(results, batch, sizeof(batch)) != 0;
+                        *engine = e;
+                        *run    = "batch";
+                }
+                if (differs)
+                {
+                        memset(&outcome, 0, sizeof(outcome));   // Batches only report results
+                }
+        }
+        program_free(program);
+        if (expected)
+        {
+                *expected = reference;
+        }
+        if (got)
+        {
+                *got = outcome;
+        }
+        return differs;
+}
+
+/**
+ * @brief Removes the instruction at a word from a program
+ * @param fc Pointer to the program
+ * @param start First word of the instruction
+ * @param length Words of the instruction
+ * @return void
+ * @note Branch targets after the instruction move with their instruction, targets of the
+ *       removed instruction now point to the instruction that followed it.
+ */
+static void fuzz_remove(fuzz_case_t *fc, uint32_t start, uint32_t length)
+{
+        memmove(&fc->code[start], &fc->code[start + length], (fc->size - start - length) * sizeof(uint32_t));
+        fc->size -= length;
+        for (uint32_t pc = 0; pc < fc->size; )
+        {
+                uint32_t instruction      = fc->code[pc];
+                const opcode_info_t *info = stackvm_opcode_info(GET_DATA(instruction));
+                uint32_t words            = 1;
+                if (GET_TYPE(instruction) == PRIMITIVE_INSTRUCTION && info)
+                {
+                        words += info->operands;
+                        if (info->target && pc + 1 < fc->size && fc->code[pc + 1] > start)
+                        {
+                                fc->code[pc + 1] -= (fc->code[pc + 1] >= start + length) ? length : fc->code[pc + 1] - start;
+                        }
+                }
+                pc += words;
+        }
+        return;
+}
+
+/**
+ * @brief Shrinks a program on which the engines disagree
+ * @param fc Pointer to the program, replaced by the smallest variant found that still disagrees
+ * @return Number of words removed
+ * @note Repeatedly removes single instructions and replaces pushed values with 0, keeping every
+ *       change after which some engine still disagrees, until no change is kept.
+ */
+static uint32_t fuzz_shrink(fuzz_case_t *fc)
+{
+        uint32_t original = fc->size;
+        engine_t engine;
+        const char *run;
+        for (bool changed = true; changed; )
+        {
+                changed = false;
+                uint32_t starts[FUZZ_MAX_WORDS], lengths[FUZZ_MAX_WORDS], count = 0;
+                for (uint32_t pc = 0; pc < fc->size; pc += lengths[count++])
+                {
+                        const opcode_info_t *info = stackvm_opcode_info(GET_DATA(fc->code[pc]));
+                        starts[count]  = pc;
+                        lengths[count] = 1;
+                        if (GET_TYPE(fc->code[pc]) == PRIMITIVE_INSTRUCTION && info && pc + info->operands < fc->size)
+                        {
+                                lengths[count] += info->operands;
+                        }
+                }
+                for (uint32_t i = count; i-- > 0 && fc->size > 1; )
+                {
+                        fuzz_case_t candidate = *fc;
+                        fuzz_remove(&candidate, starts[i], lengths[i]);
+                        if (fuzz_differs(&candidate, &engine, &run, NULL, NULL))
+                        {
+                                *fc     = candidate;
+                                changed = true;
+                                break;                          // The instruction starts moved
+                        }
+                        candidate = *fc;
+                        uint32_t word = fc->code[starts[i]];
+                        if ((GET_TYPE(word) == POSITIVE_INTEGER || GET_TYPE(word) == NEGATIVE_INTEGER) && word != GET_PUSH(0))
+                        {
+                                candidate.code[starts[i]] = GET_PUSH(0);
+                                if (fuzz_differs(&candidate, &engine, &run, NULL, NULL))
+                                {
+                                        *fc     = candidate;
+                                        changed = true;
+                                }
+                        }
+                }
+        }
+        return original - fc->size;
+}
+
+/**
+ * @brief Prints the outcome of a run
+ * @param name Name of the engine
+ * @param outcome Pointer to the outcome
+ * @return void
+ */
+static void fuzz_print(const char *name, const fuzz_outcome_t *outcome)
+{
+        fprintf(report, "  %-9s state %d, error '%s', pc %u, sp %d, flags 0x%02x, fp %u, calls %u, outputs %u, retired %" PRIu64 ", peak %u, stack [",
+                name, outcome->state, stackvm_error_message(outcome->error), outcome->pc, (int32_t)outcome->sp,
+                outcome->flags, outcome->fp, outcome->calls, outcome->outputs, outcome->retired, outcome->peak);
+        for (uint32_t i = 0; i < outcome->sp + 1 && i < FUZZ_STACK; i++)
+        {
+                fprintf(report, "%s%" PRId64, i ? " " : "", outcome->stack[i]);
+        }
+        fprintf(report, "]\n");
+        return;
+}
+
+/**
+ * @brief Reports a program on which the engines disagree
+ * @param fc Pointer to the program
+ * @param seed Seed that generates the program
+ * @param path Program file to save the shrunk program to, NULL for none
+ * @return void
+ */
+static void fuzz_report(fuzz_case_t *fc, uint64_t seed, const char *path)
+{
+        uint32_t removed = fuzz_shrink(fc);
+        engine_t engine  = ENGINE_STAGED;
+        const char *run  = "";
+        fuzz_outcome_t expected, got;
+        fuzz_differs(fc, &engine, &run, &expected, &got);
+        fprintf(report, "Mismatch of a %s run on the %s engine, seed %" PRIu64 ", shrunk by %u words to:\n",
+                run, stackvm_engine_name(engine), seed, removed);
+        asm_disassemble(report, fc->code, fc->size);
+        fprintf(report, "  inputs  ");
+        for (uint32_t i = 0; i < fc->arity; i++)
+        {
+                fprintf(report, " %" PRId64, fc->inputs[i]);
+        }
+        fprintf(report, "\n");
+        fuzz_print(stackvm_engine_name(ENGINE_STAGED), &expected);
+        fuzz_print(stackvm_engine_name(engine), &got);
+        if (path && program_save(path, fc->code, fc->size, NULL, 0) == 0)
+        {
+                fprintf(report, "  saved to '%s'\n", path);
+        }
+        return;
+}
+
+/**
+ * @brief Returns the monotonic time in seconds
+ * @return Seconds since an arbitrary point
+ */
+static double fuzz_now(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Times every engine on a corpus of generated programs
+ * @param seed Seed of the first program
+ * @param reference Engine the others are compared with
+ * @param margin Percent an engine may be slower than the reference
+ * @return Number of engines slower than the reference by more than the margin, -1 on failure
+ * @note The corpus holds verified programs without channels that halt within the budget, so every
+ *       engine runs its fastest path. Each engine runs the corpus `FUZZ_RUNS` times per measurement.
+ *       The staged engine checks every instruction by design and is never flagged.
+ */
+static int fuzz_guard(uint64_t seed, engine_t reference, double margin)
+{
+        static program_t *corpus[FUZZ_CORPUS];
+        static fuzz_case_t cases[FUZZ_CORPUS];
+        uint32_t count = 0;
+        for (uint64_t s = seed; count < FUZZ_CORPUS && s < seed + 1000 * FUZZ_CORPUS; s++)
+        {
+                uint64_t state = s * UINT64_C(0x9e3779b97f4a7c15) | 1;
+                fuzz_case_t *fc = &cases[count];
+                fuzz_generate(&state, fc);
+                program_t *program = program_create(fc->code, fc->size);
+                fuzz_outcome_t outcome;
+                bool channels = false;
+                for (uint32_t pc = 0; pc < fc->size; pc++)
+                {
+                        channels |= fc->code[pc] == OP(IN) || fc->code[pc] == OP(OUT);
+                }
+                if (program && program->verified && !channels &&
+                    fuzz_run(fc, program, ENGINE_STAGED, FUZZ_BUDGET, 0, false, &outcome) == 0 && outcome.state == STATE_HALT)
+                {
+                        corpus[count++] = program;
+                        continue;
+                }
+                program_free(program);
+        }
+
+        double seconds[ENGINE_COUNT];
+        for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+                stackvm_t *vm = count ? fuzz_context(corpus[0], engine) : NULL;
+                if (!vm)
+                {
+                        return -1;
+                }
+                for (int r = 0; r <= FUZZ_REPEAT; r++)
+                {
+                        double start = fuzz_now();
+                        for (uint32_t i = 0; i < count; i++)
+                        {
+                                attach_program(vm, corpus[i]);
+                                for (uint32_t run = 0; run < FUZZ_RUNS; run++)
+                                {
+                                        stackvm_reset(vm);
+                                        memcpy(vm->stack, cases[i].inputs, cases[i].arity * sizeof(cell_t));
+                                        vm->sp = cases[i].arity - 1;
+                                        stackvm_run(vm);
+                                }
+                        }
+                        double elapsed = fuzz_now() - start;
+                        if (r == 1 || (r > 1 && elapsed < seconds[engine]))
+                        {
+                                seconds[engine] = elapsed;      // The first pass compiles and warms up
+                        }
+                }
+                stackvm_free(vm);
+        }
+
+        int slower = 0;
+        double runs = (double)count * FUZZ_RUNS;
+        fprintf(report, "engine,programs,runs,seconds,ns_per_run,relative,status\n");
+        for (engine_t engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+                double relative = seconds[engine] / seconds[reference];
+                bool regressed  = engine != ENGINE_STAGED && relative > 1.0 + margin / 100.0;
+                slower += regressed;
+                fprintf(report, "%s,%u,%.0f,%.6f,%.1f,%.3f,%s\n", stackvm_engine_name(engine), count, runs, seconds[engine],
+                        seconds[engine] * 1e9 / runs, relative, (engine == ENGINE_STAGED) ? "-" : regressed ? "SLOWER" : "ok");
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+                program_free(corpus[i]);
+        }
+        return slower;
+}
+
+/**
+ * @brief Finds an engine by name
+ * @param name Name of the engine
+ * @return The engine, ENGINE_COUNT if no engine has that name
+ */
+static engine_t fuzz_engine(const char *name)
+{
+        engine_t engine = 0;
+        while (engine < ENGINE_COUNT && strcmp(stackvm_engine_name(engine), name) != 0)
+        {
+                engine++;
+        }
+        return engine;
+}
+
+int main(int argc, char const *argv[])
+{
+        uint64_t programs = FUZZ_PROGRAMS;
+        uint64_t seed     = 1;
+        const char *path  = NULL;
+        bool guard        = false;
+        engine_t engine   = ENGINE_STAGED;
+        double margin     = FUZZ_MARGIN;
+        for (int i = 1; i < argc; i++)
+        {
+                if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && atoll(argv[i + 1]) > 0)
+                {
+                        programs = (uint64_t)atoll(argv[++i]);
+                }
+                else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+                {
+                        seed = strtoull(argv[++i], NULL, 0);
+                }
+                else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+                {
+                        path = argv[++i];
+                }
+                else if (strcmp(argv[i], "--perf") == 0)
+                {
+                        guard = true;
+                }
+                else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && fuzz_engine(argv[i + 1]) < ENGINE_COUNT)
+                {
+                        engine = fuzz_engine(argv[++i]);
+                }
+                else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 0.0)
+                {
+                        margin = atof(argv[++i]);
+                }
+                else
+                {
+                        fprintf(stderr, "Usage: %s [-n <programs>] [-s <seed>] [-o <program file>] [--perf [-r <engine>] [-m <percent>]]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        natives[0] = native_register("fuzz_mix", 2, 1, fuzz_mix, NULL);
+        natives[1] = native_register("fuzz_split", 1, 2, fuzz_split, NULL);
+        natives[2] = native_register("fuzz_drop", 1, 0, fuzz_drop, NULL);
+        natives[3] = native_register("fuzz_check", 1, 1, fuzz_check, NULL);
+        int saved  = dup(STDERR_FILENO);
+        int null   = open("/dev/null", O_WRONLY);
+        if (natives[0] < 0 || natives[1] < 0 || natives[2] < 0 || natives[3] < 0 || saved < 0 || null < 0 || !(report = fdopen(saved, "w")))
+        {
+                fprintf(stderr, "Error: Failed to set up the fuzzer\n");
+                return EXIT_FAILURE;
+        }
+        dup2(null, STDERR_FILENO);                              // Faults are expected, the engines print every one
+        close(null);
+
+        if (guard)
+        {
+                int slower = fuzz_guard(seed, engine, margin);
+                if (slower != 0)
+                {
+                        fprintf(report, (slower < 0) ? "Error: Failed to time the engines\n" :
+                                "Error: %d of the engines are more than %.0f%% slower than the %s engine\n", slower, margin, stackvm_engine_name(engine));
+                }
+                return (slower == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        uint64_t failures = 0, verified = 0, halted = 0;
+        for (uint64_t s = seed; s < seed + programs; s++)
+        {
+                uint64_t state = s * UINT64_C(0x9e3779b97f4a7c15) | 1;
+                fuzz_case_t fc;
+                fuzz_generate(&state, &fc);
+                engine_t disagreeing;
+                const char *run;
+                fuzz_outcome_t expected = { .state = STATE_RESET };
+                if (fuzz_differs(&fc, &disagreeing, &run, &expected, NULL))
+                {
+                        failures++;
+                        fuzz_report(&fc, s, path);
+                }
+                program_t *program = program_create(fc.code, fc.size);
+                verified += program && program->verified;
+                halted   += expected.state == STATE_HALT;
+                program_free(program);
+        }
+        fprintf(report, "Ran %" PRIu64 " programs from seed %" PRIu64 " on %d engines: %" PRIu64 " verified, %" PRIu64 " halted, %" PRIu64 " mismatches\n",
+                programs, seed, ENGINE_COUNT, verified, halted, failures);
+        return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+/***
+ *
+ * @file: tracedump.c
+ * @author: Sagarrajvarman Ladla
+ * @date: 2025-08-03
+ * @brief: This file contains the pretty-printer for binary StackVM traces
+ * @version: 1.0
+ * @license: MIT License
+ * @note: This project is developed using the C23 language standard version.
+ *
+ */
+
+#include <inttypes.h>
+
+#include "defs.h"
+#include "stackvm.h"
+#include "trace.h"
+
+int main(int argc, char const *argv[])
+{
+        if (argc != 2)
+        {
+                fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        FILE *in = fopen(argv[1], "rb");
+        if (!in)
+        {
+                fprintf(stderr, "Error: Failed to open trace file '%s'\n", argv[1]);
+                return EXIT_FAILURE;
+        }
+
+        trace_header_t header;
+        if (fread(&header, sizeof(header), 1, in) != 1 ||
+            header.magic != TRACE_MAGIC ||
+            header.version != TRACE_VERSION ||
+            header.record_size != sizeof(trace_record_t))
+        {
+                fprintf(stderr, "Error: '%s' is not a StackVM trace of version %d\n", argv[1], TRACE_VERSION);
+                fclose(in);
+                return EXIT_FAILURE;
+        }
+
+        trace_record_t records[TRACE_BUFFER_SIZE];
+        size_t count;
+        while ((count = fread(records, sizeof(trace_record_t), TRACE_BUFFER_SIZE, in)) > 0)
+        {
+                for (size_t i = 0; i < count; i++)
+                {
+                        const trace_record_t *record = &records[i];
+
+                        fprintf(stdout, "%8u: ", record->pc);
+                        trace_print(stdout, record);
+                        fprintf(stdout, "\t[sp: %d, tos: %" PRId64 ", nos: %" PRId64 "]\n", (int)record->sp, record->tos, record->nos);
+                }
+        }
+        fclose(in);
+        return EXIT_SUCCESS;
+}